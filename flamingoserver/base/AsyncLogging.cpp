@@ -117,6 +117,8 @@ void AsyncLogging::append(const char* logline, int len)
 void AsyncLogging::threadFunc()
 {
 	assert(running_ == true);
+	if (threadStartCallback_)
+		threadStartCallback_();
 	latch_.countDown();
 	LogFile output(basename_, rollSize_, false);
 	BufferPtr newBuffer1(new Buffer);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <thread>
@@ -91,6 +92,13 @@ public:
         basename_ = basename;
     }
 
+	/// runs in the backend thread before it allocates its buffers,
+	/// must be set before start()
+	void setThreadStartCallback(const std::function<void()>& cb)
+	{
+		threadStartCallback_ = cb;
+	}
+
 	void append(const char* logline, int len);
 
 	void start()
@@ -131,4 +139,5 @@ private:
 	BufferPtr          currentBuffer_;
 	BufferPtr          nextBuffer_;
 	BufferVector       buffers_;
+	std::function<void()> threadStartCallback_;
 };
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "CpuAffinity.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <sstream>
+
+#include "Logging.h"
+
+namespace
+{
+	const char* kNodeDir = "/sys/devices/system/node";
+
+	const int kMaxNodes = 64;
+
+	bool readFirstLine(const char* path, std::string* line)
+	{
+		FILE* fp = ::fopen(path, "r");
+		if (fp == NULL)
+			return false;
+
+		char buf[1024];
+		bool ok = ::fgets(buf, sizeof buf, fp) != NULL;
+		::fclose(fp);
+		if (!ok)
+			return false;
+
+		line->assign(buf);
+		while (!line->empty() && ((*line)[line->size() - 1] == '\n' || (*line)[line->size() - 1] == ' '))
+			line->erase(line->size() - 1);
+		return true;
+	}
+}
+
+bool CpuAffinity::parseCpuList(const char* text, std::vector<int>* cpus)
+{
+	cpus->clear();
+	const char* p = text;
+	while (*p != '\0')
+	{
+		char* end;
+		long first = ::strtol(p, &end, 10);
+		if (end == p || first < 0 || first >= CPU_SETSIZE)
+			return false;
+
+		long last = first;
+		p = end;
+		if (*p == '-')
+		{
+			++p;
+			last = ::strtol(p, &end, 10);
+			if (end == p || last < first || last >= CPU_SETSIZE)
+				return false;
+			p = end;
+		}
+		for (long cpu = first; cpu <= last; ++cpu)
+			cpus->push_back(static_cast<int>(cpu));
+
+		if (*p == ',')
+			++p;
+		else if (*p != '\0')
+			return false;
+	}
+	return !cpus->empty();
+}
+
+std::string CpuAffinity::formatCpuList(const std::vector<int>& cpus)
+{
+	std::stringstream ss;
+	for (size_t i = 0; i < cpus.size(); )
+	{
+		size_t j = i;
+		while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+			++j;
+		if (i > 0)
+			ss << ",";
+		ss << cpus[i];
+		if (j > i)
+			ss << "-" << cpus[j];
+		i = j + 1;
+	}
+	return ss.str();
+}
+
+bool CpuAffinity::parsePlacement(const char* cpus, const char* node, Placement* placement)
+{
+	*placement = Placement();
+	if (cpus != NULL && cpus[0] != '\0')
+	{
+		if (::strncmp(cpus, "each:", 5) == 0)
+		{
+			placement->pinEach = true;
+			cpus += 5;
+		}
+		if (!parseCpuList(cpus, &placement->cpus))
+			return false;
+	}
+	if (node != NULL && node[0] != '\0')
+	{
+		char* end;
+		long n = ::strtol(node, &end, 10);
+		if (end == node || *end != '\0' || n < -1 || n >= kMaxNodes)
+			return false;
+		placement->node = static_cast<int>(n);
+	}
+	return true;
+}
+
+int CpuAffinity::numaNodeCount()
+{
+	DIR* dir = ::opendir(kNodeDir);
+	if (dir == NULL)
+		return 1;
+
+	int count = 0;
+	struct dirent* entry;
+	while ((entry = ::readdir(dir)) != NULL)
+	{
+		if (::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+			++count;
+	}
+	::closedir(dir);
+	return count > 0 ? count : 1;
+}
+
+int CpuAffinity::nodeOfCpu(int cpu)
+{
+	char path[64];
+	snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d", cpu);
+	DIR* dir = ::opendir(path);
+	if (dir == NULL)
+		return -1;
+
+	int node = -1;
+	struct dirent* entry;
+	while ((entry = ::readdir(dir)) != NULL)
+	{
+		if (::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+		{
+			node = ::atoi(entry->d_name + 4);
+			break;
+		}
+	}
+	::closedir(dir);
+	return node;
+}
+
+bool CpuAffinity::cpusOfNode(int node, std::vector<int>* cpus)
+{
+	char path[64];
+	snprintf(path, sizeof path, "%s/node%d/cpulist", kNodeDir, node);
+	std::string line;
+	return readFirstLine(path, &line) && parseCpuList(line.c_str(), cpus);
+}
+
+void CpuAffinity::bindCurrentThread(const Placement& placement, int index, const char* name)
+{
+	std::vector<int> cpus = placement.cpus;
+	if (placement.pinEach && !cpus.empty())
+		cpus.assign(1, cpus[static_cast<size_t>(index) % cpus.size()]);
+	else if (cpus.empty() && placement.node >= 0 && !cpusOfNode(placement.node, &cpus))
+		LOG_ERROR << name << ": no cpus found for numa node " << placement.node;
+
+	if (!cpus.empty())
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (size_t i = 0; i < cpus.size(); ++i)
+			CPU_SET(cpus[i], &set);
+		// pid 0 is the calling thread
+		if (::sched_setaffinity(0, sizeof set, &set) != 0)
+		{
+			LOG_SYSERR << name << ": sched_setaffinity " << formatCpuList(cpus);
+			cpus.clear();
+		}
+	}
+
+	// without an explicit node, the one all the cpus are on
+	int node = placement.node;
+	if (node < 0 && !cpus.empty())
+	{
+		node = nodeOfCpu(cpus[0]);
+		for (size_t i = 1; i < cpus.size() && node >= 0; ++i)
+		{
+			if (nodeOfCpu(cpus[i]) != node)
+				node = -1;
+		}
+	}
+
+	// with one node there is nothing to prefer
+	if (node >= 0 && numaNodeCount() > 1)
+	{
+		unsigned long mask[kMaxNodes / (8 * sizeof(unsigned long))] = { 0 };
+		mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+		if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, static_cast<unsigned long>(kMaxNodes)) != 0)
+			LOG_SYSERR << name << ": set_mempolicy node " << node;
+	}
+
+	LOG_INFO << name << " thread " << ::syscall(SYS_gettid)
+	         << ": cpus " << (cpus.empty() ? std::string("any") : formatCpuList(cpus))
+	         << ", memory node " << node;
+}
+
+std::string CpuAffinity::topology()
+{
+	std::stringstream ss;
+	int nodes = numaNodeCount();
+	ss << "numa nodes: " << nodes << ", online cpus: " << ::sysconf(_SC_NPROCESSORS_ONLN);
+	for (int node = 0; node < nodes; ++node)
+	{
+		std::vector<int> cpus;
+		if (cpusOfNode(node, &cpus))
+			ss << ", node " << node << ": cpus " << formatCpuList(cpus);
+	}
+	return ss.str();
+}
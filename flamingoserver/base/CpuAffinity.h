@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+///
+/// Pinning threads to cpus and their memory to a NUMA node.
+///
+/// Talks to the kernel with sched_setaffinity and set_mempolicy and reads
+/// the topology from sysfs, no libnuma needed.
+namespace CpuAffinity
+{
+
+	/// where the threads of a pool run
+	struct Placement
+	{
+		std::vector<int>    cpus;       // empty: the cpus of node, or anywhere
+		int                 node;       // -1: the node of each thread's cpus
+		bool                pinEach;    // thread i gets cpus[i % cpus.size()] alone
+
+		Placement() : node(-1), pinEach(false) { }
+
+		bool empty() const { return cpus.empty() && node < 0; }
+	};
+
+	/// "0-3,8,10-11", false on a syntax error
+	bool parseCpuList(const char* text, std::vector<int>* cpus);
+	std::string formatCpuList(const std::vector<int>& cpus);
+
+	/// cpus and node may be NULL, cpus "each:0-3" pins every thread to
+	/// one cpu of the list. False if either does not parse.
+	bool parsePlacement(const char* cpus, const char* node, Placement* placement);
+
+	/// number of NUMA nodes, 1 without NUMA
+	int numaNodeCount();
+	/// -1 if unknown
+	int nodeOfCpu(int cpu);
+	bool cpusOfNode(int node, std::vector<int>* cpus);
+
+	/// Applies placement to the calling thread, the index-th of its pool.
+	/// Its memory policy prefers the node, so what the thread allocates
+	/// afterwards is local. Logs the result under name.
+	void bindCurrentThread(const Placement& placement, int index, const char* name);
+
+	/// one line per node with its cpus
+	std::string topology();
+
+}
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <string.h> // memcpy
 #include <string>
+#include "StringPiece.h"
 
 namespace detail
 {
@@ -129,6 +130,12 @@ public:
 		return *this;
 	}
 
+	self& operator<<(const StringPiece& v)
+	{
+		buffer_.append(v.data(), static_cast<int>(v.size()));
+		return *this;
+	}
+
 	void append(const char* data, int len) { buffer_.append(data, len); }
 	const Buffer& buffer() const { return buffer_; }
 	void resetBuffer() { buffer_.reset(); }
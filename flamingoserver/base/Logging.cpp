@@ -80,7 +80,7 @@ Logger::OutputFunc g_output = defaultOutput;
 Logger::FlushFunc g_flush = defaultFlush;
 
 Logger::Impl::Impl(LogLevel level, int savedErrno, const SourceFile& file, int line)
-: time_(Timestamp::now()),
+: time_(Timestamp::cachedNow()),
 stream_(),
 level_(level),
 line_(line),
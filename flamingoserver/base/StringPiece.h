@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+///
+/// A read-only view of bytes owned by someone else, e.g. a frame still in
+/// the input Buffer of a connection. Copying it copies two words, not the
+/// bytes. The owner must outlive it, call as_string() to keep the bytes.
+///
+class StringPiece
+{
+public:
+    StringPiece()
+        : ptr_(NULL), length_(0) { }
+    StringPiece(const char* str)
+        : ptr_(str), length_(str != NULL ? strlen(str) : 0) { }
+    StringPiece(const std::string& str)
+        : ptr_(str.data()), length_(str.size()) { }
+    StringPiece(const char* offset, size_t len)
+        : ptr_(offset), length_(len) { }
+
+    const char* data() const { return ptr_; }
+    size_t size() const { return length_; }
+    bool empty() const { return length_ == 0; }
+    const char* begin() const { return ptr_; }
+    const char* end() const { return ptr_ + length_; }
+
+    void clear() { ptr_ = NULL; length_ = 0; }
+    void set(const char* buffer, size_t len) { ptr_ = buffer; length_ = len; }
+
+    char operator[](size_t i) const { return ptr_[i]; }
+
+    bool operator==(const StringPiece& x) const
+    {
+        return length_ == x.length_ && memcmp(ptr_, x.ptr_, length_) == 0;
+    }
+    bool operator!=(const StringPiece& x) const
+    {
+        return !(*this == x);
+    }
+
+    std::string as_string() const
+    {
+        return std::string(ptr_, length_);
+    }
+
+private:
+    const char*     ptr_;
+    size_t          length_;
+};
@@ -5,8 +5,15 @@
 #include <sstream>
 #include <stdio.h>
 
+#ifndef WIN32
+#include <time.h>
+#endif
+
 static_assert(sizeof(Timestamp) == sizeof(int64_t), "sizeof(Timestamp) error");
 
+__thread int64_t Timestamp::cachedMicroSeconds_ = 0;
+bool Timestamp::coarseClock_ = false;
+
 Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 : microSecondsSinceEpoch_(microSecondsSinceEpoch)
 {
@@ -83,4 +90,15 @@ Timestamp Timestamp::now()
 Timestamp Timestamp::invalid()
 {
 	return Timestamp();
+}
+
+Timestamp Timestamp::coarseNow()
+{
+#ifdef WIN32
+	return now();
+#else
+	struct timespec ts;
+	::clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+	return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+#endif
 }
\ No newline at end of file
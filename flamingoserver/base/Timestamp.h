@@ -56,10 +56,37 @@ using namespace std;
 		static Timestamp now();
 		static Timestamp invalid();
 
+		///
+		/// Time cached for the calling thread, no clock read. EventLoop
+		/// sets it to the poll return time of every iteration, so in a loop
+		/// thread it lags now() by at most the iteration so far. Threads
+		/// without a running loop read the clock, coarsely if
+		/// setCoarseClock(true). Fine for log lines, idle checks and
+		/// statistics, not for measuring short intervals.
+		///
+		static Timestamp cachedNow()
+		{
+			return cachedMicroSeconds_ > 0 ? Timestamp(cachedMicroSeconds_) : (coarseClock_ ? coarseNow() : now());
+		}
+		/// For EventLoop, in its thread. An invalid time stops caching.
+		static void setCachedNow(Timestamp time) { cachedMicroSeconds_ = time.microSecondsSinceEpoch(); }
+
+		///
+		/// CLOCK_REALTIME_COARSE: no syscall and cheaper than now(),
+		/// only as fine as the kernel tick (1-4ms). now() on Windows.
+		///
+		static Timestamp coarseNow();
+		/// cachedNow() in threads without a loop uses coarseNow().
+		/// Call before starting other threads.
+		static void setCoarseClock(bool on) { coarseClock_ = on; }
+
 		static const int kMicroSecondsPerSecond = 1000 * 1000;
 
 	private:
 		int64_t microSecondsSinceEpoch_;
+
+		static __thread int64_t cachedMicroSeconds_;
+		static bool coarseClock_;
 	};
 
 	inline bool operator<(Timestamp lhs, Timestamp rhs)
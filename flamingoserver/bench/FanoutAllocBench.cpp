@@ -0,0 +1,199 @@
+/**
+ * Heap allocations of an off-loop fan-out send, per recipient.
+ *
+ * A sender thread sends one shared frame to every connection of an io loop,
+ * the way a group chat message is relayed, and counts operator new calls
+ * of all threads until the loop has written everything. The connections
+ * are socketpairs, the other ends are drained between rounds.
+ *
+ * The same rounds are run through the send path the tree had before the
+ * pending-send queue, rebuilt here from public calls: every recipient got
+ * a std::function binding the connection and its own copy of the message
+ * string, queued under a mutex and run in the loop, which then wrote the
+ * string. Only the loop side differs from the original, it is one queued
+ * task per round draining that queue instead of the loop's own vector.
+ *
+ * For reference it also counts what holding the per-batch flush functor
+ * in a std::function costs, which is what queueInLoop took before
+ * EventLoop had its own Task type.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../base/CountDownLatch.h"
+#include "../base/Logging.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/InetAddress.h"
+#include "../net/TcpConnection.h"
+
+using namespace net;
+
+namespace
+{
+	std::atomic<int64_t> g_allocs(0);
+
+	const int kConnections = 1000;
+	const int kRounds = 20;
+	const int kWarmupRounds = 2;
+	const size_t kFrameSize = 200;
+
+	struct Fanout
+	{
+		EventLoop*                  loop;
+		std::vector<TcpConnectionPtr> conns;
+		std::vector<int>            peers;
+		int64_t                     received;
+	};
+
+	// sendRound queues one round off the loop thread, returns allocations per recipient
+	template<typename SendRound>
+	double measure(Fanout* fanout, SendRound sendRound)
+	{
+		std::vector<char> drain(64 * 1024);
+		int64_t measured = 0;
+		for (int round = 0; round < kWarmupRounds + kRounds; ++round)
+		{
+			CountDownLatch flushed(1);
+			int64_t before = g_allocs;
+			sendRound();
+			// runs after everything sendRound queued
+			fanout->loop->queueInLoop([&flushed] { flushed.countDown(); });
+			flushed.wait();
+			int64_t allocs = g_allocs - before;
+
+			if (round >= kWarmupRounds)
+				measured += allocs;
+			for (size_t i = 0; i < fanout->peers.size(); ++i)
+			{
+				ssize_t n;
+				while ((n = ::read(fanout->peers[i], &drain[0], drain.size())) > 0)
+					fanout->received += n;
+			}
+		}
+		return static_cast<double>(measured) / (kRounds * kConnections);
+	}
+
+	void sendString(const TcpConnectionPtr& conn, const std::string& message)
+	{
+		conn->send(message);
+	}
+}
+
+void* operator new(size_t n)
+{
+	++g_allocs;
+	void* p = malloc(n == 0 ? 1 : n);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+int main()
+{
+	Logger::setLogLevel(Logger::WARN);
+
+	EventLoopThread loopThread;
+	Fanout fanout;
+	fanout.loop = loopThread.startLoop();
+	fanout.received = 0;
+	EventLoop* loop = fanout.loop;
+	std::vector<TcpConnectionPtr>& conns = fanout.conns;
+	for (int i = 0; i < kConnections; ++i)
+	{
+		int fds[2];
+		if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0)
+		{
+			perror("socketpair");
+			return 1;
+		}
+		char name[32];
+		snprintf(name, sizeof name, "bench#%d", i);
+		TcpConnectionPtr conn(new TcpConnection(loop, name, fds[0], InetAddress(), InetAddress()));
+		conn->setConnectionCallback(defaultConnectionCallback);
+		conn->setMessageCallback(defaultMessageCallback);
+		conns.push_back(conn);
+		fanout.peers.push_back(fds[1]);
+	}
+
+	CountDownLatch established(1);
+	loop->runInLoop([&conns, &established] {
+		for (size_t i = 0; i < conns.size(); ++i)
+			conns[i]->connectEstablished();
+		established.countDown();
+	});
+	established.wait();
+
+	SharedBuffer frame(new std::string(kFrameSize, 'x'));
+	double current = measure(&fanout, [&conns, &frame] {
+		for (size_t i = 0; i < conns.size(); ++i)
+			conns[i]->send(frame);
+	});
+
+	// the old path, see the top of the file
+	std::string message(*frame);
+	std::mutex mutex;
+	std::vector<std::function<void()> > queued;
+	std::vector<std::function<void()> > running;
+	double old = measure(&fanout, [&] {
+		for (size_t i = 0; i < conns.size(); ++i)
+		{
+			std::function<void()> send(std::bind(&sendString, conns[i], message));
+			std::lock_guard<std::mutex> guard(mutex);
+			queued.push_back(std::move(send));
+		}
+		loop->queueInLoop([&] {
+			{
+				std::lock_guard<std::mutex> guard(mutex);
+				running.swap(queued);
+			}
+			for (size_t i = 0; i < running.size(); ++i)
+				running[i]();
+			running.clear();
+		});
+	});
+
+	printf("off-loop send of a %zu byte frame to %d connections, %d rounds\n", kFrameSize, kConnections, kRounds);
+	printf("  allocations per recipient, shared frame through the pending-send queue: %.3f\n", current);
+	printf("  allocations per recipient, string copy in a std::function per recipient (before): %.3f\n", old);
+	printf("  bytes received: %lld of %lld\n", static_cast<long long>(fanout.received),
+		static_cast<long long>(kFrameSize) * kConnections * (kWarmupRounds + kRounds) * 2);
+
+	{
+		TcpConnectionPtr conn = conns[0];
+		int64_t before = g_allocs;
+		std::function<void()> f(std::bind(&TcpConnection::connected, conn));
+		int64_t functionAllocs = g_allocs - before;
+		before = g_allocs;
+		Task task(std::bind(&TcpConnection::connected, conn));
+		int64_t taskAllocs = g_allocs - before;
+		printf("  std::function holding bind(member, shared_ptr): %lld allocation(s), Task: %lld\n",
+			static_cast<long long>(functionAllocs), static_cast<long long>(taskAllocs));
+	}
+
+	CountDownLatch destroyed(1);
+	loop->runInLoop([&conns, &destroyed] {
+		for (size_t i = 0; i < conns.size(); ++i)
+			conns[i]->connectDestroyed();
+		destroyed.countDown();
+	});
+	destroyed.wait();
+	conns.clear();
+	for (size_t i = 0; i < fanout.peers.size(); ++i)
+		::close(fanout.peers[i]);
+	return 0;
+}
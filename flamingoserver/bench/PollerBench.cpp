@@ -0,0 +1,242 @@
+/**
+ * Echo throughput of one io loop with each poller type.
+ *
+ * The loop accepts kConnections loopback connections and echoes what it
+ * receives. A client thread drives all of them with its own epoll, every
+ * connection keeps kDepth messages in flight, for kSeconds per poller.
+ * The load generator is the same for every run, only the poller of the
+ * server loop changes.
+ *
+ * Printed per echoed message: loop iterations, each one is a single
+ * epoll_wait or io_uring_enter, and CPU time of the loop thread. With
+ * epoll every message also costs a read and a write, with io_uring in
+ * completion mode the receive, the send and the accept go through the
+ * ring and the iteration is the only syscall.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "../base/CountDownLatch.h"
+#include "../base/Logging.h"
+#include "../net/Acceptor.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/InetAddress.h"
+#include "../net/Poller.h"
+#include "../net/TcpConnection.h"
+
+using namespace net;
+
+namespace
+{
+	const int kConnections = 100;
+	const int kDepth = 4;
+	const size_t kMessageSize = 64;
+	const double kSeconds = 2.0;
+
+	double threadCpuSeconds()
+	{
+		struct timespec ts;
+		::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+	}
+
+	double monotonicSeconds()
+	{
+		struct timespec ts;
+		::clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+	}
+
+	// lives in the loop thread
+	class EchoServer
+	{
+	public:
+		EchoServer(EventLoop* loop)
+			: loop_(loop),
+			acceptor_(new Acceptor(loop, InetAddress("127.0.0.1", 0), false)),
+			next_(0)
+		{
+			acceptor_->setNewConnectionCallback(std::bind(&EchoServer::onNewConnection, this, std::placeholders::_1, std::placeholders::_2));
+			acceptor_->listen();
+		}
+
+		~EchoServer()
+		{
+			for (std::set<TcpConnectionPtr>::iterator it = conns_.begin(); it != conns_.end(); ++it)
+				(*it)->connectDestroyed();
+		}
+
+		// net::sockets byte order helpers do not swap, take the port as it is
+		uint16_t port() const { return ntohs(sockets::getLocalAddr(acceptor_->fd()).sin_port); }
+		size_t connections() const { return conns_.size(); }
+
+	private:
+		void onNewConnection(int sockfd, const InetAddress& peerAddr)
+		{
+			char name[32];
+			snprintf(name, sizeof name, "echo#%d", ++next_);
+			TcpConnectionPtr conn(new TcpConnection(loop_, name, sockfd, InetAddress(sockets::getLocalAddr(sockfd)), peerAddr));
+			conn->setConnectionCallback(defaultConnectionCallback);
+			conn->setMessageCallback([](const TcpConnectionPtr& c, Buffer* buf, Timestamp) {
+				c->send(buf->peek(), static_cast<int>(buf->readableBytes()));
+				buf->retrieveAll();
+			});
+			conn->setCloseCallback([this](const TcpConnectionPtr& c) {
+				conns_.erase(c);
+				loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, c));
+			});
+			conns_.insert(conn);
+			conn->connectEstablished();
+		}
+
+		EventLoop*                  loop_;
+		std::unique_ptr<Acceptor>   acceptor_;
+		std::set<TcpConnectionPtr>  conns_;
+		int                         next_;
+	};
+
+	struct Result
+	{
+		int64_t     messages;
+		int64_t     iterations;
+		double      cpuSeconds;
+		double      elapsed;
+	};
+
+	bool runClient(uint16_t port, Result* result)
+	{
+		std::vector<int> fds;
+		int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof addr);
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		std::string message(kMessageSize, 'x');
+		for (int i = 0; i < kConnections; ++i)
+		{
+			int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if (fd < 0 || ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+			{
+				perror("connect");
+				return false;
+			}
+			int one = 1;
+			::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+			for (int d = 0; d < kDepth; ++d)
+				::write(fd, message.data(), message.size());
+			struct epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.fd = fd;
+			::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+			fds.push_back(fd);
+		}
+
+		std::vector<struct epoll_event> events(kConnections);
+		std::vector<char> buf(64 * 1024);
+		int64_t bytes = 0;
+		double start = monotonicSeconds();
+		double now = start;
+		while (now - start < kSeconds)
+		{
+			int n = ::epoll_wait(epfd, &events[0], kConnections, 100);
+			for (int i = 0; i < n; ++i)
+			{
+				int fd = events[i].data.fd;
+				ssize_t r = ::read(fd, &buf[0], buf.size());
+				if (r <= 0)
+				{
+					fprintf(stderr, "echo connection lost\n");
+					return false;
+				}
+				bytes += r;
+				::write(fd, &buf[0], static_cast<size_t>(r));
+			}
+			now = monotonicSeconds();
+		}
+		result->messages = bytes / static_cast<int64_t>(kMessageSize);
+		result->elapsed = now - start;
+
+		// half close and drain, so that the server reads everything and no RST is sent
+		for (size_t i = 0; i < fds.size(); ++i)
+			::shutdown(fds[i], SHUT_WR);
+		for (size_t i = 0; i < fds.size(); ++i)
+		{
+			while (::read(fds[i], &buf[0], buf.size()) > 0)
+				;
+			::close(fds[i]);
+		}
+		::close(epfd);
+		return true;
+	}
+
+	void runOne(Poller::Type type, const char* label)
+	{
+		Poller::setDefaultType(type);
+		EventLoopThread loopThread;
+		EventLoop* loop = loopThread.startLoop();
+
+		std::unique_ptr<EchoServer> server;
+		uint16_t port = 0;
+		CountDownLatch started(1);
+		loop->runInLoop([&] {
+			server.reset(new EchoServer(loop));
+			port = server->port();
+			started.countDown();
+		});
+		started.wait();
+
+		int64_t iterations = 0;
+		double cpu = 0;
+		CountDownLatch sampled(1);
+		loop->runInLoop([&] {
+			iterations = loop->iteration();
+			cpu = threadCpuSeconds();
+			sampled.countDown();
+		});
+		sampled.wait();
+
+		Result result;
+		bool ok = runClient(port, &result);
+
+		CountDownLatch stopped(1);
+		loop->runInLoop([&] {
+			result.iterations = loop->iteration() - iterations;
+			result.cpuSeconds = threadCpuSeconds() - cpu;
+			server.reset();
+			stopped.countDown();
+		});
+		stopped.wait();
+		if (!ok)
+			return;
+
+		printf("%-24s %10.0f msg/s  %6.3f iterations/msg  %6.2f us cpu/msg\n", label,
+			static_cast<double>(result.messages) / result.elapsed,
+			static_cast<double>(result.iterations) / static_cast<double>(result.messages),
+			result.cpuSeconds * 1e6 / static_cast<double>(result.messages));
+	}
+}
+
+int main()
+{
+	Logger::setLogLevel(Logger::WARN);
+
+	printf("echo of %zu byte messages, %d connections, %d in flight each, %.0fs per poller\n",
+		kMessageSize, kConnections, kDepth, kSeconds);
+	runOne(Poller::kEPoll, "epoll");
+	runOne(Poller::kIoUringPoll, "iouring-poll");
+	runOne(Poller::kIoUring, "iouring (completions)");
+	return 0;
+}
@@ -0,0 +1,236 @@
+/**
+ * Calls per second of RpcClient with and without pipelining.
+ *
+ * A server loop answers every frame at once with an empty payload, the
+ * client loop keeps a fixed number of calls in flight for kSeconds, a
+ * call is issued from the callback of the one before it. Each case
+ * changes the pool size and the number of calls in flight:
+ * one call at a time is a lock step round trip, as many calls as
+ * connections is a pool without pipelining, more calls than connections
+ * pipelines them on each connection.
+ */
+#include <stdio.h>
+#include <memory>
+#include <set>
+#include <string>
+
+#include "../base/CountDownLatch.h"
+#include "../base/Logging.h"
+#include "../base/Timestamp.h"
+#include "../net/Acceptor.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/InetAddress.h"
+#include "../net/RpcClient.h"
+#include "../net/TcpConnection.h"
+
+using namespace net;
+
+namespace
+{
+	const int32_t kCmd = 1;
+	const size_t kRequestSize = 128;
+	const double kSeconds = 2.0;
+	const double kCallTimeout = 5.0;
+
+	// lives in the server loop thread
+	class RpcServer
+	{
+	public:
+		RpcServer(EventLoop* loop)
+			: loop_(loop),
+			acceptor_(new Acceptor(loop, InetAddress("127.0.0.1", 0), false)),
+			next_(0)
+		{
+			acceptor_->setNewConnectionCallback(std::bind(&RpcServer::onNewConnection, this, std::placeholders::_1, std::placeholders::_2));
+			acceptor_->listen();
+		}
+
+		~RpcServer()
+		{
+			for (std::set<TcpConnectionPtr>::iterator it = conns_.begin(); it != conns_.end(); ++it)
+				(*it)->connectDestroyed();
+		}
+
+		// net::sockets byte order helpers do not swap, keep the address as the kernel has it
+		InetAddress address() const { return InetAddress(sockets::getLocalAddr(acceptor_->fd())); }
+
+	private:
+		void onNewConnection(int sockfd, const InetAddress& peerAddr)
+		{
+			char name[32];
+			snprintf(name, sizeof name, "rpc#%d", ++next_);
+			TcpConnectionPtr conn(new TcpConnection(loop_, name, sockfd, InetAddress(sockets::getLocalAddr(sockfd)), peerAddr));
+			conn->setConnectionCallback(defaultConnectionCallback);
+			conn->setMessageCallback([](const TcpConnectionPtr& c, Buffer* buf, Timestamp) {
+				int32_t cmd;
+				int32_t seq;
+				std::string payload;
+				std::string frame;
+				while (rpc::decode(buf, &cmd, &seq, &payload) == rpc::kFrame)
+				{
+					rpc::encode(cmd, seq, std::string(), &frame);
+					c->send(frame);
+				}
+			});
+			conn->setCloseCallback([this](const TcpConnectionPtr& c) {
+				conns_.erase(c);
+				loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, c));
+			});
+			conn->setTcpNoDelay(true);
+			conns_.insert(conn);
+			conn->connectEstablished();
+		}
+
+		EventLoop*                  loop_;
+		std::unique_ptr<Acceptor>   acceptor_;
+		std::set<TcpConnectionPtr>  conns_;
+		int                         next_;
+	};
+
+	// lives in the client loop thread, keeps depth calls in flight until the deadline
+	class Driver
+	{
+	public:
+		Driver(RpcClient* client, int depth, CountDownLatch* done)
+			: client_(client),
+			request_(kRequestSize, 'x'),
+			depth_(depth),
+			outstanding_(0),
+			completed_(0),
+			failed_(0),
+			latencyUs_(0),
+			done_(done)
+		{
+		}
+
+		void start()
+		{
+			start_ = Timestamp::now();
+			deadline_ = addTime(start_, kSeconds);
+			for (int i = 0; i < depth_; ++i)
+				issue();
+		}
+
+		int64_t completed() const { return completed_; }
+		int64_t failed() const { return failed_; }
+		double elapsed() const { return timeDifference(end_, start_); }
+		double meanLatencyUs() const { return completed_ > 0 ? static_cast<double>(latencyUs_) / static_cast<double>(completed_) : 0; }
+
+	private:
+		void issue()
+		{
+			++outstanding_;
+			Timestamp sent = Timestamp::now();
+			client_->call(kCmd, request_, kCallTimeout, [this, sent](RpcClient::Status status, const std::string&) {
+				Timestamp now = Timestamp::now();
+				--outstanding_;
+				if (status == RpcClient::kOk)
+				{
+					++completed_;
+					latencyUs_ += now.microSecondsSinceEpoch() - sent.microSecondsSinceEpoch();
+				}
+				else
+				{
+					++failed_;
+				}
+
+				if (now < deadline_ && status == RpcClient::kOk)
+				{
+					issue();
+				}
+				else if (outstanding_ == 0)
+				{
+					end_ = now;
+					done_->countDown();
+				}
+			});
+		}
+
+		RpcClient*          client_;
+		const std::string   request_;
+		const int           depth_;
+		int                 outstanding_;
+		int64_t             completed_;
+		int64_t             failed_;
+		int64_t             latencyUs_;
+		Timestamp           start_;
+		Timestamp           deadline_;
+		Timestamp           end_;
+		CountDownLatch*     done_;
+	};
+
+	void runOne(EventLoop* clientLoop, const InetAddress& serverAddr, int poolSize, int depth)
+	{
+		std::unique_ptr<RpcClient> client;
+		CountDownLatch up(1);
+		CountDownLatch down(1);
+		clientLoop->runInLoop([&] {
+			client.reset(new RpcClient(clientLoop, serverAddr, "bench", poolSize));
+			client->setPoolStateCallback([&up, &down, poolSize](int connected) {
+				if (connected == poolSize)
+					up.countDown();
+				else if (connected == 0)
+					down.countDown();
+			});
+			client->start();
+		});
+		up.wait();
+
+		CountDownLatch done(1);
+		Driver driver(client.get(), depth, &done);
+		clientLoop->runInLoop(std::bind(&Driver::start, &driver));
+		done.wait();
+
+		// the server closes once it reads the half close, destroy the client after all connections are down
+		clientLoop->runInLoop([&] { client->stop(); });
+		down.wait();
+		CountDownLatch destroyed(1);
+		clientLoop->runInLoop([&] {
+			client.reset();
+			destroyed.countDown();
+		});
+		destroyed.wait();
+
+		printf("%2d connections %4d in flight %10.0f calls/s %8.1f us/call", poolSize, depth,
+			static_cast<double>(driver.completed()) / driver.elapsed(), driver.meanLatencyUs());
+		if (driver.failed() > 0)
+			printf("  %lld failed", static_cast<long long>(driver.failed()));
+		printf("\n");
+	}
+}
+
+int main()
+{
+	Logger::setLogLevel(Logger::WARN);
+
+	EventLoopThread serverThread;
+	EventLoop* serverLoop = serverThread.startLoop();
+	std::unique_ptr<RpcServer> server;
+	InetAddress serverAddr;
+	CountDownLatch started(1);
+	serverLoop->runInLoop([&] {
+		server.reset(new RpcServer(serverLoop));
+		serverAddr = server->address();
+		started.countDown();
+	});
+	started.wait();
+
+	EventLoopThread clientThread;
+	EventLoop* clientLoop = clientThread.startLoop();
+
+	printf("%zu byte requests, empty responses, %.0fs per case\n", kRequestSize, kSeconds);
+	// lock step, then a pool without pipelining, then pipelined on one and on several connections
+	runOne(clientLoop, serverAddr, 1, 1);
+	runOne(clientLoop, serverAddr, 4, 4);
+	runOne(clientLoop, serverAddr, 1, 64);
+	runOne(clientLoop, serverAddr, 4, 64);
+
+	CountDownLatch stopped(1);
+	serverLoop->runInLoop([&] {
+		server.reset();
+		stopped.countDown();
+	});
+	stopped.wait();
+	return 0;
+}
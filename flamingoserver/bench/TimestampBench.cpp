@@ -0,0 +1,78 @@
+/**
+ * Cost of reading the time: Timestamp::now(), coarseNow() and cachedNow().
+ *
+ * cachedNow() is measured as a loop thread sees it, with the cache set,
+ * and as a thread without a loop sees it, once reading the precise and
+ * once the coarse clock. The last two lines are a LOG_INFO line, whose
+ * timestamp comes from cachedNow(), with the output thrown away, once
+ * without and once with the cache.
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "../base/Logging.h"
+#include "../base/Timestamp.h"
+
+namespace
+{
+	const int kCalls = 10 * 1000 * 1000;
+	const int kLogLines = 1000 * 1000;
+
+	// keeps the compiler from dropping the reads
+	volatile int64_t g_sink = 0;
+
+	double monotonicSeconds()
+	{
+		struct timespec ts;
+		::clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+	}
+
+	template<typename Read>
+	void runRead(const char* label, Read read)
+	{
+		double start = monotonicSeconds();
+		int64_t sum = 0;
+		for (int i = 0; i < kCalls; ++i)
+			sum += read().microSecondsSinceEpoch();
+		double elapsed = monotonicSeconds() - start;
+		g_sink = sum;
+		printf("%-28s %8.1f ns/call\n", label, elapsed * 1e9 / kCalls);
+	}
+
+	void discardOutput(const char* msg, int len)
+	{
+		g_sink = g_sink + len + msg[0];
+	}
+
+	void runLog(const char* label)
+	{
+		double start = monotonicSeconds();
+		for (int i = 0; i < kLogLines; ++i)
+			LOG_INFO << "bench line " << i << ", user " << 10000 + i;
+		double elapsed = monotonicSeconds() - start;
+		printf("%-28s %8.1f ns/line\n", label, elapsed * 1e9 / kLogLines);
+	}
+}
+
+int main()
+{
+	runRead("now()", [] { return Timestamp::now(); });
+	runRead("coarseNow()", [] { return Timestamp::coarseNow(); });
+
+	Timestamp::setCachedNow(Timestamp::invalid());
+	runRead("cachedNow() without loop", [] { return Timestamp::cachedNow(); });
+	Timestamp::setCoarseClock(true);
+	runRead("cachedNow() coarse clock", [] { return Timestamp::cachedNow(); });
+	Timestamp::setCoarseClock(false);
+	Timestamp::setCachedNow(Timestamp::now());
+	runRead("cachedNow() in a loop", [] { return Timestamp::cachedNow(); });
+
+	Logger::setLogLevel(Logger::INFO);
+	Logger::setOutput(discardOutput);
+	Timestamp::setCachedNow(Timestamp::invalid());
+	runLog("LOG_INFO without cache");
+	Timestamp::setCachedNow(Timestamp::now());
+	runLog("LOG_INFO cached");
+	return 0;
+}
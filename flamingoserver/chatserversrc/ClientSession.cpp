@@ -7,6 +7,7 @@
 #include <sstream>
 #include <list>
 #include "../net/TcpConnection.h"
+#include "../net/Channel.h"
 #include "../net/ProtocolStream.h"
 #include "../base/Logging.h"
 #include "../base/Singleton.h"
@@ -15,6 +16,7 @@
 #include "UserManager.h"
 #include "IMServer.h"
 #include "MsgCacheManager.h"
+#include "ClusterManager.h"
 #include "../zlib1.2.11/ZlibUtil.h"
 #include "BussinessLogic.h"
 
@@ -31,10 +33,12 @@ ClientSession::ClientSession(const std::shared_ptr<TcpConnection>& conn, int ses
 TcpSession(conn), 
 m_id(sessionid),
 m_seq(0),
-m_isLogin(false)
+m_isLogin(false),
+m_overHighWater(false),
+m_highWaterEpisode(0)
 {
 	m_userinfo.userid = 0;
-    m_lastPackageTime = time(NULL);
+    m_lastPackageTime = Timestamp::cachedNow().secondsSinceEpoch();
 
     //ע͵ڵ
     //EnableHearbeatCheck();
@@ -79,11 +83,11 @@ void ClientSession::OnRead(const std::shared_ptr<TcpConnection>& conn, Buffer* p
                 return;
 
             pBuffer->retrieve(sizeof(msg));
-            std::string inbuf;
-            inbuf.append(pBuffer->peek(), header.compresssize);
-            pBuffer->retrieve(header.compresssize);
+            //ֱӴ뻺ѹ
             std::string destbuf;
-            if (!ZlibUtil::UncompressBuf(inbuf, destbuf, header.originsize))
+            bool uncompressed = ZlibUtil::UncompressBuf(pBuffer->peek(), header.compresssize, destbuf, header.originsize);
+            pBuffer->retrieve(header.compresssize);
+            if (!uncompressed)
             {
                 LOG_ERROR << "uncompress error, client: " << conn->peerAddress().toIpPort();
                 conn->forceClose();
@@ -98,7 +102,7 @@ void ClientSession::OnRead(const std::shared_ptr<TcpConnection>& conn, Buffer* p
                 return;
             }
 
-            m_lastPackageTime = time(NULL);
+            m_lastPackageTime = receivTime.secondsSinceEpoch();
         }
         //ݰδѹ
         else
@@ -118,10 +122,10 @@ void ClientSession::OnRead(const std::shared_ptr<TcpConnection>& conn, Buffer* p
                 return;
 
             pBuffer->retrieve(sizeof(msg));
-            std::string inbuf;
-            inbuf.append(pBuffer->peek(), header.originsize);
+            //岻͵ؽٴӻȡ
+            bool processed = Process(conn, pBuffer->peek(), header.originsize);
             pBuffer->retrieve(header.originsize);
-            if (!Process(conn, inbuf.c_str(), inbuf.length()))
+            if (!processed)
             {
                 //ͻ˷Ƿݰر֮
                 LOG_ERROR << "Process error, close TcpConnection, client: " << conn->peerAddress().toIpPort();
@@ -129,7 +133,7 @@ void ClientSession::OnRead(const std::shared_ptr<TcpConnection>& conn, Buffer* p
                 return;
             }
                 
-            m_lastPackageTime = time(NULL);
+            m_lastPackageTime = receivTime.secondsSinceEpoch();
         }// end else
 
     }// end while-loop
@@ -153,7 +157,7 @@ bool ClientSession::Process(const std::shared_ptr<TcpConnection>& conn, const ch
         return false;
     }
 
-    std::string data;
+    StringPiece data;
     size_t datalength;
     if (!readStream.ReadString(&data, 0, datalength))
     {
@@ -246,7 +250,7 @@ bool ClientSession::Process(const std::shared_ptr<TcpConnection>& conn, const ch
                     //ȺϢ
                     case msg_type_multichat:
                     {
-                        std::string targets;
+                        StringPiece targets;
                         size_t targetslength;
                         if (!readStream.ReadString(&targets, 0, targetslength))
                         {
@@ -262,7 +266,7 @@ bool ClientSession::Process(const std::shared_ptr<TcpConnection>& conn, const ch
                     //Ļͼ
                     case msg_type_remotedesktop:
                     {
-                        string bmpHeader;
+                        StringPiece bmpHeader;
                         size_t bmpHeaderlength;
                         if (!readStream.ReadString(&bmpHeader, 0, bmpHeaderlength))
                         {
@@ -270,7 +274,7 @@ bool ClientSession::Process(const std::shared_ptr<TcpConnection>& conn, const ch
                             return false;
                         }
 
-                        string bmpData;
+                        StringPiece bmpData;
                         size_t bmpDatalength;
                         if (!readStream.ReadString(&bmpData, 0, bmpDatalength))
                         {
@@ -353,10 +357,10 @@ void ClientSession::OnHeartbeatResponse(const std::shared_ptr<TcpConnection>& co
     //LOG_INFO << "Response to client: cmd=1000" << ", sessionId=" << m_id;
 }
 
-void ClientSession::OnRegisterResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnRegisterResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn)
 {
     string retData;
-    BussinessLogic::RegisterUser(data, conn, true, retData);
+    BussinessLogic::RegisterUser(data.as_string(), conn, true, retData);
 
     if (!retData.empty())
     {
@@ -366,12 +370,42 @@ void ClientSession::OnRegisterResponse(const std::string& data, const std::share
     }
 }
 
-void ClientSession::OnLoginResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnLoginResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn)
+{
+    std::shared_ptr<LoginScheduler> scheduler = Singleton<IMServer>::Instance().GetLoginScheduler();
+    if (!scheduler)
+    {
+        DoLogin(data.as_string(), m_seq, conn);
+        return;
+    }
+
+    //ֵʱm_seqѱĵӦõ¼ԼкšŶʱֻӵָ룬
+    //ӶϿִУsessionloop٣Կthis
+    //Ŷڼ뻺ᱻİǣ¼Ҫһ
+    int32_t seq = m_seq;
+    std::string loginData(data.as_string());
+    std::weak_ptr<TcpConnection> tmpConn(conn);
+    if (scheduler->Submit(conn, [this, loginData, seq, tmpConn]() {
+            std::shared_ptr<TcpConnection> conn = tmpConn.lock();
+            if (conn)
+                DoLogin(loginData, seq, conn);
+        }))
+        return;
+
+    //ÿͻ˹һٵ¼
+    std::ostringstream os;
+    os << "{\"code\": " << error_code_loginretry << ", \"msg\": \"server busy\", \"retryafter\": " << scheduler->GetRetryAfter(m_id) << "}";
+    Send(msg_type_login, seq, os.str());
+
+    LOG_INFO << "Response to client: cmd=msg_type_login, data=" << os.str() << ", client: " << conn->peerAddress().toIpPort();
+}
+
+void ClientSession::DoLogin(const std::string& data, int32_t seq, const std::shared_ptr<TcpConnection>& conn)
 {
     //{"username": "13917043329", "password": "123", "clienttype": 1, "status": 1}
     Json::Reader JsonReader;
     Json::Value JsonRoot;
-    if (!JsonReader.parse(data, JsonRoot))
+    if (!JsonReader.parse(data.data(), data.data() + data.size(), JsonRoot))
     {
         LOG_WARN << "invalid json: " << data << ", sessionId = " << m_id  << ", client: " << conn->peerAddress().toIpPort();
         return;
@@ -409,7 +443,7 @@ void ClientSession::OnLoginResponse(const std::string& data, const std::shared_p
             if (targetSession)
             {                              
                 string dummydata;
-                targetSession->Send(msg_type_kickuser, m_seq, dummydata);
+                targetSession->Send(msg_type_kickuser, seq, dummydata);
                 //ߵSessionΪЧ
                 targetSession->MakeSessionInvalid();
 
@@ -427,6 +461,11 @@ void ClientSession::OnLoginResponse(const std::string& data, const std::shared_p
             m_userinfo.clienttype = JsonRoot["clienttype"].asInt();
             m_userinfo.status = JsonRoot["status"].asInt();
 
+            //ڵͬ͵նҲߣٰѱڵ߸ڵ㣬ǸԵĺ
+            ClusterManager& cluster = Singleton<ClusterManager>::Instance();
+            cluster.ForwardKick(m_userinfo.userid, m_userinfo.clienttype);
+            cluster.OnUserOnline(m_userinfo.userid, m_userinfo.clienttype, m_userinfo.status);
+
             os << "{\"code\": 0, \"msg\": \"ok\", \"userid\": " << m_userinfo.userid << ",\"username\":\"" << cachedUser.username << "\", \"nickname\":\"" 
                << cachedUser.nickname << "\", \"facetype\": " << cachedUser.facetype << ", \"customface\":\"" << cachedUser.customface << "\", \"gender\":" << cachedUser.gender
                << ", \"birthday\":" << cachedUser.birthday << ", \"signature\":\"" << cachedUser.signature << "\", \"address\": \"" << cachedUser.address
@@ -435,7 +474,7 @@ void ClientSession::OnLoginResponse(const std::string& data, const std::shared_p
     }
    
     //¼ϢӦ
-    Send(msg_type_login, m_seq, os.str());
+    Send(msg_type_login, seq, os.str());
 
     LOG_INFO << "Response to client: cmd=msg_type_login, data=" << os.str() << ", userid=" << m_userinfo.userid;
 
@@ -450,9 +489,9 @@ void ClientSession::OnLoginResponse(const std::string& data, const std::shared_p
         Send(iter.notifymsg);
     }
 
-    //Ϣ
+    //Ϣֻȡʱ(clienttypeΪ0)ͬһûնѹתԼ󲹷
     std::list<ChatMsgCache> listChatCache;
-    Singleton<MsgCacheManager>::Instance().GetChatMsgCache(m_userinfo.userid, listChatCache);
+    Singleton<MsgCacheManager>::Instance().GetChatMsgCache(m_userinfo.userid, 0, listChatCache);
     for (const auto &iter : listChatCache)
     {
         Send(iter.chatmsg);
@@ -489,12 +528,12 @@ void ClientSession::OnGetFriendListResponse(const std::shared_ptr<TcpConnection>
     LOG_INFO << "Response to client: userid=" << m_userinfo.userid << ", cmd=msg_type_getofriendlist, data=" << os.str();    
 }
 
-void ClientSession::OnChangeUserStatusResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnChangeUserStatusResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn)
 {
     //{"type": 1, "onlinestatus" : 1}
     Json::Reader JsonReader;
     Json::Value JsonRoot;
-    if (!JsonReader.parse(data, JsonRoot))
+    if (!JsonReader.parse(data.begin(), data.end(), JsonRoot))
     {
         LOG_WARN << "invalid json: " << data << ", userid: " << m_userinfo.userid << ", client: " << conn->peerAddress().toIpPort();
         return;
@@ -510,8 +549,9 @@ void ClientSession::OnChangeUserStatusResponse(const std::string& data, const st
     if (m_userinfo.status == newstatus)
         return;
 
-    //µǰû״̬
+    //µǰû״̬ڵϵĺڽڵ
     m_userinfo.status = newstatus;
+    Singleton<ClusterManager>::Instance().OnUserStatusChange(m_userinfo.userid, m_userinfo.clienttype, newstatus);
 
     //TODO: ӦԼ߿ͻ޸ĳɹ
 
@@ -531,12 +571,12 @@ void ClientSession::OnChangeUserStatusResponse(const std::string& data, const st
     }
 }
 
-void ClientSession::OnFindUserResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnFindUserResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn)
 {
     //{ "type": 1, "username" : "zhangyl" }
     Json::Reader JsonReader;
     Json::Value JsonRoot;
-    if (!JsonReader.parse(data, JsonRoot))
+    if (!JsonReader.parse(data.begin(), data.end(), JsonRoot))
     {
         LOG_WARN << "invalid json: " << data << ", userid: " << m_userinfo.userid << ", client: " << conn->peerAddress().toIpPort();
         return;
@@ -567,11 +607,11 @@ void ClientSession::OnFindUserResponse(const std::string& data, const std::share
     LOG_INFO << "Response to client: userid = " << m_userinfo.userid << ", cmd=msg_type_finduser, data=" << retData;
 }
 
-void ClientSession::OnOperateFriendResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnOperateFriendResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn)
 {
     Json::Reader JsonReader;
     Json::Value JsonRoot;
-    if (!JsonReader.parse(data, JsonRoot))
+    if (!JsonReader.parse(data.begin(), data.end(), JsonRoot))
     {
         LOG_WARN << "invalid json: " << data << ", userid: " << m_userinfo.userid << ", client: " << conn->peerAddress().toIpPort();
         return;
@@ -666,8 +706,10 @@ void ClientSession::OnOperateFriendResponse(const std::string& data, const std::
     //ȿĿûǷ
     std::list<std::shared_ptr<ClientSession>> sessions;
     Singleton<IMServer>::Instance().GetSessionsByUserId(sessions, targetUserid);
+    //Ŀûڵתȥ
+    int forwarded = Singleton<ClusterManager>::Instance().ForwardNotify(targetUserid, outbuf);
     //ĿûߣϢ
-    if (sessions.empty())
+    if (sessions.empty() && forwarded == 0)
     {
         Singleton<MsgCacheManager>::Instance().AddNotifyMsgCache(targetUserid, outbuf);
         LOG_INFO << "userid: " << targetUserid << " is not online, cache notify msg, msg: " << outbuf;
@@ -722,14 +764,16 @@ void ClientSession::OnAddGroupResponse(int32_t groupId, const std::shared_ptr<Tc
             if (iter2)
                 iter2->SendUserStatusChangeMsg(groupId, 3);
         }
+
+        Singleton<ClusterManager>::Instance().ForwardStatus(iter.userid, groupId, 3);
     }
 }
 
-void ClientSession::OnUpdateUserInfoResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnUpdateUserInfoResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn)
 {
     Json::Reader JsonReader;
     Json::Value JsonRoot;
-    if (!JsonReader.parse(data, JsonRoot))
+    if (!JsonReader.parse(data.begin(), data.end(), JsonRoot))
     {
         LOG_WARN << "invalid json: " << data << ", userid: " << m_userinfo.userid << ", client: " << conn->peerAddress().toIpPort();
         return;
@@ -799,14 +843,16 @@ void ClientSession::OnUpdateUserInfoResponse(const std::string& data, const std:
             if (iter2)
                 iter2->SendUserStatusChangeMsg(m_userinfo.userid, 3);
         }
+
+        Singleton<ClusterManager>::Instance().ForwardStatus(iter.userid, m_userinfo.userid, 3);
     }
 }
 
-void ClientSession::OnModifyPasswordResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnModifyPasswordResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn)
 {
     Json::Reader JsonReader;
     Json::Value JsonRoot;
-    if (!JsonReader.parse(data, JsonRoot))
+    if (!JsonReader.parse(data.begin(), data.end(), JsonRoot))
     {
         LOG_WARN << "invalid json: " << data << ", userid: " << m_userinfo.userid << ", client: " << conn->peerAddress().toIpPort();
         return;
@@ -850,11 +896,11 @@ void ClientSession::OnModifyPasswordResponse(const std::string& data, const std:
     LOG_INFO << "Response to client: userid=" << m_userinfo.userid << ", cmd=msg_type_modifypassword, data=" << data;
 }
 
-void ClientSession::OnCreateGroupResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnCreateGroupResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn)
 {
     Json::Reader JsonReader;
     Json::Value JsonRoot;
-    if (!JsonReader.parse(data, JsonRoot))
+    if (!JsonReader.parse(data.begin(), data.end(), JsonRoot))
     {
         LOG_WARN << "invalid json: " << data << ", userid: " << m_userinfo.userid << ", client: " << conn->peerAddress().toIpPort();
         return;
@@ -915,12 +961,12 @@ void ClientSession::OnCreateGroupResponse(const std::string& data, const std::sh
     }
 }
 
-void ClientSession::OnGetGroupMembersResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnGetGroupMembersResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn)
 {
     //{"groupid": Ⱥid}
     Json::Reader JsonReader;
     Json::Value JsonRoot;
-    if (!JsonReader.parse(data, JsonRoot))
+    if (!JsonReader.parse(data.begin(), data.end(), JsonRoot))
     {
         LOG_WARN << "invalid json: " << data << ", userid: " << m_userinfo.userid << ", client: " << conn->peerAddress().toIpPort();
         return;
@@ -968,6 +1014,26 @@ void ClientSession::OnGetGroupMembersResponse(const std::string& data, const std
 
 void ClientSession::SendUserStatusChangeMsg(int32_t userid, int type, int status/* = 0*/)
 {
+    {
+        //ӻѹʱȼ£ͬһûֻµһΣٷ
+        std::lock_guard<std::mutex> guard(m_backpressureMutex);
+        if (m_overHighWater)
+        {
+            BackpressureCounters& counters = Singleton<IMServer>::Instance().GetBackpressureCounters();
+            auto result = m_deferredStatus.insert(std::make_pair(std::make_pair(userid, type == 3), std::make_pair(type, status)));
+            if (!result.second)
+            {
+                result.first->second = std::make_pair(type, status);
+                ++counters.statusCoalesced;
+            }
+            else
+            {
+                ++counters.statusDeferred;
+            }
+            return;
+        }
+    }
+
     string data; 
     //û
     if (type == 1)
@@ -1012,7 +1078,118 @@ bool ClientSession::IsSessionValid()
     return m_userinfo.userid > 0;
 }
 
-void ClientSession::OnChatResponse(int32_t targetid, const std::string& data, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::SendChatMsg(const std::string& outbuf, const SharedBuffer& package/* = SharedBuffer()*/)
+{
+    {
+        //תͻʱȡͬһ½УתϢ©Ҳֱӷ͵Ϣ
+        std::lock_guard<std::mutex> guard(m_backpressureMutex);
+        if (m_overHighWater)
+        {
+            Singleton<MsgCacheManager>::Instance().AddChatMsgCache(m_userinfo.userid, outbuf, m_userinfo.clienttype);
+            ++Singleton<IMServer>::Instance().GetBackpressureCounters().chatsDiverted;
+            return;
+        }
+    }
+
+    if (package)
+        SendSharedPackage(package);
+    else
+        Send(outbuf);
+}
+
+void ClientSession::SendScreenshot(const std::string& outbuf)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_backpressureMutex);
+        if (m_overHighWater)
+        {
+            ++Singleton<IMServer>::Instance().GetBackpressureCounters().screenshotsDropped;
+            return;
+        }
+    }
+
+    //׵Ľͼдڼ併ΪȼͬһloopӵϢ
+    //ֻڽͼδдʱдɻصдָȼժصϢķͲһλص
+    std::shared_ptr<TcpConnection> conn = GetConnectionPtr();
+    if (conn)
+    {
+        conn->getLoop()->runInLoop([conn]() {
+            conn->setPriority(Channel::kLowPriority);
+            conn->setWriteCompleteCallback([](const std::shared_ptr<TcpConnection>& c) {
+                c->setPriority(Channel::kNormalPriority);
+                c->setWriteCompleteCallback(WriteCompleteCallback());
+            });
+        });
+    }
+    Send(outbuf);
+}
+
+void ClientSession::OnHighWaterMark(const std::shared_ptr<TcpConnection>& conn, size_t len)
+{
+    int64_t episode;
+    {
+        std::lock_guard<std::mutex> guard(m_backpressureMutex);
+        m_overHighWater = true;
+        episode = ++m_highWaterEpisode;
+    }
+
+    IMServer& imserver = Singleton<IMServer>::Instance();
+    ++imserver.GetBackpressureCounters().highWaterHits;
+    LOG_WARN << "send queue over high water mark, userid=" << m_userinfo.userid << ", queued bytes=" << len << ", client: " << conn->peerAddress().toIpPort();
+
+    double timeout = imserver.GetSlowConsumerTimeout();
+    if (timeout > 0)
+        conn->getLoop()->runAfter(timeout, std::bind(&ClientSession::CheckSlowConsumer, this, std::weak_ptr<TcpConnection>(conn), episode));
+}
+
+void ClientSession::OnLowWaterMark(const std::shared_ptr<TcpConnection>& conn, size_t len)
+{
+    std::map<std::pair<int32_t, bool>, std::pair<int, int>> deferredStatus;
+    std::list<ChatMsgCache> listChatCache;
+    {
+        std::lock_guard<std::mutex> guard(m_backpressureMutex);
+        m_overHighWater = false;
+        deferredStatus.swap(m_deferredStatus);
+        Singleton<MsgCacheManager>::Instance().GetChatMsgCache(m_userinfo.userid, m_userinfo.clienttype, listChatCache);
+    }
+
+    //loopִУֱӣloop˺ϢǺ
+    for (const auto& iter : listChatCache)
+    {
+        Send(iter.chatmsg);
+    }
+    for (const auto& iter : deferredStatus)
+    {
+        SendUserStatusChangeMsg(iter.first.first, iter.second.first, iter.second.second);
+    }
+
+    BackpressureCounters& counters = Singleton<IMServer>::Instance().GetBackpressureCounters();
+    ++counters.drains;
+    counters.chatsFlushed += listChatCache.size();
+    LOG_INFO << "send queue drained, userid=" << m_userinfo.userid << ", queued bytes=" << len << ", flushed chat msg: " << listChatCache.size()
+             << ", deferred status msg: " << deferredStatus.size() << ", client: " << conn->peerAddress().toIpPort();
+}
+
+void ClientSession::CheckSlowConsumer(const std::weak_ptr<TcpConnection>& tmpConn, int64_t episode)
+{
+    //connectionڣбsessionĻصͻڣthisЧ
+    std::shared_ptr<TcpConnection> conn = tmpConn.lock();
+    if (!conn || !conn->connected())
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(m_backpressureMutex);
+        if (!m_overHighWater || episode != m_highWaterEpisode)
+            return;
+    }
+
+    ++Singleton<IMServer>::Instance().GetBackpressureCounters().disconnects;
+    LOG_WARN << "send queue stays over high water mark, close slow consumer, userid=" << m_userinfo.userid
+             << ", queued bytes=" << conn->outputQueue()->memoryBytes() << ", client: " << conn->peerAddress().toIpPort();
+    conn->forceClose();
+}
+
+void ClientSession::OnChatResponse(int32_t targetid, const StringPiece& data, const std::shared_ptr<TcpConnection>& conn)
 {
     std::string outbuf;
     BinaryWriteStream writeStream(&outbuf);
@@ -1027,21 +1204,24 @@ void ClientSession::OnChatResponse(int32_t targetid, const std::string& data, co
 
     UserManager& userMgr = Singleton<UserManager>::Instance();
     //дϢ¼
-    if (!userMgr.SaveChatMsgToDb(m_userinfo.userid, targetid, data))
+    if (!userMgr.SaveChatMsgToDb(m_userinfo.userid, targetid, data.as_string()))
     {
         LOG_ERROR << "Write chat msg to db error, , senderid = " << m_userinfo.userid << ", targetid = " << targetid << ", chatmsg:" << data;
     }
 
     IMServer& imserver = Singleton<IMServer>::Instance();
     MsgCacheManager& msgCacheMgr = Singleton<MsgCacheManager>::Instance();
+    ClusterManager& cluster = Singleton<ClusterManager>::Instance();
     //Ϣ
     if (targetid < GROUPID_BOUBDARY)
     {
         //ȿĿûǷ
         std::list<std::shared_ptr<ClientSession>> targetSessions;
         imserver.GetSessionsByUserId(targetSessions, targetid);
+        //Ŀûڵϵնڽڵ㷢
+        int forwarded = cluster.ForwardChat(targetid, outbuf);
         //ĿûߣϢ
-        if (targetSessions.empty())
+        if (targetSessions.empty() && forwarded == 0)
         {
             msgCacheMgr.AddChatMsgCache(targetid, outbuf);
         }
@@ -1050,7 +1230,7 @@ void ClientSession::OnChatResponse(int32_t targetid, const std::string& data, co
             for (auto& iter : targetSessions)
             {
                 if (iter)
-                    iter->Send(outbuf);
+                    iter->SendChatMsg(outbuf);
             }
         }
     }
@@ -1061,6 +1241,8 @@ void ClientSession::OnChatResponse(int32_t targetid, const std::string& data, co
         userMgr.GetFriendInfoByUserId(targetid, friends);
         std::string strUserInfo;
         bool userOnline = false;
+        //ȺϢֻѹһΣȺԱͬһ
+        SharedBuffer package;
         for (const auto& iter : friends)
         {
             //ųȺԱеԼ
@@ -1070,18 +1252,23 @@ void ClientSession::OnChatResponse(int32_t targetid, const std::string& data, co
             //ȿĿûǷ
             std::list<std::shared_ptr<ClientSession>> targetSessions;
             imserver.GetSessionsByUserId(targetSessions, iter.userid);
+            int forwarded = cluster.ForwardChat(iter.userid, outbuf);
             //ĿûߣϢ
             if (targetSessions.empty())
             {
-                msgCacheMgr.AddChatMsgCache(iter.userid, outbuf);
+                if (forwarded == 0)
+                    msgCacheMgr.AddChatMsgCache(iter.userid, outbuf);
                 continue;
             }
             else
             {
+                if (!package)
+                    package = TcpSession::MakeSharedPackage(outbuf);
+
                 for (auto& iter2 : targetSessions)
                 {
                     if (iter2)
-                        iter2->Send(outbuf);
+                        iter2->SendChatMsg(outbuf, package);
                 }
             }
         }
@@ -1089,11 +1276,11 @@ void ClientSession::OnChatResponse(int32_t targetid, const std::string& data, co
     
 }
 
-void ClientSession::OnMultiChatResponse(const std::string& targets, const std::string& data, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnMultiChatResponse(const StringPiece& targets, const StringPiece& data, const std::shared_ptr<TcpConnection>& conn)
 {
     Json::Reader JsonReader;
     Json::Value JsonRoot;
-    if (!JsonReader.parse(targets, JsonRoot))
+    if (!JsonReader.parse(targets.begin(), targets.end(), JsonRoot))
     {
         LOG_ERROR << "invalid json: targets: " << targets  << "data: " << data << ", userid: " << m_userinfo.userid << ", client: " << conn->peerAddress().toIpPort();
         return;
@@ -1113,9 +1300,11 @@ void ClientSession::OnMultiChatResponse(const std::string& targets, const std::s
     LOG_INFO << "Send to client: cmd=msg_type_multichat, targets: " << targets << "data : " << data << ", from userid : " << m_userinfo.userid << ", from client : " << conn->peerAddress().toIpPort();
 }
 
-void ClientSession::OnScreenshotResponse(int32_t targetid, const std::string& bmpHeader, const std::string& bmpData, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnScreenshotResponse(int32_t targetid, const StringPiece& bmpHeader, const StringPiece& bmpData, const std::shared_ptr<TcpConnection>& conn)
 {
+    //ͼмףһηã׷ʱݿ
     std::string outbuf;
+    outbuf.reserve(bmpHeader.size() + bmpData.size() + 64);
     BinaryWriteStream writeStream(&outbuf);
     writeStream.WriteInt32(msg_type_remotedesktop);
     writeStream.WriteInt32(m_seq);
@@ -1140,15 +1329,15 @@ void ClientSession::OnScreenshotResponse(int32_t targetid, const std::string& bm
         for (auto& iter : targetSessions)
         {
             if (iter)
-                iter->Send(outbuf);
+                iter->SendScreenshot(outbuf);
         }
     }
 
 }
 
-void ClientSession::OnUpdateTeamInfoResponse(const std::string& teaminfodata, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnUpdateTeamInfoResponse(const StringPiece& teaminfodata, const std::shared_ptr<TcpConnection>& conn)
 {
-    if (!Singleton<UserManager>::Instance().UpdateUserTeamInfoInDb(m_userinfo.userid, teaminfodata))
+    if (!Singleton<UserManager>::Instance().UpdateUserTeamInfoInDb(m_userinfo.userid, teaminfodata.as_string()))
     {
         //TODO: ʧӦͻ
         LOG_ERROR << "Update team info failed, userid: " << m_userinfo.userid << ", teaminfo: " << teaminfodata << ", client: " << conn->peerAddress().toIpPort();
@@ -1166,9 +1355,9 @@ void ClientSession::OnUpdateTeamInfoResponse(const std::string& teaminfodata, co
 }
 
 #ifdef FXN_VERSION
-void ClientSession::OnUploadDeviceInfo(int32_t deviceid, int32_t classtype, int64_t uploadtime, const std::string& strDeviceInfo, const std::shared_ptr<TcpConnection>& conn)
+void ClientSession::OnUploadDeviceInfo(int32_t deviceid, int32_t classtype, int64_t uploadtime, const StringPiece& strDeviceInfo, const std::shared_ptr<TcpConnection>& conn)
 {
-    if (!Singleton<UserManager>::Instance().InsertDeviceInfo(m_userinfo.userid, deviceid, classtype, uploadtime, strDeviceInfo))
+    if (!Singleton<UserManager>::Instance().InsertDeviceInfo(m_userinfo.userid, deviceid, classtype, uploadtime, strDeviceInfo.as_string()))
     {
         LOG_ERROR << "InsertDeviceInfo failed, userid: " << m_userinfo.userid << ", client: " << conn->peerAddress().toIpPort();
         return;
@@ -1270,6 +1459,8 @@ void ClientSession::DeleteFriend(const std::shared_ptr<TcpConnection>& conn, int
                     iter2->SendUserStatusChangeMsg(friendid, 3);
             }
         }
+
+        Singleton<ClusterManager>::Instance().ForwardStatus(iter.userid, friendid, 3);
     }
 
 }
@@ -1415,7 +1606,7 @@ void ClientSession::CheckHeartbeat(const std::shared_ptr<TcpConnection>& conn)
     //        << ", clientType=" << m_userinfo.clienttype
     //        << ", client address: " << conn->peerAddress().toIpPort();
 
-    if (time(NULL) - m_lastPackageTime < MAX_NO_PACKAGE_INTERVAL)
+    if (Timestamp::cachedNow().secondsSinceEpoch() - m_lastPackageTime < MAX_NO_PACKAGE_INTERVAL)
         return;
     
     conn->forceClose();
@@ -4,8 +4,11 @@
  **/
 
 #pragma once
+#include <map>
+#include <mutex>
 #include "../net/Buffer.h"
 #include "../net/TimerId.h"
+#include "../base/StringPiece.h"
 #include "TcpSession.h"
 using namespace net;
 
@@ -77,6 +80,15 @@ public:
      */
     void SendUserStatusChangeMsg(int32_t userid, int type, int status = 0);
 
+    //Ϣӻѹʱת浽Ϣ棬󲹷packageΪoutbufѹɹİΪ
+    void SendChatMsg(const std::string& outbuf, const SharedBuffer& package = SharedBuffer());
+    //ͽӻѹʱֱӶ
+    void SendScreenshot(const std::string& outbuf);
+
+    //Ӵݳˮλͻ䵽ˮλ£loopе
+    void OnHighWaterMark(const std::shared_ptr<TcpConnection>& conn, size_t len);
+    void OnLowWaterMark(const std::shared_ptr<TcpConnection>& conn, size_t len);
+
     //SessionʧЧڱߵûsession
     void MakeSessionInvalid();
     bool IsSessionValid();
@@ -88,28 +100,31 @@ public:
     void CheckHeartbeat(const std::shared_ptr<TcpConnection>& conn);
 
 private:
+    //inbufΪһİ壬ӵ뻺õStringPieceָֻڴڼЧ
     bool Process(const std::shared_ptr<TcpConnection>& conn, const char* inbuf, size_t buflength);
     
     void OnHeartbeatResponse(const std::shared_ptr<TcpConnection>& conn);
-    void OnRegisterResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn);
-    void OnLoginResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn);
+    void OnRegisterResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn);
+    void OnLoginResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn);
+    //¼¼ŶʱֵloopеãseqΪ¼к
+    void DoLogin(const std::string& data, int32_t seq, const std::shared_ptr<TcpConnection>& conn);
     void OnGetFriendListResponse(const std::shared_ptr<TcpConnection>& conn);
-    void OnFindUserResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn);
-    void OnChangeUserStatusResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn);
-    void OnOperateFriendResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn);
+    void OnFindUserResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn);
+    void OnChangeUserStatusResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn);
+    void OnOperateFriendResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn);
     void OnAddGroupResponse(int32_t groupId, const std::shared_ptr<TcpConnection>& conn);
-    void OnUpdateUserInfoResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn);
-    void OnModifyPasswordResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn);
-    void OnCreateGroupResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn);
-    void OnGetGroupMembersResponse(const std::string& data, const std::shared_ptr<TcpConnection>& conn);
-    void OnChatResponse(int32_t targetid, const std::string& data, const std::shared_ptr<TcpConnection>& conn);
-    void OnMultiChatResponse(const std::string& targets, const std::string& data, const std::shared_ptr<TcpConnection>& conn);
-    void OnScreenshotResponse(int32_t targetid, const std::string& bmpHeader, const std::string& bmpData, const std::shared_ptr<TcpConnection>& conn);
-    void OnUpdateTeamInfoResponse(const std::string& teaminfodata, const std::shared_ptr<TcpConnection>& conn);
+    void OnUpdateUserInfoResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn);
+    void OnModifyPasswordResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn);
+    void OnCreateGroupResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn);
+    void OnGetGroupMembersResponse(const StringPiece& data, const std::shared_ptr<TcpConnection>& conn);
+    void OnChatResponse(int32_t targetid, const StringPiece& data, const std::shared_ptr<TcpConnection>& conn);
+    void OnMultiChatResponse(const StringPiece& targets, const StringPiece& data, const std::shared_ptr<TcpConnection>& conn);
+    void OnScreenshotResponse(int32_t targetid, const StringPiece& bmpHeader, const StringPiece& bmpData, const std::shared_ptr<TcpConnection>& conn);
+    void OnUpdateTeamInfoResponse(const StringPiece& teaminfodata, const std::shared_ptr<TcpConnection>& conn);
 
 #ifdef FXN_VERSION
     //ƺ
-    void OnUploadDeviceInfo(int32_t deviceid, int32_t classtype, int64_t uploadtime, const std::string& strDeviceInfo, const std::shared_ptr<TcpConnection>& conn);
+    void OnUploadDeviceInfo(int32_t deviceid, int32_t classtype, int64_t uploadtime, const StringPiece& strDeviceInfo, const std::shared_ptr<TcpConnection>& conn);
 #endif
 
     void DeleteFriend(const std::shared_ptr<TcpConnection>& conn, int32_t friendid);
@@ -117,6 +132,9 @@ private:
     //ûϢװӦͻ˵ĺбϢ
     void MakeUpFriendListInfo(std::string& friendinfo, const std::shared_ptr<TcpConnection>& conn);
 
+    //ˮλslowConsumerTimeout飬episodeλѹδϿ
+    void CheckSlowConsumer(const std::weak_ptr<TcpConnection>& tmpConn, int64_t episode);
+
 private:
     int32_t           m_id;                 //session id
     OnlineUserInfo    m_userinfo;
@@ -124,4 +142,11 @@ private:
     bool              m_isLogin;            //ǰSessionӦûǷѾ¼
     time_t            m_lastPackageTime;    //һշʱ
     TimerId           m_checkOnlineTimerId; //ǷߵĶʱid
+
+    //ͻѹ״̬Ϣĸlooploop
+    std::mutex        m_backpressureMutex;
+    bool              m_overHighWater;      //ݳˮλһδ
+    int64_t           m_highWaterEpisode;   //ڼγˮλ
+    //ѹڼƳٷ͵״̬仯keyΪ(userid, Ƿϱ)valueΪ(type, status)ͬһûֻµ
+    std::map<std::pair<int32_t, bool>, std::pair<int, int>> m_deferredStatus;
 };
\ No newline at end of file
@@ -0,0 +1,839 @@
+/**
+ *  ڵ㼯ȺClusterManager.cpp
+ **/
+#include "ClusterManager.h"
+#include <stdlib.h>
+#include <list>
+#include <sstream>
+#include <vector>
+#include "../net/InetAddress.h"
+#include "../net/ProtocolStream.h"
+#include "../base/Logging.h"
+#include "../base/Singleton.h"
+#include "../utils/StringUtil.h"
+#include "Msg.h"
+#include "IMServer.h"
+#include "ClientSession.h"
+#include "MsgCacheManager.h"
+#include "UserManager.h"
+
+//ڵ֮һĳʱ
+#define CLUSTER_CALL_TIMEOUT    5.0
+//߱ܶһ
+#define CLUSTER_PRESENCE_INTERVAL   0.05
+
+namespace
+{
+    struct PresenceEntry
+    {
+        int32_t     userid;
+        int32_t     clienttype;
+        int32_t     status;
+    };
+
+    //䳤ÿֽڵ7λЧλΪ1ʾ滹
+    void AppendVarint(std::string& out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    bool ReadVarint(const std::string& in, size_t& pos, uint32_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 35 && pos < in.size(); shift += 7)
+        {
+            uint8_t byte = static_cast<uint8_t>(in[pos++]);
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    //useridÿΪuseridһĲclienttype״̬10ʾߣһ35ֽ
+    std::string EncodePresence(const std::map<std::pair<int32_t, int32_t>, int32_t>& entries)
+    {
+        std::string out;
+        out.reserve(entries.size() * 4);
+        uint32_t lastUserId = 0;
+        for (const auto& iter : entries)
+        {
+            uint32_t userid = static_cast<uint32_t>(iter.first.first);
+            AppendVarint(out, userid - lastUserId);
+            AppendVarint(out, static_cast<uint32_t>(iter.first.second));
+            AppendVarint(out, static_cast<uint32_t>(iter.second + 1));
+            lastUserId = userid;
+        }
+        return out;
+    }
+
+    bool DecodePresence(const std::string& in, std::vector<PresenceEntry>& entries)
+    {
+        size_t pos = 0;
+        uint32_t userid = 0;
+        while (pos < in.size())
+        {
+            uint32_t delta;
+            uint32_t clienttype;
+            uint32_t status;
+            if (!ReadVarint(in, pos, delta) || !ReadVarint(in, pos, clienttype) || !ReadVarint(in, pos, status))
+                return false;
+
+            userid += delta;
+            PresenceEntry entry = { static_cast<int32_t>(userid), static_cast<int32_t>(clienttype), static_cast<int32_t>(status) - 1 };
+            entries.push_back(entry);
+        }
+        return true;
+    }
+}
+
+bool ClusterManager::Init(int32_t nodeId, const char* listenIp, short listenPort, const char* peers, EventLoop* loop)
+{
+    if (nodeId == 0)
+        return true;
+
+    if (listenIp == NULL || peers == NULL)
+    {
+        LOG_ERROR << "clusterlistenip or clusterpeers is not set, cluster is not enabled";
+        return false;
+    }
+
+    //"2@127.0.0.1:20101,3@127.0.0.1:20102"
+    std::vector<std::string> v;
+    StringUtil::Split(peers, v, ",");
+    for (const auto& iter : v)
+    {
+        size_t at = iter.find('@');
+        size_t colon = iter.rfind(':');
+        if (at == std::string::npos || colon == std::string::npos || colon < at)
+        {
+            LOG_ERROR << "invalid cluster peer: " << iter;
+            return false;
+        }
+
+        int32_t peerId = atoi(iter.substr(0, at).c_str());
+        std::string ip = iter.substr(at + 1, colon - at - 1);
+        uint16_t port = static_cast<uint16_t>(atoi(iter.substr(colon + 1).c_str()));
+        if (peerId == 0 || peerId == nodeId || m_peers.find(peerId) != m_peers.end())
+        {
+            LOG_ERROR << "invalid or duplicate cluster node id: " << iter;
+            return false;
+        }
+
+        Peer& peer = m_peers[peerId];
+        peer.nodeid = peerId;
+        peer.addr = iter.substr(at + 1);
+        //ֻһӣڵ㷢ڶԶ˰˳
+        peer.client.reset(new RpcClient(loop, InetAddress(ip, port), "FLAMINGO-CLUSTER-" + iter.substr(0, at), 1));
+        peer.client->setPoolStateCallback(std::bind(&ClusterManager::OnPeerState, this, peerId, std::placeholders::_1));
+    }
+
+    m_nodeId = nodeId;
+    m_loop = loop;
+
+    InetAddress addr(listenIp, listenPort);
+    m_server.reset(new TcpServer(loop, addr, "FLAMINGO-CLUSTER", TcpServer::kReusePort));
+    m_server->setConnectionCallback(std::bind(&ClusterManager::OnConnection, this, std::placeholders::_1));
+    m_server->start();
+
+    for (auto& iter : m_peers)
+        iter.second.client->start();
+    loop->runEvery(CLUSTER_PRESENCE_INTERVAL, std::bind(&ClusterManager::FlushPresence, this));
+
+    LOG_INFO << "cluster node " << m_nodeId << " listens on " << addr.toIpPort() << ", " << m_peers.size() << " peers";
+    return true;
+}
+
+void ClusterManager::OnUserOnline(int32_t userid, int32_t clienttype, int32_t status)
+{
+    if (!IsEnabled())
+        return;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    SetLocalLocked(userid, clienttype, status);
+}
+
+void ClusterManager::OnUserStatusChange(int32_t userid, int32_t clienttype, int32_t status)
+{
+    if (!IsEnabled())
+        return;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    SetLocalLocked(userid, clienttype, status);
+}
+
+void ClusterManager::OnUserOffline(int32_t userid, int32_t clienttype)
+{
+    if (!IsEnabled())
+        return;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    SetLocalLocked(userid, clienttype, kOffline);
+}
+
+void ClusterManager::SetLocalLocked(int32_t userid, int32_t clienttype, int32_t status)
+{
+    std::pair<int32_t, int32_t> key(userid, clienttype);
+    if (status == kOffline)
+    {
+        if (m_localUsers.erase(key) == 0)
+            return;
+    }
+    else
+    {
+        //ڵߵͬն˺µ¼״̬ûͲ
+        auto result = m_localUsers.insert(std::make_pair(key, status));
+        if (!result.second)
+        {
+            if (result.first->second == status)
+                return;
+            result.first->second = status;
+        }
+    }
+
+    auto result = m_pendingDeltas.insert(std::make_pair(key, status));
+    if (!result.second)
+    {
+        result.first->second = status;
+        ++m_deltasCoalesced;
+    }
+}
+
+void ClusterManager::FlushPresence()
+{
+    PresenceMap deltas;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_pendingDeltas.empty())
+            return;
+        deltas.swap(m_pendingDeltas);
+    }
+
+    std::string payload;
+    BinaryWriteStream writeStream(&payload);
+    writeStream.WriteInt32(m_nodeId);
+    writeStream.WriteString(EncodePresence(deltas));
+    writeStream.Flush();
+
+    ++m_batchesSent;
+    m_deltasSent += deltas.size();
+    //m_loopֱӷOnPeerStateȫͬύ
+    for (auto& iter : m_peers)
+    {
+        m_presenceBytes += payload.size();
+        iter.second.client->call(cluster_msg_type_presence, payload, CLUSTER_CALL_TIMEOUT, [](RpcClient::Status, const std::string&) {});
+    }
+}
+
+bool ClusterManager::GetUserPresence(int32_t userid, int32_t& status, int32_t& clienttype)
+{
+    if (!IsEnabled())
+        return false;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto iter = m_directory.find(userid);
+    if (iter == m_directory.end())
+        return false;
+
+    const Presence* chosen = NULL;
+    for (const auto& presence : iter->second)
+    {
+        if (chosen == NULL || presence.clienttype == CLIENT_TYPE_PC)
+            chosen = &presence;
+    }
+    status = chosen->status;
+    clienttype = chosen->clienttype;
+    return true;
+}
+
+int ClusterManager::ForwardChat(int32_t userid, const std::string& outbuf)
+{
+    return Forward(cluster_msg_type_chat, userid, outbuf);
+}
+
+int ClusterManager::ForwardNotify(int32_t userid, const std::string& outbuf)
+{
+    return Forward(cluster_msg_type_notify, userid, outbuf);
+}
+
+int ClusterManager::Forward(int32_t cmd, int32_t userid, const std::string& outbuf)
+{
+    if (!IsEnabled())
+        return 0;
+
+    std::set<int32_t> nodes;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        GetNodesLocked(userid, 0, nodes);
+    }
+    if (nodes.empty())
+        return 0;
+
+    std::string payload;
+    BinaryWriteStream writeStream(&payload);
+    writeStream.WriteInt32(userid);
+    writeStream.WriteString(outbuf);
+    writeStream.Flush();
+
+    bool chat = (cmd == cluster_msg_type_chat);
+    for (const auto& node : nodes)
+    {
+        if (chat)
+            ++m_chatsForwarded;
+        else
+            ++m_notifiesForwarded;
+
+        //û͵ķ뱾ڵĻ棬ʱĶԶ˿Ѿյʱظ
+        Call(node, cmd, payload, [this, chat, node, userid, outbuf](RpcClient::Status status, const std::string&) {
+            if (status == RpcClient::kOk)
+                return;
+
+            ++m_forwardFailures;
+            if (chat)
+                Singleton<MsgCacheManager>::Instance().AddChatMsgCache(userid, outbuf);
+            else
+                Singleton<MsgCacheManager>::Instance().AddNotifyMsgCache(userid, outbuf);
+            LOG_WARN << "forward to cluster node " << node << " failed: " << RpcClient::statusName(status) << ", cache msg for userid: " << userid;
+        });
+    }
+
+    return static_cast<int>(nodes.size());
+}
+
+void ClusterManager::ForwardStatus(int32_t targetid, int32_t userid, int type, int status/* = 0*/)
+{
+    if (!IsEnabled())
+        return;
+
+    std::set<int32_t> nodes;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        GetNodesLocked(targetid, 0, nodes);
+    }
+    if (nodes.empty())
+        return;
+
+    std::string payload;
+    BinaryWriteStream writeStream(&payload);
+    writeStream.WriteInt32(targetid);
+    writeStream.WriteInt32(userid);
+    writeStream.WriteInt32(type);
+    writeStream.WriteInt32(status);
+    writeStream.Flush();
+
+    for (const auto& node : nodes)
+    {
+        ++m_statusForwarded;
+        Call(node, cluster_msg_type_userstatus, payload, [](RpcClient::Status, const std::string&) {});
+    }
+}
+
+void ClusterManager::ForwardKick(int32_t userid, int32_t clienttype)
+{
+    if (!IsEnabled())
+        return;
+
+    std::set<int32_t> nodes;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        GetNodesLocked(userid, clienttype, nodes);
+    }
+    if (nodes.empty())
+        return;
+
+    std::string payload;
+    BinaryWriteStream writeStream(&payload);
+    writeStream.WriteInt32(userid);
+    writeStream.WriteInt32(clienttype);
+    writeStream.Flush();
+
+    for (const auto& node : nodes)
+    {
+        ++m_kicksForwarded;
+        Call(node, cluster_msg_type_kick, payload, [](RpcClient::Status, const std::string&) {});
+        LOG_INFO << "kick userid: " << userid << ", clienttype: " << clienttype << " on cluster node " << node;
+    }
+}
+
+void ClusterManager::GetNodesLocked(int32_t userid, int32_t clienttype, std::set<int32_t>& nodes)
+{
+    auto iter = m_directory.find(userid);
+    if (iter == m_directory.end())
+        return;
+
+    for (const auto& presence : iter->second)
+    {
+        if (clienttype == 0 || presence.clienttype == clienttype)
+            nodes.insert(presence.nodeid);
+    }
+}
+
+bool ClusterManager::Call(int32_t nodeid, int32_t cmd, const std::string& payload, const RpcClient::ResponseCallback& cb)
+{
+    auto iter = m_peers.find(nodeid);
+    if (iter == m_peers.end())
+    {
+        LOG_ERROR << "unknown cluster node: " << nodeid;
+        return false;
+    }
+
+    iter->second.client->call(cmd, payload, CLUSTER_CALL_TIMEOUT, cb);
+    return true;
+}
+
+void ClusterManager::OnPeerState(int32_t nodeid, int connected)
+{
+    if (connected == 0)
+    {
+        LOG_WARN << "link to cluster node " << nodeid << " is down";
+        return;
+    }
+
+    //ԶͬΪ׼֮ǰϡûƳ֮ٵԶҲı
+    std::string payload;
+    size_t count;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        BinaryWriteStream writeStream(&payload);
+        writeStream.WriteInt32(m_nodeId);
+        writeStream.WriteString(EncodePresence(m_localUsers));
+        writeStream.Flush();
+        count = m_localUsers.size();
+    }
+    m_presenceBytes += payload.size();
+    Call(nodeid, cluster_msg_type_sync, payload, [](RpcClient::Status, const std::string&) {});
+
+    LOG_INFO << "link to cluster node " << nodeid << " is up, sync " << count << " terminals in " << payload.size() << " bytes";
+}
+
+void ClusterManager::OnConnection(std::shared_ptr<TcpConnection> conn)
+{
+    if (conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+        conn->setMessageCallback(std::bind(&ClusterManager::OnMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        LOG_INFO << "cluster connection from " << conn->peerAddress().toIpPort();
+        return;
+    }
+
+    //ֻԸΪ׼Ľڵ㣬û
+    int32_t nodeid = 0;
+    std::vector<PresenceChange> changes;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (auto iter = m_nodeConn.begin(); iter != m_nodeConn.end(); ++iter)
+        {
+            if (iter->second == conn->name())
+            {
+                nodeid = iter->first;
+                RemoveNodeLocked(nodeid, changes);
+                m_nodeConn.erase(iter);
+                break;
+            }
+        }
+    }
+    if (nodeid == 0)
+        return;
+
+    LOG_WARN << "cluster node " << nodeid << " disconnected, remove " << changes.size() << " terminals";
+    OnPresenceChanged(nodeid, changes);
+}
+
+void ClusterManager::OnMessage(const std::shared_ptr<TcpConnection>& conn, Buffer* pBuffer, Timestamp receiveTime)
+{
+    int32_t cmd;
+    int32_t seq;
+    std::string payload;
+    rpc::DecodeResult result;
+    while ((result = rpc::decode(pBuffer, &cmd, &seq, &payload)) == rpc::kFrame)
+    {
+        std::string response;
+        if (!Process(conn, cmd, payload, response))
+        {
+            LOG_ERROR << "invalid cluster msg, cmd: " << cmd << ", from: " << conn->peerAddress().toIpPort();
+            conn->forceClose();
+            return;
+        }
+
+        std::string frame;
+        rpc::encode(cmd, seq, response, &frame);
+        conn->send(std::move(frame));
+    }
+
+    if (result == rpc::kInvalid)
+    {
+        LOG_ERROR << "invalid cluster frame from " << conn->peerAddress().toIpPort() << ", close it";
+        conn->forceClose();
+    }
+}
+
+bool ClusterManager::Process(const std::shared_ptr<TcpConnection>& conn, int32_t cmd, const std::string& payload, std::string& response)
+{
+    switch (cmd)
+    {
+    case cluster_msg_type_sync:
+        return OnSync(conn, payload);
+
+    case cluster_msg_type_presence:
+        return OnPresence(conn, payload);
+
+    case cluster_msg_type_chat:
+        return OnDeliver(true, payload, response);
+
+    case cluster_msg_type_notify:
+        return OnDeliver(false, payload, response);
+
+    case cluster_msg_type_userstatus:
+        return OnUserStatus(payload);
+
+    case cluster_msg_type_kick:
+        return OnKick(payload);
+
+    default:
+        return false;
+    }
+}
+
+bool ClusterManager::OnSync(const std::shared_ptr<TcpConnection>& conn, const std::string& payload)
+{
+    BinaryReadStream readStream(payload.c_str(), payload.length());
+    int32_t nodeid;
+    std::string encoded;
+    size_t encodedLength;
+    std::vector<PresenceEntry> entries;
+    if (!readStream.ReadInt32(nodeid) || !readStream.ReadString(&encoded, 0, encodedLength) || !DecodePresence(encoded, entries))
+        return false;
+
+    if (nodeid == m_nodeId || m_peers.find(nodeid) == m_peers.end())
+    {
+        LOG_ERROR << "sync from unknown cluster node " << nodeid << ", " << conn->peerAddress().toIpPort();
+        return false;
+    }
+
+    //ֻк֪ĲһĲ仯·Ѳյһ
+    std::vector<PresenceChange> changes;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        PresenceMap synced;
+        for (const auto& iter : entries)
+            synced[std::make_pair(iter.userid, iter.clienttype)] = iter.status;
+
+        std::vector<std::pair<int32_t, int32_t>> gone;
+        for (const auto& iter : m_directory)
+        {
+            for (const auto& presence : iter.second)
+            {
+                if (presence.nodeid == nodeid && synced.find(std::make_pair(iter.first, presence.clienttype)) == synced.end())
+                    gone.push_back(std::make_pair(iter.first, presence.clienttype));
+            }
+        }
+        for (const auto& iter : gone)
+            ApplyLocked(nodeid, iter.first, iter.second, kOffline, changes);
+        for (const auto& iter : synced)
+            ApplyLocked(nodeid, iter.first.first, iter.first.second, iter.second, changes);
+
+        m_nodeConn[nodeid] = conn->name();
+    }
+
+    LOG_INFO << "cluster node " << nodeid << " synced " << entries.size() << " terminals, " << changes.size() << " changed";
+    OnPresenceChanged(nodeid, changes);
+
+    //ýڵϿڼ仺ϢߵѾ油
+    std::set<int32_t> cachedUserIds;
+    Singleton<MsgCacheManager>::Instance().GetCachedUserIds(cachedUserIds);
+    for (const auto& iter : entries)
+    {
+        if (iter.status != kOffline && cachedUserIds.find(iter.userid) != cachedUserIds.end())
+            FlushCacheTo(nodeid, iter.userid);
+    }
+
+    return true;
+}
+
+bool ClusterManager::OnPresence(const std::shared_ptr<TcpConnection>& conn, const std::string& payload)
+{
+    BinaryReadStream readStream(payload.c_str(), payload.length());
+    int32_t nodeid;
+    std::string encoded;
+    size_t encodedLength;
+    std::vector<PresenceEntry> entries;
+    if (!readStream.ReadInt32(nodeid) || !readStream.ReadString(&encoded, 0, encodedLength) || !DecodePresence(encoded, entries))
+        return false;
+
+    std::vector<PresenceChange> changes;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        //ýڵѾͬϵ
+        auto iter = m_nodeConn.find(nodeid);
+        if (iter == m_nodeConn.end() || iter->second != conn->name())
+        {
+            m_staleIgnored += entries.size();
+            return true;
+        }
+
+        for (const auto& entry : entries)
+            ApplyLocked(nodeid, entry.userid, entry.clienttype, entry.status, changes);
+    }
+
+    OnPresenceChanged(nodeid, changes);
+    return true;
+}
+
+void ClusterManager::ApplyLocked(int32_t nodeid, int32_t userid, int32_t clienttype, int32_t status, std::vector<PresenceChange>& changes)
+{
+    auto iter = m_directory.find(userid);
+    if (status == kOffline)
+    {
+        if (iter == m_directory.end())
+            return;
+
+        std::vector<Presence>& presences = iter->second;
+        for (size_t i = 0; i < presences.size(); ++i)
+        {
+            if (presences[i].nodeid == nodeid && presences[i].clienttype == clienttype)
+            {
+                presences.erase(presences.begin() + i);
+                PresenceChange change = { userid, kOffline, false };
+                changes.push_back(change);
+                break;
+            }
+        }
+        if (presences.empty())
+            m_directory.erase(iter);
+        return;
+    }
+
+    std::vector<Presence>& presences = (iter == m_directory.end() ? m_directory[userid] : iter->second);
+    for (auto& presence : presences)
+    {
+        if (presence.nodeid == nodeid && presence.clienttype == clienttype)
+        {
+            if (presence.status != status)
+            {
+                presence.status = status;
+                PresenceChange change = { userid, status, false };
+                changes.push_back(change);
+            }
+            return;
+        }
+    }
+
+    Presence presence = { nodeid, clienttype, status };
+    presences.push_back(presence);
+    PresenceChange change = { userid, status, true };
+    changes.push_back(change);
+}
+
+void ClusterManager::RemoveNodeLocked(int32_t nodeid, std::vector<PresenceChange>& changes)
+{
+    for (auto iter = m_directory.begin(); iter != m_directory.end();)
+    {
+        std::vector<Presence>& presences = iter->second;
+        for (size_t i = 0; i < presences.size();)
+        {
+            if (presences[i].nodeid == nodeid)
+            {
+                presences.erase(presences.begin() + i);
+                PresenceChange change = { iter->first, kOffline, false };
+                changes.push_back(change);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        if (presences.empty())
+            iter = m_directory.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+void ClusterManager::OnPresenceChanged(int32_t nodeid, const std::vector<PresenceChange>& changes)
+{
+    if (changes.empty())
+        return;
+
+    UserManager& userManager = Singleton<UserManager>::Instance();
+    IMServer& imserver = Singleton<IMServer>::Instance();
+    for (const auto& change : changes)
+    {
+        //ڱڵϵĺɱڵͣöԶת
+        std::list<User> friends;
+        userManager.GetFriendInfoByUserId(change.userid, friends);
+        for (const auto& iter : friends)
+        {
+            std::list<std::shared_ptr<ClientSession>> sessions;
+            imserver.GetSessionsByUserId(sessions, iter.userid);
+            for (auto& iter2 : sessions)
+            {
+                if (!iter2)
+                    continue;
+
+                if (change.status == kOffline)
+                    iter2->SendUserStatusChangeMsg(change.userid, 2);
+                else
+                    iter2->SendUserStatusChangeMsg(change.userid, 1, change.status);
+            }
+        }
+
+        if (change.added)
+            FlushCacheTo(nodeid, change.userid);
+    }
+}
+
+void ClusterManager::FlushCacheTo(int32_t nodeid, int32_t userid)
+{
+    //ֻȡûʱģ򱾽ڵӻѹתɱڵsession
+    std::list<ChatMsgCache> listChatCache;
+    Singleton<MsgCacheManager>::Instance().GetChatMsgCache(userid, 0, listChatCache);
+    std::list<NotifyMsgCache> listNotifyCache;
+    Singleton<MsgCacheManager>::Instance().GetNotifyMsgCache(userid, listNotifyCache);
+    if (listChatCache.empty() && listNotifyCache.empty())
+        return;
+
+    for (const auto& iter : listNotifyCache)
+    {
+        std::string payload;
+        BinaryWriteStream writeStream(&payload);
+        writeStream.WriteInt32(userid);
+        writeStream.WriteString(iter.notifymsg);
+        writeStream.Flush();
+        std::string notifymsg = iter.notifymsg;
+        Call(nodeid, cluster_msg_type_notify, payload, [this, userid, notifymsg](RpcClient::Status status, const std::string&) {
+            if (status != RpcClient::kOk)
+            {
+                ++m_forwardFailures;
+                Singleton<MsgCacheManager>::Instance().AddNotifyMsgCache(userid, notifymsg);
+            }
+        });
+    }
+
+    for (const auto& iter : listChatCache)
+    {
+        std::string payload;
+        BinaryWriteStream writeStream(&payload);
+        writeStream.WriteInt32(userid);
+        writeStream.WriteString(iter.chatmsg);
+        writeStream.Flush();
+        std::string chatmsg = iter.chatmsg;
+        Call(nodeid, cluster_msg_type_chat, payload, [this, userid, chatmsg](RpcClient::Status status, const std::string&) {
+            if (status != RpcClient::kOk)
+            {
+                ++m_forwardFailures;
+                Singleton<MsgCacheManager>::Instance().AddChatMsgCache(userid, chatmsg);
+            }
+        });
+    }
+
+    LOG_INFO << "flush " << listNotifyCache.size() << " notify msgs and " << listChatCache.size() << " chat msgs of userid: " << userid << " to cluster node " << nodeid;
+}
+
+bool ClusterManager::OnDeliver(bool chat, const std::string& payload, std::string& response)
+{
+    BinaryReadStream readStream(payload.c_str(), payload.length());
+    int32_t userid;
+    std::string outbuf;
+    size_t outbuflength;
+    if (!readStream.ReadInt32(userid) || !readStream.ReadString(&outbuf, 0, outbuflength))
+        return false;
+
+    ++m_delivered;
+    std::list<std::shared_ptr<ClientSession>> sessions;
+    Singleton<IMServer>::Instance().GetSessionsByUserId(sessions, userid);
+    //ת;ûѾߣڱڵ㣬ûʱ
+    if (sessions.empty())
+    {
+        if (chat)
+            Singleton<MsgCacheManager>::Instance().AddChatMsgCache(userid, outbuf);
+        else
+            Singleton<MsgCacheManager>::Instance().AddNotifyMsgCache(userid, outbuf);
+    }
+
+    for (auto& iter : sessions)
+    {
+        if (!iter)
+            continue;
+
+        if (chat)
+            iter->SendChatMsg(outbuf);
+        else
+            iter->Send(outbuf);
+    }
+
+    BinaryWriteStream writeStream(&response);
+    writeStream.WriteInt32(static_cast<int32_t>(sessions.size()));
+    writeStream.Flush();
+    return true;
+}
+
+bool ClusterManager::OnUserStatus(const std::string& payload)
+{
+    BinaryReadStream readStream(payload.c_str(), payload.length());
+    int32_t targetid;
+    int32_t userid;
+    int32_t type;
+    int32_t status;
+    if (!readStream.ReadInt32(targetid) || !readStream.ReadInt32(userid) || !readStream.ReadInt32(type) || !readStream.ReadInt32(status))
+        return false;
+
+    std::list<std::shared_ptr<ClientSession>> sessions;
+    Singleton<IMServer>::Instance().GetSessionsByUserId(sessions, targetid);
+    for (auto& iter : sessions)
+    {
+        if (iter)
+            iter->SendUserStatusChangeMsg(userid, type, status);
+    }
+
+    return true;
+}
+
+bool ClusterManager::OnKick(const std::string& payload)
+{
+    BinaryReadStream readStream(payload.c_str(), payload.length());
+    int32_t userid;
+    int32_t clienttype;
+    if (!readStream.ReadInt32(userid) || !readStream.ReadInt32(clienttype))
+        return false;
+
+    std::shared_ptr<ClientSession> targetSession;
+    Singleton<IMServer>::Instance().GetSessionByUserIdAndClientType(targetSession, userid, clienttype);
+    if (!targetSession)
+        return true;
+
+    std::string dummydata;
+    targetSession->Send(msg_type_kickuser, 0, dummydata);
+    //ߵSessionΪЧģӶϿʱ״̬
+    targetSession->MakeSessionInvalid();
+    OnUserOffline(userid, clienttype);
+
+    LOG_INFO << "Response to client: userid=" << userid << ", cmd=msg_type_kickuser, kicked by another cluster node";
+    return true;
+}
+
+std::string ClusterManager::GetInfo()
+{
+    if (!IsEnabled())
+        return "";
+
+    std::ostringstream os;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        os << "cluster node " << m_nodeId << ": local terminals: " << m_localUsers.size() << ", remote users: " << m_directory.size()
+           << ", synced nodes: " << m_nodeConn.size() << ", deltas pending: " << m_pendingDeltas.size() << "\n";
+    }
+    for (const auto& iter : m_peers)
+        os << "node " << iter.first << " (" << iter.second.addr << "): " << iter.second.client->info();
+    os << "presence batches: " << m_batchesSent << ", deltas: " << m_deltasSent << ", coalesced: " << m_deltasCoalesced
+       << ", bytes: " << m_presenceBytes << ", stale deltas ignored: " << m_staleIgnored << "\n"
+       << "forwarded chats: " << m_chatsForwarded << ", notifies: " << m_notifiesForwarded
+       << ", status changes: " << m_statusForwarded << ", kicks: " << m_kicksForwarded << "\n"
+       << "forward failures cached: " << m_forwardFailures << ", delivered from other nodes: " << m_delivered << "\n";
+    return os.str();
+}
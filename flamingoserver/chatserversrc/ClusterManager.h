@@ -0,0 +1,155 @@
+/**
+ *  ڵ㼯ȺClusterManager.h
+ **/
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../net/TcpServer.h"
+#include "../net/EventLoop.h"
+#include "../net/RpcClient.h"
+
+using namespace net;
+
+//chatserverɼȺÿڵԼĽڵidڵļȺַ
+//ÿڵ㶼һڵû߱userid(ڽڵ, clienttype, ״̬)
+//ڵûߡߺ͸ı״̬ʱ仯ÿһСʱϲһƸڵ㡣
+//״ֱ̬Ӳ鱾صıյĽڵԼڵϵĺ״̬仯
+//ڵû졢֪ͨϱ仯Ϣڵ֮ĳתڽڵ㣬
+//ֻκνڵ϶ûиûʱŷϢ档
+//ÿԶֻһӣ˳򵽴ԶˡӽȫͬһΣ
+//ԶֻһͬڵӣӶϿʱڵб
+class ClusterManager final
+{
+public:
+    ClusterManager() = default;
+    ~ClusterManager() = default;
+
+    ClusterManager(const ClusterManager& rhs) = delete;
+    ClusterManager& operator =(const ClusterManager& rhs) = delete;
+
+    //peersΪڵ㣬ʽΪ"ڵid@ip:port"Զŷָloop̡߳IMServerʼ֮ǰ
+    bool Init(int32_t nodeId, const char* listenIp, short listenPort, const char* peers, EventLoop* loop);
+
+    bool IsEnabled() const
+    {
+        return m_nodeId != 0;
+    }
+
+    int32_t GetNodeId() const
+    {
+        return m_nodeId;
+    }
+
+    //ڵûߡı״̬ߣܵһƸڵ㣬̰߳ȫ
+    void OnUserOnline(int32_t userid, int32_t clienttype, int32_t status);
+    void OnUserStatusChange(int32_t userid, int32_t clienttype, int32_t status);
+    void OnUserOffline(int32_t userid, int32_t clienttype);
+
+    //useridڵϵ״̬ͿͻͣеʱȡԵģ߷false
+    bool GetUserPresence(int32_t userid, int32_t& status, int32_t& clienttype);
+
+    //תڵϵuseridתĽڵ0ʾڵ϶ûиû
+    //תʧ֪ܵͨϢ뱾ڵĻ棬ûٴʱ
+    int ForwardChat(int32_t userid, const std::string& outbuf);
+    int ForwardNotify(int32_t userid, const std::string& outbuf);
+    //useridϱ仯ƸڵϵtargetidtypeͬClientSession::SendUserStatusChangeMsg
+    void ForwardStatus(int32_t targetid, int32_t userid, int type, int status = 0);
+    //useridclienttypeڱڵ¼ߵڵͬ͵ն
+    void ForwardKick(int32_t userid, int32_t clienttype);
+
+    //Զӡ߱Сתͳƣδʱؿմ
+    std::string GetInfo();
+
+private:
+    struct Peer
+    {
+        int32_t                     nodeid;
+        std::string                 addr;
+        std::unique_ptr<RpcClient>  client;
+    };
+
+    //ڵϵһն
+    struct Presence
+    {
+        int32_t     nodeid;
+        int32_t     clienttype;
+        int32_t     status;
+    };
+
+    //߱һ仯statusΪkOfflineʾߣaddedʾߵն
+    struct PresenceChange
+    {
+        int32_t     userid;
+        int32_t     status;
+        bool        added;
+    };
+
+    //(userid, clienttype) -> status
+    typedef std::map<std::pair<int32_t, int32_t>, int32_t> PresenceMap;
+
+    static const int32_t kOffline = -1;
+
+    //±ڵһն˵ı仯ǰѼ
+    void SetLocalLocked(int32_t userid, int32_t clienttype, int32_t status);
+    //µжԶˣm_loopжʱ
+    void FlushPresence();
+    //Զ˵ӽϿm_loopе
+    void OnPeerState(int32_t nodeid, int connected);
+    void OnConnection(std::shared_ptr<TcpConnection> conn);
+    void OnMessage(const std::shared_ptr<TcpConnection>& conn, Buffer* pBuffer, Timestamp receiveTime);
+    //Զ˵һʽԷfalse
+    bool Process(const std::shared_ptr<TcpConnection>& conn, int32_t cmd, const std::string& payload, std::string& response);
+
+    bool OnSync(const std::shared_ptr<TcpConnection>& conn, const std::string& payload);
+    bool OnPresence(const std::shared_ptr<TcpConnection>& conn, const std::string& payload);
+    bool OnDeliver(bool chat, const std::string& payload, std::string& response);
+    bool OnUserStatus(const std::string& payload);
+    bool OnKick(const std::string& payload);
+
+    //޸nodeid߱еһб仯ʱǵchangesǰѼ
+    void ApplyLocked(int32_t nodeid, int32_t userid, int32_t clienttype, int32_t status, std::vector<PresenceChange>& changes);
+    //ɾnodeidбǰѼ
+    void RemoveNodeLocked(int32_t nodeid, std::vector<PresenceChange>& changes);
+    //ڵϵĺnodeidû״̬仯ߵĲϢ
+    void OnPresenceChanged(int32_t nodeid, const std::vector<PresenceChange>& changes);
+
+    //ѱڵ㻺useridϢߵnodeid
+    void FlushCacheTo(int32_t nodeid, int32_t userid);
+    //ָڵ㣬Ƿиýڵ
+    bool Call(int32_t nodeid, int32_t cmd, const std::string& payload, const RpcClient::ResponseCallback& cb);
+    int Forward(int32_t cmd, int32_t userid, const std::string& outbuf);
+    //useridڵڵ㣬clienttypeΪ0ʱնͣǰѼ
+    void GetNodesLocked(int32_t userid, int32_t clienttype, std::set<int32_t>& nodes);
+
+private:
+    int32_t                                                 m_nodeId{0};
+    EventLoop*                                              m_loop{nullptr};
+    std::shared_ptr<TcpServer>                              m_server;
+    std::map<int32_t, Peer>                                 m_peers;            //Init֮ٸı
+
+    std::mutex                                              m_mutex;            //³Աio looploop
+    PresenceMap                                             m_localUsers;       //ڵն
+    PresenceMap                                             m_pendingDeltas;    //ûƸڵı仯ͬһնֻµ
+    std::unordered_map<int32_t, std::vector<Presence>>      m_directory;        //userid -> ڵϵն
+    std::map<int32_t, std::string>                          m_nodeConn;         //ڵid -> һͬӵ
+
+    std::atomic<int64_t>                                    m_batchesSent{0};       //Ƴ
+    std::atomic<int64_t>                                    m_deltasSent{0};        //Ƴ
+    std::atomic<int64_t>                                    m_deltasCoalesced{0};   //ǰͬһն˸µı仯ǵ
+    std::atomic<int64_t>                                    m_presenceBytes{0};     //ȫֽͬ
+    std::atomic<int64_t>                                    m_chatsForwarded{0};
+    std::atomic<int64_t>                                    m_notifiesForwarded{0};
+    std::atomic<int64_t>                                    m_statusForwarded{0};
+    std::atomic<int64_t>                                    m_kicksForwarded{0};
+    std::atomic<int64_t>                                    m_forwardFailures{0};   //תʧת浽Ϣ
+    std::atomic<int64_t>                                    m_delivered{0};         //ڵת֪ͨϢ
+    std::atomic<int64_t>                                    m_staleIgnored{0};      //ԾӱԵ
+};
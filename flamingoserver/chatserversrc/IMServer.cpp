@@ -2,18 +2,49 @@
  *  ࣬IMServer.cpp
  *  zhangyl 2017.03.09
  **/
+#include <sstream>
 #include "../net/InetAddress.h"
+#include "../net/AdmissionController.h"
+#include "../net/MemoryReclaimer.h"
 #include "../base/Logging.h"
 #include "../base/Singleton.h"
 #include "IMServer.h"
 #include "ClientSession.h"
 #include "UserManager.h"
+#include "ClusterManager.h"
 
-bool IMServer::Init(const char* ip, short port, EventLoop* loop)
+bool IMServer::Init(const char* ip, short port, EventLoop* loop, const AcceptConfig& acceptConfig/* = AcceptConfig()*/)
 {   
     InetAddress addr(ip, port);
     m_server.reset(new TcpServer(loop, addr, "FLAMINGO-SERVER", TcpServer::kReusePort));
     m_server->setConnectionCallback(std::bind(&IMServer::OnConnection, this, std::placeholders::_1));
+    if (acceptConfig.acceptExclusive)
+        m_server->enableExclusiveAccept();
+    else if (acceptConfig.perLoopAccept)
+        m_server->enablePerLoopAccept(acceptConfig.acceptSteering);
+    if (acceptConfig.acceptBatch > 0)
+        m_server->setMaxAcceptsPerRound(acceptConfig.acceptBatch);
+    //κһƲſ׼
+    if (acceptConfig.acceptRate > 0 || acceptConfig.maxConnections > 0 || acceptConfig.maxConnectionsPerIp > 0)
+    {
+        m_admission.reset(new AdmissionController(acceptConfig.acceptRate, acceptConfig.acceptBurst, acceptConfig.maxConnections, acceptConfig.maxConnectionsPerIp));
+        m_server->setAdmissionController(m_admission);
+    }
+    //ӹ黹ڴ棬Ƶӵڴ
+    if (acceptConfig.idleReclaimSeconds > 0 || acceptConfig.connectionMemoryBudget > 0)
+    {
+        m_reclaimer.reset(new MemoryReclaimer(acceptConfig.idleReclaimSeconds, acceptConfig.connectionMemoryBudget, acceptConfig.disconnectOverBudget));
+        m_server->setMemoryReclaimer(m_reclaimer);
+    }
+    m_coalesceWrites = acceptConfig.coalesceWrites;
+    m_sendHighWaterMark = acceptConfig.sendHighWaterMark;
+    m_sendLowWaterMark = acceptConfig.sendLowWaterMark;
+    if (m_sendLowWaterMark == 0 || m_sendLowWaterMark >= m_sendHighWaterMark)
+        m_sendLowWaterMark = m_sendHighWaterMark / 4;
+    m_slowConsumerTimeout = acceptConfig.slowConsumerTimeout;
+    //籩ʱ¼ŶӴ
+    if (acceptConfig.loginConcurrency > 0)
+        m_loginScheduler.reset(new LoginScheduler(acceptConfig.loginConcurrency, acceptConfig.loginQueueSize, acceptConfig.loginRetryAfter));
     //
     m_server->start();
 
@@ -27,6 +58,14 @@ void IMServer::OnConnection(std::shared_ptr<TcpConnection> conn)
         //LOG_INFO << "client connected:" << conn->peerAddress().toIpPort();
         ++m_sessionId;
         std::shared_ptr<ClientSession> spSession(new ClientSession(conn, m_sessionId));
+        //¼Ӧ𡢻֪ͨϢ״̬͵͵İϲд
+        conn->setCoalesceWrites(m_coalesceWrites);
+        //ĿͻˣˮλɶϢӣ󲹷صsessionsessionֻconnectionָ
+        if (m_sendHighWaterMark > 0)
+        {
+            conn->setHighWaterMarkCallback(std::bind(&ClientSession::OnHighWaterMark, spSession, std::placeholders::_1, std::placeholders::_2), m_sendHighWaterMark);
+            conn->setLowWaterMarkCallback(std::bind(&ClientSession::OnLowWaterMark, spSession, std::placeholders::_1, std::placeholders::_2), m_sendLowWaterMark);
+        }
         conn->setMessageCallback(std::bind(&ClientSession::OnRead, spSession.get(), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));       
 
         std::lock_guard<std::mutex> guard(m_sessionMutex);
@@ -63,6 +102,8 @@ void IMServer::OnClose(const std::shared_ptr<TcpConnection>& conn)
                 //ߺѣϢ
                 std::list<User> friends;
                 int32_t offlineUserId = (*iter)->GetUserId();
+                //ڵϵĺڽڵ
+                Singleton<ClusterManager>::Instance().OnUserOffline(offlineUserId, (*iter)->GetClientType());
                 userManager.GetFriendInfoByUserId(offlineUserId, friends);
                 for (const auto& iter2 : friends)
                 {
@@ -138,39 +179,105 @@ bool IMServer::GetSessionsByUserId(std::list<std::shared_ptr<ClientSession>>& se
 
 int32_t IMServer::GetUserStatusByUserId(int32_t userid)
 {
-    std::lock_guard<std::mutex> guard(m_sessionMutex);
-    for (const auto& iter : m_sessions)
     {
-        if (iter->GetUserId() == userid)
+        std::lock_guard<std::mutex> guard(m_sessionMutex);
+        for (const auto& iter : m_sessions)
         {
-            return iter->GetUserStatus();
+            if (iter->GetUserId() == userid)
+            {
+                return iter->GetUserStatus();
+            }
         }
     }
 
-    return 0;
+    //ڱڵ㣬鼯Ⱥ߱
+    int32_t status = 0;
+    int32_t clientType = CLIENT_TYPE_UNKOWN;
+    Singleton<ClusterManager>::Instance().GetUserPresence(userid, status, clientType);
+    return status;
 }
 
 int32_t IMServer::GetUserClientTypeByUserId(int32_t userid)
 {
-    std::lock_guard<std::mutex> guard(m_sessionMutex);
     bool bMobileOnline = false;
     int clientType = CLIENT_TYPE_UNKOWN;
-    for (const auto& iter : m_sessions)
     {
-        if (iter->GetUserId() == userid)
-        {   
-            clientType = iter->GetUserClientType();
-            //ֱӷص״̬
-            if (clientType == CLIENT_TYPE_PC)
-                return clientType;
-            else if (clientType == CLIENT_TYPE_ANDROID || clientType == CLIENT_TYPE_IOS)
-                bMobileOnline = true;
+        std::lock_guard<std::mutex> guard(m_sessionMutex);
+        for (const auto& iter : m_sessions)
+        {
+            if (iter->GetUserId() == userid)
+            {   
+                clientType = iter->GetUserClientType();
+                //ֱӷص״̬
+                if (clientType == CLIENT_TYPE_PC)
+                    return clientType;
+                else if (clientType == CLIENT_TYPE_ANDROID || clientType == CLIENT_TYPE_IOS)
+                    bMobileOnline = true;
+            }
         }
     }
 
+    //ڵϵҲص״̬
+    int32_t remoteStatus = 0;
+    int32_t remoteClientType = CLIENT_TYPE_UNKOWN;
+    bool bRemoteOnline = Singleton<ClusterManager>::Instance().GetUserPresence(userid, remoteStatus, remoteClientType);
+    if (bRemoteOnline && remoteClientType == CLIENT_TYPE_PC)
+        return remoteClientType;
+
     //ֻֻ߲ŷֻ״̬
     if (bMobileOnline)
         return clientType;
+    if (bRemoteOnline && (remoteClientType == CLIENT_TYPE_ANDROID || remoteClientType == CLIENT_TYPE_IOS))
+        return remoteClientType;
 
     return CLIENT_TYPE_UNKOWN;
+}
+
+std::vector<int64_t> IMServer::GetAcceptCounts()
+{
+    if (!m_server)
+        return std::vector<int64_t>();
+
+    return m_server->acceptCounts();
+}
+
+std::string IMServer::GetAdmissionInfo()
+{
+    if (!m_admission)
+        return "";
+
+    return m_admission->info();
+}
+
+std::string IMServer::GetMemoryInfo()
+{
+    if (!m_reclaimer)
+        return "";
+
+    return m_reclaimer->info();
+}
+
+std::string IMServer::GetBackpressureInfo()
+{
+    if (m_sendHighWaterMark == 0)
+        return "";
+
+    const BackpressureCounters& c = m_backpressureCounters;
+    std::ostringstream os;
+    os << "high water mark: " << m_sendHighWaterMark << " bytes, low water mark: " << m_sendLowWaterMark
+       << " bytes, slow consumer timeout: " << m_slowConsumerTimeout << " s\n"
+       << "high water hits: " << c.highWaterHits << ", drains: " << c.drains << "\n"
+       << "status deferred: " << c.statusDeferred << ", coalesced: " << c.statusCoalesced << "\n"
+       << "screenshots dropped: " << c.screenshotsDropped << "\n"
+       << "chats diverted to cache: " << c.chatsDiverted << ", flushed from cache: " << c.chatsFlushed << "\n"
+       << "slow consumer disconnects: " << c.disconnects << "\n";
+    return os.str();
+}
+
+std::string IMServer::GetLoginInfo()
+{
+    if (!m_loginScheduler)
+        return "";
+
+    return m_loginScheduler->GetInfo();
 }
\ No newline at end of file
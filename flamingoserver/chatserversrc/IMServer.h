@@ -3,6 +3,7 @@
  *  zhangyl 2017.03.09
  **/
 #pragma once
+#include <atomic>
 #include <memory>
 #include <list>
 #include <map>
@@ -10,6 +11,7 @@
 #include "../net/TcpServer.h"
 #include "../net/EventLoop.h"
 #include "ClientSession.h"
+#include "LoginScheduler.h"
 
 using namespace net;
 
@@ -22,6 +24,42 @@ enum CLIENT_TYPE
     CLIENT_TYPE_MAC
 };
 
+//׼롢ڴպͷͻѹصãchatserver.conf
+struct AcceptConfig
+{
+    bool    perLoopAccept{false};       //ÿio loopSO_REUSEPORT
+    bool    acceptSteering{false};      //CBPFӾȷָloop
+    bool    acceptExclusive{false};     //io loopһsocketEPOLLEXCLUSIVEע
+    int     acceptBatch{0};             //ÿοɶ¼accept0ΪĬֵ
+    double  acceptRate{0};              //ÿܵ0Ϊ
+    int     acceptBurst{0};             //Ͱ
+    int     maxConnections{0};          //0Ϊ
+    int     maxConnectionsPerIp{0};     //ip0Ϊ
+    double  idleReclaimSeconds{0};      //ӿж黹仺ڴ棬0Ϊ黹
+    size_t  connectionMemoryBudget{0};  //ӻڴޣʱ0Ϊ
+    bool    disconnectOverBudget{false};//ԳϿ
+    bool    coalesceWrites{false};      //һloopڷͬһӵݺϲһwritev
+    size_t  sendHighWaterMark{0};       //ӴݳֵϲɶϢϢת浽Ϣ棬0Ϊ
+    size_t  sendLowWaterMark{0};        //ݻ䵽ֵʱ0Ϊˮλķ֮һ
+    double  slowConsumerTimeout{0};     //ˮλδϿӣ0ΪϿ
+    int     loginConcurrency{0};        //ͬʱĵ¼Ŷӣ0ΪŶ
+    int     loginQueueSize{0};          //Ŷӵĵ¼ʱÿͻԺԣ0Ϊ
+    int     loginRetryAfter{5};         //ʱͻԵʵټ0ֵĶ
+};
+
+//߱ѹļ
+struct BackpressureCounters
+{
+    std::atomic<int64_t>    highWaterHits{0};       //ӳˮλĴ
+    std::atomic<int64_t>    drains{0};              //䵽ˮλµĴ
+    std::atomic<int64_t>    statusDeferred{0};      //Ƴٵ͵״̬仯Ϣ
+    std::atomic<int64_t>    statusCoalesced{0};     //ͬһûµ״̬ǵϢ
+    std::atomic<int64_t>    screenshotsDropped{0};  //Ľ
+    std::atomic<int64_t>    chatsDiverted{0};       //ת浽ϢϢ
+    std::atomic<int64_t>    chatsFlushed{0};        //Ϣ油Ϣ
+    std::atomic<int64_t>    disconnects{0};         //ʱδϿ
+};
+
 struct StoredUserInfo
 {
     int32_t         userid;
@@ -39,7 +77,7 @@ public:
     IMServer(const IMServer& rhs) = delete;
     IMServer& operator =(const IMServer& rhs) = delete;
 
-    bool Init(const char* ip, short port, EventLoop* loop);
+    bool Init(const char* ip, short port, EventLoop* loop, const AcceptConfig& acceptConfig = AcceptConfig());
 
     void GetSessions(std::list<std::shared_ptr<ClientSession>>& sessions);
     //ûidclienttypeΨһȷһsession
@@ -47,11 +85,37 @@ public:
 
     bool GetSessionsByUserId(std::list<std::shared_ptr<ClientSession>>& sessions, int32_t userid);
 
-    //ȡû״̬ûڣ򷵻0
+    //ȡû״̬ûڣ򷵻0ڱڵʱ鼯Ⱥ߱
     int32_t GetUserStatusByUserId(int32_t userid);
-    //ȡûͻͣûڣ򷵻0
+    //ȡûͻͣûڣ򷵻0ڱڵʱ鼯Ⱥ߱
     int32_t GetUserClientTypeByUserId(int32_t userid);
 
+    //ÿAcceptorܵ
+    std::vector<int64_t> GetAcceptCounts();
+    //׼ƵͳϢδʱؿմ
+    std::string GetAdmissionInfo();
+    //io loopӻռյͳƣδʱؿմ
+    std::string GetMemoryInfo();
+
+    double GetSlowConsumerTimeout()
+    {
+        return m_slowConsumerTimeout;
+    }
+    BackpressureCounters& GetBackpressureCounters()
+    {
+        return m_backpressureCounters;
+    }
+    //ͻѹĴͳƣδʱؿմ
+    std::string GetBackpressureInfo();
+
+    //¼ŶӵȣδʱΪ
+    std::shared_ptr<LoginScheduler> GetLoginScheduler()
+    {
+        return m_loginScheduler;
+    }
+    //¼Ŷӵͳƣδʱؿմ
+    std::string GetLoginInfo();
+
 private:
     //ӵûӶϿҪͨconn->connected()жϣһֻloop
     void OnConnection(std::shared_ptr<TcpConnection> conn);  
@@ -61,6 +125,14 @@ private:
 
 private:
     std::shared_ptr<TcpServer>                     m_server;
+    std::shared_ptr<AdmissionController>           m_admission;
+    std::shared_ptr<MemoryReclaimer>               m_reclaimer;
+    bool                                           m_coalesceWrites{false};
+    size_t                                         m_sendHighWaterMark{0};
+    size_t                                         m_sendLowWaterMark{0};
+    double                                         m_slowConsumerTimeout{0};
+    BackpressureCounters                           m_backpressureCounters;
+    std::shared_ptr<LoginScheduler>                m_loginScheduler;
     std::list<std::shared_ptr<ClientSession>>      m_sessions;
     std::mutex                                     m_sessionMutex;      //֮߳䱣m_sessions
     int                                            m_sessionId{};
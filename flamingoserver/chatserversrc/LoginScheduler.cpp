@@ -0,0 +1,118 @@
+/** 
+ *  ¼ŶӵȣLoginScheduler.cpp
+ **/
+#include "LoginScheduler.h"
+#include <sstream>
+#include "../base/Timestamp.h"
+#include "../net/EventLoop.h"
+
+LoginScheduler::LoginScheduler(int maxConcurrent, int maxQueue, int retryAfter) :
+    m_maxConcurrent(maxConcurrent),
+    m_maxQueue(maxQueue),
+    m_retryAfter(retryAfter > 0 ? retryAfter : 0)
+{
+
+}
+
+bool LoginScheduler::Submit(const std::shared_ptr<TcpConnection>& conn, const LoginTask& task)
+{
+    std::vector<PendingLogin> ready;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_maxQueue > 0 && m_running >= m_maxConcurrent && static_cast<int>(m_queue.size()) >= m_maxQueue)
+        {
+            ++m_rejected;
+            return false;
+        }
+
+        if (m_running >= m_maxConcurrent)
+            ++m_queued;
+        PendingLogin login = { conn, task, Timestamp::cachedNow().microSecondsSinceEpoch() };
+        m_queue.push_back(login);
+        PopReadyLocked(ready);
+    }
+
+    Post(ready);
+    return true;
+}
+
+int LoginScheduler::GetRetryAfter(int32_t sessionid) const
+{
+    return m_retryAfter + static_cast<int>(static_cast<uint32_t>(sessionid) % static_cast<uint32_t>(m_retryAfter + 1));
+}
+
+void LoginScheduler::PopReadyLocked(std::vector<PendingLogin>& ready)
+{
+    while (m_running < m_maxConcurrent && !m_queue.empty())
+    {
+        PendingLogin& login = m_queue.front();
+        if (login.conn.expired())
+        {
+            ++m_abandoned;
+        }
+        else
+        {
+            ++m_running;
+            ready.push_back(login);
+        }
+        m_queue.pop_front();
+    }
+}
+
+void LoginScheduler::Post(const std::vector<PendingLogin>& ready)
+{
+    for (const auto& login : ready)
+    {
+        std::shared_ptr<TcpConnection> conn = login.conn.lock();
+        //ʹǰڸӵloopҲֱִУloopȴ걾ֵ¼
+        if (conn)
+            conn->getLoop()->queueInLoop(std::bind(&LoginScheduler::Run, this, login));
+        else
+            Run(login);
+    }
+}
+
+void LoginScheduler::Run(const PendingLogin& login)
+{
+    //ӻδϿʱsessionҲڣloopһ
+    std::shared_ptr<TcpConnection> conn = login.conn.lock();
+    bool alive = conn && conn->connected();
+    if (alive)
+    {
+        int64_t waitUs = Timestamp::now().microSecondsSinceEpoch() - login.enqueueTime;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            ++m_started;
+            m_totalWaitUs += waitUs;
+            if (waitUs > m_maxWaitUs)
+                m_maxWaitUs = waitUs;
+        }
+        login.task();
+    }
+
+    std::vector<PendingLogin> ready;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (!alive)
+            ++m_abandoned;
+        --m_running;
+        PopReadyLocked(ready);
+    }
+    Post(ready);
+}
+
+std::string LoginScheduler::GetInfo()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    int64_t oldestWaitMs = 0;
+    if (!m_queue.empty())
+        oldestWaitMs = (Timestamp::now().microSecondsSinceEpoch() - m_queue.front().enqueueTime) / 1000;
+
+    std::ostringstream os;
+    os << "max concurrent logins: " << m_maxConcurrent << ", running: " << m_running << "\n"
+       << "queue depth: " << m_queue.size() << ", max: " << m_maxQueue << ", oldest waiting: " << oldestWaitMs << " ms\n"
+       << "started: " << m_started << ", queued: " << m_queued << ", rejected: " << m_rejected
+       << " (retry after " << m_retryAfter << "-" << 2 * m_retryAfter << " s), abandoned: " << m_abandoned << "\n"
+       << "wait avg: " << (m_started > 0 ? m_totalWaitUs / m_started / 1000 : 0) << " ms, max: " << m_maxWaitUs / 1000 << " ms\n";
+    return os.str();
+}
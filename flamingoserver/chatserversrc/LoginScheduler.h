@@ -0,0 +1,68 @@
+/** 
+ *  ¼ŶӵȣLoginScheduler.h
+ **/
+#pragma once
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../net/TcpConnection.h"
+
+using namespace net;
+
+//ͬʱĵ¼ޣఴ˳Ŷӣʱÿͻ˹һԡ
+//ͻͬʱʱ¼ˡϢ״̬ռio loopܼʱ
+class LoginScheduler final
+{
+public:
+    typedef std::function<void()> LoginTask;
+
+    //maxConcurrentΪͬʱĵ¼maxQueueΪŶӵĵ¼0ΪƣretryAfterΪʱͻԵ
+    LoginScheduler(int maxConcurrent, int maxQueue, int retryAfter);
+    ~LoginScheduler() = default;
+
+    LoginScheduler(const LoginScheduler& rhs) = delete;
+    LoginScheduler& operator =(const LoginScheduler& rhs) = delete;
+
+    //taskֵʱconnloopִУŶڼӶϿfalsḛ߳ȫ
+    bool Submit(const std::shared_ptr<TcpConnection>& conn, const LoginTask& task);
+
+    //ܾĿͻ˶ԣsession id϶ٴͬʱӿ
+    int GetRetryAfter(int32_t sessionid) const;
+
+    //гȺŶʱͳ
+    std::string GetInfo();
+
+private:
+    struct PendingLogin
+    {
+        std::weak_ptr<TcpConnection>    conn;
+        LoginTask                       task;
+        int64_t                         enqueueTime;    //ʱ䣬΢
+    };
+
+    //loopִһ¼һ
+    void Run(const PendingLogin& login);
+    //ȡԿʼĵ¼ǰѼ
+    void PopReadyLocked(std::vector<PendingLogin>& ready);
+    //ȡĵ¼Ͷݵloop
+    void Post(const std::vector<PendingLogin>& ready);
+
+private:
+    const int                   m_maxConcurrent;
+    const int                   m_maxQueue;
+    const int                   m_retryAfter;
+
+    std::mutex                  m_mutex;                //³Աio loop
+    std::deque<PendingLogin>    m_queue;
+    int                         m_running{0};           //Ͷݻδִĵ¼
+    int64_t                     m_started{0};           //ѿʼִеĵ¼
+    int64_t                     m_queued{0};            //Źӵĵ¼
+    int64_t                     m_rejected{0};          //ܾĵ¼
+    int64_t                     m_abandoned{0};         //ŶڼӶϿĵ¼
+    int64_t                     m_totalWaitUs{0};       //ʼִǰܵȴʱ
+    int64_t                     m_maxWaitUs{0};
+};
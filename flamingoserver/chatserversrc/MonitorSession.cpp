@@ -7,6 +7,8 @@
 #include <string.h>
 #include <list>
 #include "../net/EventLoopThread.h"
+#include "../net/EventLoopThreadPool.h"
+#include "../net/BufferPool.h"
 #include "../base/Logging.h"
 #include "../base/Singleton.h"
 #include "../utils/StringUtil.h"
@@ -14,6 +16,7 @@
 #include "IMServer.h"
 #include "MonitorServer.h"
 #include "UserManager.h"
+#include "ClusterManager.h"
 
 
 struct HelpInfo
@@ -25,7 +28,15 @@ struct HelpInfo
 const HelpInfo g_helpInfo[] = {
     { "help", "show help info" },
     { "ul",   "show online user list" },
-    { "su", "show userinfo specified by userid: su [userid]" }
+    { "su", "show userinfo specified by userid: su [userid]" },
+    { "as", "show accepted connection count of each acceptor and admission statistics" },
+    { "ls", "show statistics of each io loop" },
+    { "bp", "show hits, misses and bytes in use of the buffer pools" },
+    { "mem", "show connection buffer bytes reserved and in use of each io loop" },
+    { "sc", "show slow consumer backpressure statistics" },
+    { "lq", "show login queue depth, wait time and rejections" },
+    { "cl", "show cluster links, directory size and forwarded messages" },
+    { "lh", "show poll wait, callback, functor and timer lag histograms of each io loop" }
 };
 
 MonitorSession::MonitorSession(std::shared_ptr<TcpConnection>& conn) : m_tmpConn(conn)
@@ -147,6 +158,23 @@ bool MonitorSession::ShowSpecifiedUserInfoByID(int32_t userid)
     return true;
 }
 
+bool MonitorSession::ShowAcceptStatistics()
+{
+    std::vector<int64_t> counts = Singleton<IMServer>::Instance().GetAcceptCounts();
+    std::ostringstream os;
+    int64_t total = 0;
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        os << "acceptor" << i << ": " << counts[i] << "\n";
+        total += counts[i];
+    }
+    os << "total: " << total << "\n";
+    os << Singleton<IMServer>::Instance().GetAdmissionInfo();
+
+    Send(os.str().c_str(), os.str().length());
+    return true;
+}
+
 void MonitorSession::Send(const char* data, size_t length)
 {
     if (!m_tmpConn.expired())
@@ -190,6 +218,53 @@ bool MonitorSession::Process(const std::shared_ptr<TcpConnection>& conn, const s
             }
                 
         }
+        else if (v[0] == g_helpInfo[3].cmd)
+        {
+            ShowAcceptStatistics();
+        }
+        else if (v[0] == g_helpInfo[4].cmd)
+        {
+            std::string info = Singleton<EventLoopThreadPool>::Instance().info();
+            Send(info.c_str(), info.length());
+        }
+        else if (v[0] == g_helpInfo[5].cmd)
+        {
+            std::string info = BufferPool::info();
+            Send(info.c_str(), info.length());
+        }
+        else if (v[0] == g_helpInfo[6].cmd)
+        {
+            std::string info = Singleton<IMServer>::Instance().GetMemoryInfo();
+            if (info.empty())
+                info = "memory reclaim is not enabled\n";
+            Send(info.c_str(), info.length());
+        }
+        else if (v[0] == g_helpInfo[7].cmd)
+        {
+            std::string info = Singleton<IMServer>::Instance().GetBackpressureInfo();
+            if (info.empty())
+                info = "send backpressure is not enabled\n";
+            Send(info.c_str(), info.length());
+        }
+        else if (v[0] == g_helpInfo[8].cmd)
+        {
+            std::string info = Singleton<IMServer>::Instance().GetLoginInfo();
+            if (info.empty())
+                info = "login queue is not enabled\n";
+            Send(info.c_str(), info.length());
+        }
+        else if (v[0] == g_helpInfo[9].cmd)
+        {
+            std::string info = Singleton<ClusterManager>::Instance().GetInfo();
+            if (info.empty())
+                info = "cluster is not enabled\n";
+            Send(info.c_str(), info.length());
+        }
+        else if (v[0] == g_helpInfo[10].cmd)
+        {
+            std::string info = Singleton<EventLoopThreadPool>::Instance().latencyInfo();
+            Send(info.c_str(), info.length());
+        }
         else
         {
             char tip[32] = { "cmd not support\n" };
@@ -39,6 +39,7 @@ private:
     bool Process(const std::shared_ptr<TcpConnection>& conn, const std::string& inbuf);
     bool ShowOnlineUserList(const std::string& token = "");
     bool ShowSpecifiedUserInfoByID(int32_t userid);
+    bool ShowAcceptStatistics();
 
 private:
     std::weak_ptr<TcpConnection>       m_tmpConn;
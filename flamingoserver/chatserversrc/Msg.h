@@ -40,6 +40,18 @@ enum msg_type
 #endif
 };
 
+//chatserverȺڵ֮Э飬֡ʽnet/RpcClient.hӦcmdseqͬ
+enum cluster_msg_type
+{
+    cluster_msg_type_sync = 3000,       //ӽͬڵն
+    cluster_msg_type_presence,          //ڵնߡߺ״̬仯һ
+    cluster_msg_type_chat,              //ͶϢ
+    cluster_msg_type_notify,            //Ͷ֪ͨϢ
+    cluster_msg_type_userstatus,        //ͺ״̬仯
+    cluster_msg_type_kick               //
+    //µֻܼں棬ʱ¾ɽڵҪܻе
+};
+
 //
 enum online_type{
     online_type_offline         = 0,    //
@@ -100,6 +112,7 @@ enum friend_operation_apply_type
  *  105 ޸ʧ
  *  106 Ⱥʧ
  *  107 ͻ˰汾̫ɣҪ°汾
+ *  108 ¼æretryafterٵ¼
  */
 //TODO: ĵطĳ
 enum error_code
@@ -114,7 +127,8 @@ enum error_code
     error_code_updateuserinfofail   = 104,
     error_code_modifypasswordfail   = 105,
     error_code_creategroupfail      = 106,
-    error_code_toooldversion        = 107
+    error_code_toooldversion        = 107,
+    error_code_loginretry           = 108
 };
 
 /**
@@ -143,6 +157,8 @@ enum error_code
     cmd = 1002, seq = 0, {"code": 0, "msg": "ok", "userid": 8, "username": "13917043320", "nickname": "zhangyl",
                           "facetype": 0, "customface":"ļmd5", "gender":0, "birthday":19891208, "signature":"ڳɹ",
                           "address":"Ϻж·3261", "phonenumber":"021-389456", "mail":"balloonwj@qq.com"}
+    //¼Ŷʱ
+    cmd = 1002, seq = 0, {"code": 108, "msg": "server busy", "retryafter": 7}
  **/
 
 /** 
@@ -438,3 +454,20 @@ cmd = 1010, seq = 0, {"code":0, "msg": "ok", "groupid": 12345678,
     cmd = 2001, seq = 0, data()豸id(int32)Ϣclasstype(int32), ϴʱ(int64, UTCʱ)
     cmd = 2001, seq = 0, data: {豸Ϣjson}
 **/
+
+////////////////////////
+//Ⱥڵ֮
+////////////////////////
+/*
+    ֶBinaryWriteStreamд룬outbufΪͻ˵ݰ
+    entriesΪuseridÿΪuseridһ֮clienttype״̬10ʾߣǱ䳤
+    cmd = 3000, seq, ڵid(int32), entries(string)
+    cmd = 3001, seq, ڵid(int32), entries(string)
+    cmd = 3002, seq, userid(int32), outbuf(string)
+    cmd = 3002, seq, Ͷݵն(int32)0ʾѻڶԶ
+    cmd = 3003, seq, userid(int32), outbuf(string)
+    cmd = 3003, seq, Ͷݵն(int32)
+    cmd = 3004, seq, targetid(int32), userid(int32), type(int32), status(int32)
+    cmd = 3005, seq, userid(int32), clienttype(int32)
+    ӦΪ
+**/
@@ -49,11 +49,12 @@ void MsgCacheManager::GetNotifyMsgCache(int32_t userid, std::list<NotifyMsgCache
     LOG_INFO << "get notify msg cache, userid: " << userid << ", m_mapNotifyMsgCache.size(): " << m_listNotifyMsgCache.size() << ", cached size: " << cached.size();
 }
 
-bool MsgCacheManager::AddChatMsgCache(int32_t userid, const std::string& cache)
+bool MsgCacheManager::AddChatMsgCache(int32_t userid, const std::string& cache, int32_t clienttype/* = 0*/)
 {
     std::lock_guard<std::mutex> guard(m_mtChatMsgCache);
     ChatMsgCache c;
     c.userid = userid;
+    c.clienttype = clienttype;
     c.chatmsg.append(cache.c_str(), cache.length());
     m_listChatMsgCache.push_back(c);
     LOG_INFO << "append chat msg to cache, userid: " << userid << ", m_listChatMsgCache.size() : " << m_listChatMsgCache.size() << ", cache length : " << cache.length();
@@ -79,4 +80,39 @@ void MsgCacheManager::GetChatMsgCache(int32_t userid, std::list<ChatMsgCache>& c
     }
 
     LOG_INFO << "get chat msg cache, userid: " << userid << ", m_listChatMsgCache.size(): " << m_listChatMsgCache.size() << ", cached size: " << cached.size();
+}
+
+void MsgCacheManager::GetChatMsgCache(int32_t userid, int32_t clienttype, std::list<ChatMsgCache>& cached)
+{
+    std::lock_guard<std::mutex> guard(m_mtChatMsgCache);
+    for (auto iter = m_listChatMsgCache.begin(); iter != m_listChatMsgCache.end(); )
+    {
+        if (iter->userid == userid && iter->clienttype == clienttype)
+        {
+            cached.push_back(*iter);
+            iter = m_listChatMsgCache.erase(iter);
+        }
+        else
+        {
+            iter++;
+        }
+    }
+
+    LOG_INFO << "get chat msg cache, userid: " << userid << ", clienttype: " << clienttype << ", m_listChatMsgCache.size(): " << m_listChatMsgCache.size() << ", cached size: " << cached.size();
+}
+
+void MsgCacheManager::GetCachedUserIds(std::set<int32_t>& userids)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mtNotifyMsgCache);
+        for (const auto& iter : m_listNotifyMsgCache)
+            userids.insert(iter.userid);
+    }
+
+    std::lock_guard<std::mutex> guard(m_mtChatMsgCache);
+    for (const auto& iter : m_listChatMsgCache)
+    {
+        if (iter.clienttype == 0)
+            userids.insert(iter.userid);
+    }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
  **/
 #pragma once
 #include <list>
+#include <set>
 #include <stdint.h>
 #include <string>
 #include <mutex>
@@ -17,6 +18,7 @@ struct NotifyMsgCache
 struct ChatMsgCache
 {
     int32_t     userid;
+    int32_t     clienttype;     //0ʾûʱģ0ʾնӻѹת
     std::string chatmsg;
 };
 
@@ -32,9 +34,14 @@ public:
     bool AddNotifyMsgCache(int32_t userid, const std::string& cache);
     void GetNotifyMsgCache(int32_t userid, std::list<NotifyMsgCache>& cached);
 
-    bool AddChatMsgCache(int32_t userid, const std::string& cache);
+    bool AddChatMsgCache(int32_t userid, const std::string& cache, int32_t clienttype = 0);
+    //ȡûлϢ
     void GetChatMsgCache(int32_t userid, std::list<ChatMsgCache>& cached);
+    //ֻȡתûָն˵Ϣ
+    void GetChatMsgCache(int32_t userid, int32_t clienttype, std::list<ChatMsgCache>& cached);
 
+    //ʱ֪ͨϢûӻѹת
+    void GetCachedUserIds(std::set<int32_t>& userids);
 
 private:
     std::list<NotifyMsgCache>       m_listNotifyMsgCache;    //֪ͨϢ棬ӺϢ
@@ -2,9 +2,11 @@
  * TcpSession.cpp
  * zhangyl 2017.03.09
  **/
+#include <string.h>
 #include "../base/Logging.h"
 #include "Msg.h"
 #include "../net/ProtocolStream.h"
+#include "../zlib1.2.11/zlib.h"
 #include "../zlib1.2.11/ZlibUtil.h"
 #include "TcpSession.h"
 
@@ -45,26 +47,54 @@ void TcpSession::Send(const char* p, int32_t length)
     SendPackage(p, length);
 }
 
-void TcpSession::SendPackage(const char* p, int32_t length)
-{   
-    string srcbuf(p, length);
-    string destbuf;
-    if (!ZlibUtil::CompressBuf(srcbuf, destbuf))
+bool TcpSession::MakePackage(const char* p, int32_t length, std::string& package)
+{
+    //ֱѹͷ棬ͼĴٶ࿽
+    size_t destLength = compressBound(length);
+    package.resize(sizeof(msg) + destLength);
+    if (!ZlibUtil::CompressBuf(p, length, &package[sizeof(msg)], destLength))
     {
+        package.clear();
         LOG_ERROR << "compress buf error";
-        return;
+        return false;
     }
- 
-    string strPackageData;
+    package.resize(sizeof(msg) + destLength);
+
     msg header;
     header.compressflag = 1;
-    header.compresssize = destbuf.length();
+    header.compresssize = destLength;
     header.originsize = length;
 
     //LOG_INFO << "Send data, header length:" << sizeof(header) << ", body length:" << outbuf.length();
-    //һͷ
-    strPackageData.append((const char*)&header, sizeof(header));
-    strPackageData.append(destbuf);
+    //ϰͷ
+    memcpy(&package[0], &header, sizeof(header));
+    return true;
+}
+
+SharedBuffer TcpSession::MakeSharedPackage(const std::string& p)
+{
+    std::shared_ptr<std::string> package = std::make_shared<std::string>();
+    if (!MakePackage(p.c_str(), p.length(), *package))
+        return SharedBuffer();
+
+    return package;
+}
+
+void TcpSession::SendSharedPackage(const SharedBuffer& package)
+{
+    if (!package)
+        return;
+
+    std::shared_ptr<TcpConnection> conn = tmpConn_.lock();
+    if (conn)
+        conn->send(package);
+}
+
+void TcpSession::SendPackage(const char* p, int32_t length)
+{   
+    string strPackageData;
+    if (!MakePackage(p, length, strPackageData))
+        return;
 
     //TODO: ЩSessionconnectionҪúһ
     if (tmpConn_.expired())
@@ -80,6 +110,6 @@ void TcpSession::SendPackage(const char* p, int32_t length)
         //size_t length = strPackageData.length();
         //LOG_INFO << "Send data, length:" << length;
         //LOG_DEBUG_BIN((unsigned char*)strSendData.c_str(), length);
-        conn->send(strPackageData);
+        conn->send(std::move(strPackageData));
     }
 }
\ No newline at end of file
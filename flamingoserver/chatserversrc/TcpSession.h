@@ -33,8 +33,13 @@ public:
     void Send(const std::string& p);
     void Send(const char* p, int32_t length);
 
+    //ѹϰͷɵİ޸ģԷӶؿָ
+    static SharedBuffer MakeSharedPackage(const std::string& p);
+    void SendSharedPackage(const SharedBuffer& package);
+
 private:
     void SendPackage(const char* p, int32_t length);
+    static bool MakePackage(const char* p, int32_t length, std::string& package);
 
 protected:
     //TcpSessionTcpConnectionָ룬ΪTcpConnectionܻԼ٣ʱTcpSessionӦҲҪ
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -14,12 +15,17 @@
 #include "../base/Singleton.h"
 #include "../base/ConfigFileReader.h"
 #include "../base/AsyncLogging.h"
+#include "../base/CpuAffinity.h"
 #include "../net/EventLoop.h"
 #include "../net/EventLoopThreadPool.h"
+#include "../net/Poller.h"
+#include "../net/BufferPool.h"
+#include "../net/HotUpgrade.h"
 #include "../mysql/MysqlManager.h"
 #include "../utils/DaemonRun.h"
 #include "UserManager.h"
 #include "IMServer.h"
+#include "ClusterManager.h"
 #include "MonitorServer.h"
 #include "HttpServer.h"
 
@@ -103,8 +109,22 @@ int main(int argc, char* argv[])
     //AsyncLogging log(strLogFileFullPath.c_str(), kRollSize);
     g_asyncLog.setBaseName(strLogFileFullPath.c_str());
     g_asyncLog.setRollSize(kRollSize);
+    //io loop߳(־ݿ)д־ʱʱӣΪںtickҪ֮߳ǰ
+    const char* coarseclock = config.GetConfigName("coarseclock");
+    if (coarseclock != NULL && atoi(coarseclock) != 0)
+        Timestamp::setCoarseClock(true);
+    //־̰߳󶨵cpunumaڵ㣬logcpus=0-1lognumanode=0򲻰
+    CpuAffinity::Placement logPlacement;
+    if (!CpuAffinity::parsePlacement(config.GetConfigName("logcpus"), config.GetConfigName("lognumanode"), &logPlacement))
+        LOG_ERROR << "invalid logcpus or lognumanode, log thread is not pinned";
+    else if (!logPlacement.empty())
+        g_asyncLog.setThreadStartCallback(std::bind(&CpuAffinity::bindCurrentThread, logPlacement, 0, "log"));
     g_asyncLog.start();
     Logger::setOutput(asyncOutput);
+    LOG_INFO << "cpu topology: " << CpuAffinity::topology();
+
+    //ɾɽʱӹsocketTcpServerbind
+    HotUpgrade::inheritListeners();
 
     //ʼݿ
     const char* dbserver = config.GetConfigName("dbserver");
@@ -121,12 +141,138 @@ int main(int argc, char* argv[])
         LOG_FATAL << "Init UserManager failed, please check your database config..............";
     }
 
-    Singleton<EventLoopThreadPool>::Instance().Init(&g_mainLoop, 4);
-    Singleton<EventLoopThreadPool>::Instance().start();
+    //շڴôҳҪκӽ֮ǰ
+    const char* bufferhugepages = config.GetConfigName("bufferhugepages");
+    if (bufferhugepages != NULL && atoi(bufferhugepages) != 0)
+        BufferPool::enableHugePages();
+
+    //io loopĶʱʱ֣ÿỰҶʱʱɾҲO(1)ûΪ0ԭ򼯺
+    double timerWheelTick = 0.0;
+    const char* timerwheeltick = config.GetConfigName("timerwheeltick");
+    if (timerwheeltick != NULL)
+        timerWheelTick = atof(timerwheeltick);
+    //io loopʹõpollerepolliouring(ģʽ)iouring-poll(ֻpoll)loopʼepoll
+    const char* poller = config.GetConfigName("poller");
+    if (poller != NULL && strcmp(poller, "iouring") == 0)
+        Poller::setDefaultType(Poller::kIoUring);
+    else if (poller != NULL && strcmp(poller, "iouring-poll") == 0)
+        Poller::setDefaultType(Poller::kIoUringPoll);
+
+    //io loopϵsocketԱԵע
+    const char* edgetriggered = config.GetConfigName("edgetriggered");
+    bool edgeTriggered = (edgetriggered != NULL && atoi(edgetriggered) != 0);
+    //io loop¼æѯ΢ٻصȴԿʱcpuӳ٣0Ϊæѯ
+    const char* busypollus = config.GetConfigName("busypollus");
+    int busyPollUs = busypollus != NULL ? atoi(busypollus) : 0;
+    //socketSO_BUSY_POLL΢ҪCAP_NET_ADMIN߲net.core.busy_read
+    const char* socketbusypollus = config.GetConfigName("socketbusypollus");
+    int socketBusyPollUs = socketbusypollus != NULL ? atoi(socketbusypollus) : 0;
+    //io loopÿַַ¼΢Ԥ㣬󴫽ͼȴݵĵȼһ֣0Ϊ
+    const char* dispatchbudgetus = config.GetConfigName("dispatchbudgetus");
+    int dispatchBudgetUs = dispatchbudgetus != NULL ? atoi(dispatchbudgetus) : 0;
+    //io loopÿͳpollȴصʱض˿lh鿴ÿֶʱ
+    const char* loopstats = config.GetConfigName("loopstats");
+    bool loopStats = (loopstats != NULL && atoi(loopstats) != 0);
+    EventLoopThreadPool::ThreadInitCallback loopInitCallback = [timerWheelTick, edgeTriggered, busyPollUs, socketBusyPollUs, dispatchBudgetUs, loopStats](EventLoop* loop) {
+        if (timerWheelTick > 0.0)
+            loop->useTimingWheel(timerWheelTick);
+        loop->setEdgeTriggered(edgeTriggered);
+        loop->setBusyPoll(busyPollUs, socketBusyPollUs);
+        loop->setDispatchBudget(dispatchBudgetUs);
+        loop->setLatencyStats(loopStats);
+    };
+
+    //io loop߳Լ󶨵cpunumaڵ㡣loopcpus=each:0-3ʾÿloopռһcpu
+    //ֻloopnumanodeʱ󶨵ýڵcpuloopڰ֮ŴڴͻضڱؽڵϷ
+    const char* loopthreads = config.GetConfigName("loopthreads");
+    int loopThreads = loopthreads != NULL ? atoi(loopthreads) : 4;
+    CpuAffinity::Placement loopPlacement;
+    if (!CpuAffinity::parsePlacement(config.GetConfigName("loopcpus"), config.GetConfigName("loopnumanode"), &loopPlacement))
+        LOG_ERROR << "invalid loopcpus or loopnumanode, io loop threads are not pinned";
+    else if (!loopPlacement.empty())
+        Singleton<EventLoopThreadPool>::Instance().setThreadStartCallback(std::bind(&CpuAffinity::bindCurrentThread, loopPlacement, std::placeholders::_1, "io loop"));
+    Singleton<EventLoopThreadPool>::Instance().Init(&g_mainLoop, loopThreads);
+    Singleton<EventLoopThreadPool>::Instance().start(loopInitCallback);
+    //ӷŵĸio loopϣĬѯ
+    const char* loopplacement = config.GetConfigName("loopplacement");
+    EventLoopThreadPool::PlacementPolicy placementPolicy;
+    if (loopplacement != NULL)
+    {
+        if (EventLoopThreadPool::parsePlacementPolicy(loopplacement, &placementPolicy))
+            Singleton<EventLoopThreadPool>::Instance().setPlacementPolicy(placementPolicy);
+        else
+            LOG_ERROR << "unknown loopplacement: " << loopplacement << ", use roundrobin";
+    }
 
     const char* listenip = config.GetConfigName("listenip");
     short listenport = (short)atol(config.GetConfigName("listenport"));
-    Singleton<IMServer>::Instance().Init(listenip, listenport, &g_mainLoop);
+    AcceptConfig acceptConfig;
+    //ÿio loopSO_REUSEPORTloopͳһaccept
+    const char* perloopaccept = config.GetConfigName("perloopaccept");
+    acceptConfig.perLoopAccept = (perloopaccept != NULL && atoi(perloopaccept) != 0);
+    const char* acceptsteering = config.GetConfigName("acceptsteering");
+    acceptConfig.acceptSteering = (acceptsteering != NULL && atoi(acceptsteering) != 0);
+    const char* acceptexclusive = config.GetConfigName("acceptexclusive");
+    acceptConfig.acceptExclusive = (acceptexclusive != NULL && atoi(acceptexclusive) != 0);
+    //׼ƣ
+    const char* acceptbatch = config.GetConfigName("acceptbatch");
+    if (acceptbatch != NULL)
+        acceptConfig.acceptBatch = atoi(acceptbatch);
+    const char* acceptrate = config.GetConfigName("acceptrate");
+    if (acceptrate != NULL)
+        acceptConfig.acceptRate = atof(acceptrate);
+    const char* acceptburst = config.GetConfigName("acceptburst");
+    if (acceptburst != NULL)
+        acceptConfig.acceptBurst = atoi(acceptburst);
+    const char* maxconnections = config.GetConfigName("maxconnections");
+    if (maxconnections != NULL)
+        acceptConfig.maxConnections = atoi(maxconnections);
+    const char* maxconnectionsperip = config.GetConfigName("maxconnectionsperip");
+    if (maxconnectionsperip != NULL)
+        acceptConfig.maxConnectionsPerIp = atoi(maxconnectionsperip);
+    //ӹ黹ڴ棬ӵڴԤ
+    const char* idlereclaimseconds = config.GetConfigName("idlereclaimseconds");
+    if (idlereclaimseconds != NULL)
+        acceptConfig.idleReclaimSeconds = atof(idlereclaimseconds);
+    const char* connectionmemorybudget = config.GetConfigName("connectionmemorybudget");
+    if (connectionmemorybudget != NULL)
+        acceptConfig.connectionMemoryBudget = static_cast<size_t>(atoll(connectionmemorybudget));
+    const char* disconnectoverbudget = config.GetConfigName("disconnectoverbudget");
+    acceptConfig.disconnectOverBudget = (disconnectoverbudget != NULL && atoi(disconnectoverbudget) != 0);
+    //һloopڷͬһӵڱĩβϲһwritev
+    const char* coalescewrites = config.GetConfigName("coalescewrites");
+    acceptConfig.coalesceWrites = (coalescewrites != NULL && atoi(coalescewrites) != 0);
+    const char* sendhighwatermark = config.GetConfigName("sendhighwatermark");
+    if (sendhighwatermark != NULL)
+        acceptConfig.sendHighWaterMark = (size_t)atoll(sendhighwatermark);
+    const char* sendlowwatermark = config.GetConfigName("sendlowwatermark");
+    if (sendlowwatermark != NULL)
+        acceptConfig.sendLowWaterMark = (size_t)atoll(sendlowwatermark);
+    const char* slowconsumertimeout = config.GetConfigName("slowconsumertimeout");
+    if (slowconsumertimeout != NULL)
+        acceptConfig.slowConsumerTimeout = atof(slowconsumertimeout);
+    //¼Ŷӣͬʱĵ¼Ŷʱÿͻ˶
+    const char* loginconcurrency = config.GetConfigName("loginconcurrency");
+    if (loginconcurrency != NULL)
+        acceptConfig.loginConcurrency = atoi(loginconcurrency);
+    const char* loginqueuesize = config.GetConfigName("loginqueuesize");
+    if (loginqueuesize != NULL)
+        acceptConfig.loginQueueSize = atoi(loginqueuesize);
+    const char* loginretryafter = config.GetConfigName("loginretryafter");
+    if (loginretryafter != NULL)
+        acceptConfig.loginRetryAfter = atoi(loginretryafter);
+
+    //ȺڵidΪ0򵥻СҪIMServerʼ֮ǰʼ¼ʱҪõ
+    const char* clusternodeid = config.GetConfigName("clusternodeid");
+    int32_t clusterNodeId = clusternodeid != NULL ? atoi(clusternodeid) : 0;
+    const char* clusterlistenport = config.GetConfigName("clusterlistenport");
+    short clusterListenPort = clusterlistenport != NULL ? (short)atol(clusterlistenport) : 0;
+    if (!Singleton<ClusterManager>::Instance().Init(clusterNodeId, config.GetConfigName("clusterlistenip"), clusterListenPort, config.GetConfigName("clusterpeers"), &g_mainLoop))
+    {
+        LOG_FATAL << "Init cluster failed, please check clusternodeid, clusterlistenip, clusterlistenport and clusterpeers";
+    }
+
+    Singleton<IMServer>::Instance().Init(listenip, listenport, &g_mainLoop, acceptConfig);
 
     const char* monitorlistenip = config.GetConfigName("monitorlistenip");
     short monitorlistenport = (short)atol(config.GetConfigName("monitorlistenport"));
@@ -137,6 +283,50 @@ int main(int argc, char* argv[])
     short httplistenport = (short)atol(config.GetConfigName("httplistenport"));
     Singleton<HttpServer>::Instance().Init(httplistenip, httplistenport, &g_mainLoop);
 
+    //socketѽӹܣ֪ͨɽֹͣaccept
+    HotUpgrade::notifyReady();
+
+    //յSIGUSR2ʱexec򲢰socket½̾󱾽̲accept
+    //upgradedrainsecondsڷϿͻ˷½̣ӶϿ˳
+    const char* upgradedrainseconds = config.GetConfigName("upgradedrainseconds");
+    double upgradeDrainSeconds = upgradedrainseconds != NULL ? atof(upgradedrainseconds) : 60.0;
+    HotUpgrade::enable(&g_mainLoop, argv, [upgradeDrainSeconds]() {
+        const double kDrainTick = 0.5;
+        std::list<std::shared_ptr<ClientSession>> sessions;
+        Singleton<IMServer>::Instance().GetSessions(sessions);
+        size_t ticks = upgradeDrainSeconds > kDrainTick ? static_cast<size_t>(upgradeDrainSeconds / kDrainTick) : 1;
+        size_t perTick = (sessions.size() + ticks - 1) / ticks;
+        if (perTick == 0)
+            perTick = 1;
+        LOG_INFO << "chatserver upgraded, closing " << sessions.size() << " connections in " << upgradeDrainSeconds
+                 << " seconds, " << perTick << " every " << kDrainTick << " seconds";
+
+        g_mainLoop.runEvery(kDrainTick, [perTick]() {
+            std::list<std::shared_ptr<ClientSession>> sessions;
+            Singleton<IMServer>::Instance().GetSessions(sessions);
+            if (sessions.empty())
+            {
+                LOG_INFO << "all connections closed, exit";
+                Singleton<EventLoopThreadPool>::Instance().stop();
+                g_mainLoop.quit();
+                return;
+            }
+
+            //ѾڶϿӲ뱾
+            size_t closed = 0;
+            for (const auto& session : sessions)
+            {
+                if (closed >= perTick)
+                    break;
+                std::shared_ptr<TcpConnection> conn = session->GetConnectionPtr();
+                if (!conn || !conn->connected())
+                    continue;
+                conn->forceClose();
+                ++closed;
+            }
+        });
+    });
+
     LOG_INFO << "chatserver initialization completed, now you can use client to connect it.";
 
     g_mainLoop.loop();
@@ -4,17 +4,21 @@
  **/
 #include "FileServer.h"
 #include "../net/InetAddress.h"
+#include "../net/Channel.h"
 #include "../base/Logging.h"
 #include "../base/Singleton.h"
 #include "FileSession.h"
 
-bool FileServer::Init(const char* ip, short port, EventLoop* loop, const char* fileBaseDir/* = "filecache/"*/)
+bool FileServer::Init(const char* ip, short port, EventLoop* loop, const char* fileBaseDir/* = "filecache/"*/, bool zeroCopyDownload/* = false*/)
 {
     m_strFileBaseDir = fileBaseDir;
+    m_bZeroCopyDownload = zeroCopyDownload;
 
     InetAddress addr(ip, port);
     m_server.reset(new TcpServer(loop, addr, "ZYL-MYImgAndFileServer", TcpServer::kReusePort));
     m_server->setConnectionCallback(std::bind(&FileServer::OnConnection, this, std::placeholders::_1));
+    //ӶڴļͼƬݣloopwakeupͶʱַ֮
+    m_server->setConnectionPriority(Channel::kLowPriority);
     //
     m_server->start();
 
@@ -27,7 +31,7 @@ void FileServer::OnConnection(std::shared_ptr<TcpConnection> conn)
     {
         //LOG_INFO << "client connected:" << conn->peerAddress().toIpPort();
         ++ m_baseUserId;
-        std::shared_ptr<FileSession> spSession(new FileSession(conn, m_strFileBaseDir.c_str()));
+        std::shared_ptr<FileSession> spSession(new FileSession(conn, m_strFileBaseDir.c_str(), m_bZeroCopyDownload));
         conn->setMessageCallback(std::bind(&FileSession::OnRead, spSession.get(), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 
         std::lock_guard<std::mutex> guard(m_sessionMutex);
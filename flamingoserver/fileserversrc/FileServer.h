@@ -30,7 +30,8 @@ public:
     FileServer(const FileServer& rhs) = delete;
     FileServer& operator =(const FileServer& rhs) = delete;
 
-    bool Init(const char* ip, short port, EventLoop* loop, const char* fileBaseDir = "filecache/");
+    //zeroCopyDownloadΪtrueʱļsendfile
+    bool Init(const char* ip, short port, EventLoop* loop, const char* fileBaseDir = "filecache/", bool zeroCopyDownload = false);
 
 private:
     //ӵûӶϿҪͨconn->connected()жϣһֻloop
@@ -46,4 +47,5 @@ private:
     int                                            m_baseUserId{};
     std::mutex                                     m_idMutex;           //֮߳䱣m_baseUserId
     std::string                                    m_strFileBaseDir;    //ļĿ¼
+    bool                                           m_bZeroCopyDownload{false};
 };
@@ -4,6 +4,9 @@
  **/
 #include "FileSession.h"
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <sstream>
 #include <list>
 #include "../net/TcpConnection.h"
@@ -18,18 +21,19 @@ using namespace net;
 //ļİ50M
 #define MAX_PACKAGE_SIZE    50 * 1024 * 1024
 
-FileSession::FileSession(const std::shared_ptr<TcpConnection>& conn, const char* filebasedir) :
+FileSession::FileSession(const std::shared_ptr<TcpConnection>& conn, const char* filebasedir, bool zeroCopyDownload/* = false*/) :
 TcpSession(conn), 
 m_id(0),
 m_seq(0),
 m_strFileBaseDir(filebasedir),
-m_bFileUploading(false)
+m_bFileUploading(false),
+m_bZeroCopyDownload(zeroCopyDownload)
 {
 }
 
 FileSession::~FileSession()
 {
-
+    ResetFile();
 }
 
 void FileSession::OnRead(const std::shared_ptr<TcpConnection>& conn, Buffer* pBuffer, Timestamp receivTime)
@@ -278,6 +282,9 @@ bool FileSession::OnDownloadFileResponse(const std::string& filemd5, const std::
         return true;
     }
 
+    if (m_bZeroCopyDownload)
+        return OnDownloadFileResponseZeroCopy(filemd5, conn);
+
     //ļδ,ȴ
     if (m_fp == NULL)
     {
@@ -347,8 +354,72 @@ bool FileSession::OnDownloadFileResponse(const std::string& filemd5, const std::
      return true;
 }
 
+bool FileSession::OnDownloadFileResponseZeroCopy(const std::string& filemd5, const std::shared_ptr<TcpConnection>& conn)
+{
+    //ļδ,ȴ
+    if (m_downloadFd < 0)
+    {
+        string filename = m_strFileBaseDir;
+        filename += filemd5;
+        m_downloadFd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (m_downloadFd < 0)
+        {
+            LOG_ERROR << "open file error, filemd5: " << filemd5 << ", errno: " << errno << ", client:" << conn->peerAddress().toIpPort();
+            return false;
+        }
+        struct stat st = {};
+        if (fstat(m_downloadFd, &st) != 0 || st.st_size <= 0)
+        {
+            LOG_ERROR << "m_filesize: " << (int64_t)st.st_size << ", errno: " << errno << ", filemd5: " << filemd5 << ", client : " << conn->peerAddress().toIpPort();
+            ResetFile();
+            return false;
+        }
+        m_currentDownloadFileSize = st.st_size;
+        m_currentDownloadFileOffset = 0;
+    }
+
+    //ÿӦļݴСԭطʽһͻ˲ø
+    int64_t currentSendSize = 512 * 1024;
+    if (m_currentDownloadFileSize <= m_currentDownloadFileOffset + currentSendSize)
+        currentSendSize = m_currentDownloadFileSize - m_currentDownloadFileOffset;
+
+    int64_t sendoffset = m_currentDownloadFileOffset;
+    m_currentDownloadFileOffset += currentSendSize;
+
+    int errorcode = file_msg_error_progress;
+    //ļѾ
+    if (m_currentDownloadFileOffset == m_currentDownloadFileSize)
+        errorcode = file_msg_error_complete;
+
+    //ļݲڴ棬ͷԪ֮sendfileֱӷ
+    SendFileData(msg_type_download_resp, m_seq, errorcode, filemd5, sendoffset, m_currentDownloadFileSize, m_downloadFd, (size_t)currentSendSize);
+
+    LOG_INFO << "Response to client: cmd=msg_type_download_resp, errorcode: " << errorcode
+             << ", filemd5: " << filemd5
+             << ", offset: " << sendoffset
+             << ", filesize: " << m_currentDownloadFileSize
+             << ", filedataLength: " << currentSendSize
+             << ", download percent: " << (sendoffset * 100 / m_currentDownloadFileSize) << "%"
+             << ", client:" << conn->peerAddress().toIpPort()
+             << " (sendfile)";
+
+    //ļسɹ,ļ״̬sendFiledupfdֱӹر
+    if (errorcode == file_msg_error_complete)
+        ResetFile();
+
+    return true;
+}
+
 void FileSession::ResetFile()
 {
+    if (m_downloadFd >= 0)
+    {
+        close(m_downloadFd);
+        m_downloadFd = -1;
+        m_currentDownloadFileOffset = 0;
+        m_currentDownloadFileSize = 0;
+    }
+
     if (m_fp != NULL)
     {
         fclose(m_fp);
@@ -10,7 +10,8 @@
 class FileSession : public TcpSession
 {
 public:
-    FileSession(const std::shared_ptr<TcpConnection>& conn, const char* filebasedir);
+    //zeroCopyDownloadΪtrueʱصļsendfileֱӴpage cachesocket
+    FileSession(const std::shared_ptr<TcpConnection>& conn, const char* filebasedir, bool zeroCopyDownload = false);
     virtual ~FileSession();
 
     FileSession(const FileSession& rhs) = delete;
@@ -25,6 +26,7 @@ private:
     
     bool OnUploadFileResponse(const std::string& filemd5, int64_t offset, int64_t filesize, const std::string& filedata, const std::shared_ptr<TcpConnection>& conn);
     bool OnDownloadFileResponse(const std::string& filemd5, const std::shared_ptr<TcpConnection>& conn);
+    bool OnDownloadFileResponseZeroCopy(const std::string& filemd5, const std::shared_ptr<TcpConnection>& conn);
 
     void ResetFile();
 
@@ -34,8 +36,10 @@ private:
 
     //ǰļϢ
     FILE*             m_fp{};
+    int               m_downloadFd{-1};                 //㿽ʱ򿪵ļ
     int64_t           m_currentDownloadFileOffset{};    //ǰصļƫ
     int64_t           m_currentDownloadFileSize{};      //ǰصļĴС(Ժ0)
     std::string       m_strFileBaseDir;                 //ļĿ¼
     bool              m_bFileUploading;                 //ǷϴļĹ
+    bool              m_bZeroCopyDownload;              //Ƿsendfile
 };
\ No newline at end of file
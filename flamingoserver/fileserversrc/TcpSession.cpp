@@ -3,6 +3,7 @@
  * zhangyl 2017.03.09
  **/
 #include "TcpSession.h"
+#include <string.h>
 #include "../base/Logging.h"
 #include "../net/ProtocolStream.h"
 #include "FileMsg.h"
@@ -33,6 +34,36 @@ void TcpSession::Send(int32_t cmd, int32_t seq, int32_t errorcode, const std::st
     SendPackage(outbuf.c_str(), outbuf.length());
 }
 
+void TcpSession::SendFileData(int32_t cmd, int32_t seq, int32_t errorcode, const std::string& filemd5, int64_t offset, int64_t filesize, int fd, size_t filedatalength)
+{
+    std::shared_ptr<TcpConnection> conn = tmpConn_.lock();
+    if (!conn)
+    {
+        LOG_ERROR << "Tcp connection is destroyed , but why TcpSession is still alive ?";
+        return;
+    }
+
+    //ͷǰ棬Ԫд峤
+    std::string strPackageData(sizeof(file_msg), '\0');
+    std::string outbuf;
+    net::BinaryWriteStream writeStream(&outbuf);
+    writeStream.WriteInt32(cmd);
+    writeStream.WriteInt32(seq);
+    writeStream.WriteInt32(errorcode);
+    writeStream.WriteString(filemd5);
+    writeStream.WriteInt64(offset);
+    writeStream.WriteInt64(filesize);
+    writeStream.WriteStringHeader(filedatalength);
+    writeStream.Flush();
+
+    file_msg header = { (int64_t)(outbuf.length() + filedatalength) };
+    memcpy(&strPackageData[0], &header, sizeof(header));
+    strPackageData.append(outbuf);
+
+    conn->send(std::move(strPackageData));
+    conn->sendFile(fd, offset, filedatalength);
+}
+
 void TcpSession::SendPackage(const char* body, int64_t bodylength)
 {
     string strPackageData;
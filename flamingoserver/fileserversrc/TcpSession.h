@@ -29,6 +29,9 @@ public:
     }
 
     void Send(int32_t cmd, int32_t seq, int32_t errorcode, const std::string& filemd5, int64_t offset, int64_t filesize, const std::string& filedata);
+    //ͬϣfiledataļfd[offset, offset + filedatalength)ͷԪû̬ã
+    //ļTcpConnection::sendFilesendfileֱӴpage cacheû̬
+    void SendFileData(int32_t cmd, int32_t seq, int32_t errorcode, const std::string& filemd5, int64_t offset, int64_t filesize, int fd, size_t filedatalength);
 
 private:
     //ִ֧ļint64_t洢ǵһļϴ߼
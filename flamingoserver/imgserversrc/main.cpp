@@ -14,6 +14,7 @@
 #include "../base/Singleton.h"
 #include "../base/ConfigFileReader.h"
 #include "../base/AsyncLogging.h"
+#include "../base/CpuAffinity.h"
 #include "../net/EventLoop.h"
 #include "../net/EventLoopThreadPool.h"
 #include "../fileserversrc/FileManager.h"
@@ -95,18 +96,36 @@ int main(int argc, char* argv[])
     //AsyncLogging log(strLogFileFullPath.c_str(), kRollSize);
     g_asyncLog.setBaseName(strLogFileFullPath.c_str());
     g_asyncLog.setRollSize(kRollSize);
+    //־̰߳󶨵cpunumaڵ㣬logcpus=0-1lognumanode=0򲻰
+    CpuAffinity::Placement logPlacement;
+    if (!CpuAffinity::parsePlacement(config.GetConfigName("logcpus"), config.GetConfigName("lognumanode"), &logPlacement))
+        LOG_ERROR << "invalid logcpus or lognumanode, log thread is not pinned";
+    else if (!logPlacement.empty())
+        g_asyncLog.setThreadStartCallback(std::bind(&CpuAffinity::bindCurrentThread, logPlacement, 0, "log"));
     g_asyncLog.start();
     Logger::setOutput(asyncOutput);
+    LOG_INFO << "cpu topology: " << CpuAffinity::topology();
 
     const char* filecachedir = config.GetConfigName("imgcachedir");
     Singleton<FileManager>::Instance().Init(filecachedir);
 
-    Singleton<EventLoopThreadPool>::Instance().Init(&g_mainLoop, 6);
+    //io loop߳Լ󶨵cpunumaڵ㣬chatserver.conf
+    const char* loopthreads = config.GetConfigName("loopthreads");
+    int loopThreads = loopthreads != NULL ? atoi(loopthreads) : 6;
+    CpuAffinity::Placement loopPlacement;
+    if (!CpuAffinity::parsePlacement(config.GetConfigName("loopcpus"), config.GetConfigName("loopnumanode"), &loopPlacement))
+        LOG_ERROR << "invalid loopcpus or loopnumanode, io loop threads are not pinned";
+    else if (!loopPlacement.empty())
+        Singleton<EventLoopThreadPool>::Instance().setThreadStartCallback(std::bind(&CpuAffinity::bindCurrentThread, loopPlacement, std::placeholders::_1, "io loop"));
+    Singleton<EventLoopThreadPool>::Instance().Init(&g_mainLoop, loopThreads);
     Singleton<EventLoopThreadPool>::Instance().start();
 
     const char* listenip = config.GetConfigName("listenip");
     short listenport = (short)atol(config.GetConfigName("listenport"));
-    Singleton<FileServer>::Instance().Init(listenip, listenport, &g_mainLoop, filecachedir);
+    //ͼƬصsendfilepage cacheֱӷsocket
+    const char* zerocopydownload = config.GetConfigName("zerocopydownload");
+    bool zeroCopyDownload = (zerocopydownload != NULL && atoi(zerocopydownload) != 0);
+    Singleton<FileServer>::Instance().Init(listenip, listenport, &g_mainLoop, filecachedir, zeroCopyDownload);
 
     LOG_INFO << "imgserver initialization complete, now you can use client to connect it.";
     
@@ -14,12 +14,17 @@
 
 using namespace net;
 
+static const int kDefaultMaxAcceptsPerRound = 64;
+
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport)
     : loop_(loop),
     acceptSocket_(sockets::createNonblockingOrDie()),
     acceptChannel_(loop, acceptSocket_.fd()),
     listenning_(false),
-    idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+    idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+    steeringGroupSize_(0),
+    maxAcceptsPerRound_(kDefaultMaxAcceptsPerRound),
+    acceptedCount_(0)
 {
     assert(idleFd_ >= 0);
     acceptSocket_.setReuseAddr(true);
@@ -28,6 +33,20 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
     acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
 }
 
+Acceptor::Acceptor(EventLoop* loop, int listenfd)
+    : loop_(loop),
+    acceptSocket_(listenfd),
+    acceptChannel_(loop, listenfd),
+    listenning_(false),
+    idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+    steeringGroupSize_(0),
+    maxAcceptsPerRound_(kDefaultMaxAcceptsPerRound),
+    acceptedCount_(0)
+{
+    assert(idleFd_ >= 0);
+    acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();
@@ -40,17 +59,42 @@ void Acceptor::listen()
     loop_->assertInLoopThread();
     listenning_ = true;
     acceptSocket_.listen();
+    //ģʽringһֱһmultishot acceptõȿɶaccept
+    if (loop_->completionIo())
+    {
+        acceptChannel_.setIoMode(Channel::kAcceptCompletions);
+        acceptChannel_.setCompletionCallback(std::bind(&Acceptor::handleCompletion, this, std::placeholders::_1, std::placeholders::_2));
+    }
+    //ÿsocketͬһ˭listenӰ
+    if (steeringGroupSize_ > 1)
+        acceptSocket_.attachReusePortCbpf(steeringGroupSize_);
     acceptChannel_.enableReading();
 }
 
+void Acceptor::stopListening()
+{
+    loop_->assertInLoopThread();
+    if (!listenning_)
+        return;
+    listenning_ = false;
+    acceptChannel_.disableAll();
+}
+
 void Acceptor::handleRead()
 {
     loop_->assertInLoopThread();
-    InetAddress peerAddr;
-    //FIXME loop until no more
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0)
+    //һֱacceptEAGAINÿޣʣµӵһ֣ˮƽٴ֪ͨ
+    for (int i = 0; i < maxAcceptsPerRound_; ++i)
     {
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd < 0)
+        {
+            handleAcceptError();
+            break;
+        }
+
+        ++acceptedCount_;
         // string hostport = peerAddr.toIpPort();
         // LOG_TRACE << "Accepts of " << hostport;
         //newConnectionCallback_ʵָTcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
@@ -63,7 +107,34 @@ void Acceptor::handleRead()
             sockets::close(connfd);
         }
     }
+}
+
+void Acceptor::handleCompletion(const Channel::Completion& completion, Timestamp receiveTime)
+{
+    loop_->assertInLoopThread();
+    if (completion.res < 0)
+    {
+        errno = -completion.res;
+        handleAcceptError();
+        return;
+    }
+
+    int connfd = completion.res;
+    ++acceptedCount_;
+    if (newConnectionCallback_)
+    {
+        InetAddress peerAddr(sockets::getPeerAddr(connfd));
+        newConnectionCallback_(connfd, peerAddr);
+    }
     else
+    {
+        sockets::close(connfd);
+    }
+}
+
+void Acceptor::handleAcceptError()
+{
+    if (errno != EAGAIN)
     {
         LOG_SYSERR << "in Acceptor::handleRead";
         // Read the section named "The special problem of
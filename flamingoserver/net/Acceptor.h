@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 
 #include "Channel.h"
@@ -20,6 +21,8 @@ namespace net
         typedef std::function<void(int sockfd, const InetAddress&)> NewConnectionCallback;
 
         Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport);
+        /// ӹһѾbind(Ѿlisten)ķsocketرAcceptor
+        Acceptor(EventLoop* loop, int listenfd);
         ~Acceptor();
 
         //ӵĻص
@@ -28,11 +31,33 @@ namespace net
             newConnectionCallback_ = cb;
         }
 
+        /// ӷɢͬһSO_REUSEPORTڵgroupSizesocketϣ
+        /// listen()֮CBPF򣬱listen()֮ǰ
+        void setReusePortSteering(int groupSize) { steeringGroupSize_ = groupSize; }
+
+        /// ÿοɶ¼acceptһӷ籩ռסloop
+        void setMaxAcceptsPerRound(int n) { maxAcceptsPerRound_ = n; }
+
+        /// EPOLLEXCLUSIVEעsocketloopͬһsocketdupʱ
+        /// ÿֻһlooplisten()֮ǰ
+        void setExclusive(bool on) { acceptChannel_.setExclusive(on); }
+
+        int fd() const { return acceptSocket_.fd(); }
+
+        EventLoop* getLoop() const { return loop_; }
+        /// Ѿaccept̰߳ȫ
+        int64_t acceptedCount() const { return acceptedCount_; }
+
         bool listenning() const { return listenning_; }
         void listen();
+        /// acceptsocketȻ򿪣Ŷӵͬһsocket
+        void stopListening();
 
     private:
         void handleRead();
+        /// io_uringģʽmultishot acceptĽEventLoop::completionIo
+        void handleCompletion(const Channel::Completion& completion, Timestamp receiveTime);
+        void handleAcceptError();
 
     private:
         EventLoop*            loop_;
@@ -41,6 +66,9 @@ namespace net
         NewConnectionCallback newConnectionCallback_;
         bool                  listenning_;
         int                   idleFd_;
+        int                   steeringGroupSize_;
+        int                   maxAcceptsPerRound_;
+        std::atomic<int64_t>  acceptedCount_;
     };
 
 }
\ No newline at end of file
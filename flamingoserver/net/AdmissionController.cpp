@@ -0,0 +1,102 @@
+#include "AdmissionController.h"
+
+#include <sstream>
+
+#include "../base/Timestamp.h"
+#include "InetAddress.h"
+
+using namespace net;
+
+AdmissionController::AdmissionController(double acceptRate, int burst, int maxConnections, int maxConnectionsPerIp)
+: acceptRate_(acceptRate),
+burst_(burst > 0 ? burst : (acceptRate > 1 ? acceptRate : 1)),
+maxConnections_(maxConnections),
+maxConnectionsPerIp_(maxConnectionsPerIp),
+tokens_(burst_),
+lastRefill_(Timestamp::now().microSecondsSinceEpoch()),
+connections_(0),
+admitted_(0),
+rejectedByRate_(0),
+rejectedByTotal_(0),
+rejectedByIp_(0)
+{
+}
+
+bool AdmissionController::takeToken()
+{
+	if (acceptRate_ <= 0)
+		return true;
+
+	int64_t now = Timestamp::cachedNow().microSecondsSinceEpoch();
+	if (now > lastRefill_)
+	{
+		tokens_ += acceptRate_ * static_cast<double>(now - lastRefill_) / Timestamp::kMicroSecondsPerSecond;
+		if (tokens_ > burst_)
+			tokens_ = burst_;
+		lastRefill_ = now;
+	}
+
+	if (tokens_ < 1)
+		return false;
+
+	tokens_ -= 1;
+	return true;
+}
+
+bool AdmissionController::admit(const InetAddress& peerAddr)
+{
+	std::lock_guard<std::mutex> guard(mutex_);
+	if (maxConnections_ > 0 && connections_ >= maxConnections_)
+	{
+		++rejectedByTotal_;
+		return false;
+	}
+
+	int* perIp = NULL;
+	if (maxConnectionsPerIp_ > 0)
+	{
+		perIp = &connectionsPerIp_[peerAddr.ipNetEndian()];
+		if (*perIp >= maxConnectionsPerIp_)
+		{
+			++rejectedByIp_;
+			return false;
+		}
+	}
+
+	//limits are checked before the bucket, a rejected socket must not burn a token
+	if (!takeToken())
+	{
+		if (perIp != NULL && *perIp == 0)
+			connectionsPerIp_.erase(peerAddr.ipNetEndian());
+		++rejectedByRate_;
+		return false;
+	}
+
+	++connections_;
+	if (perIp != NULL)
+		++*perIp;
+	++admitted_;
+	return true;
+}
+
+void AdmissionController::release(const InetAddress& peerAddr)
+{
+	std::lock_guard<std::mutex> guard(mutex_);
+	--connections_;
+	if (maxConnectionsPerIp_ > 0)
+	{
+		std::unordered_map<uint32_t, int>::iterator it = connectionsPerIp_.find(peerAddr.ipNetEndian());
+		if (it != connectionsPerIp_.end() && --it->second <= 0)
+			connectionsPerIp_.erase(it);
+	}
+}
+
+const std::string AdmissionController::info() const
+{
+	std::stringstream ss;
+	ss << "admitted: " << admitted_
+	   << ", rejected by rate: " << rejectedByRate_
+	   << ", rejected by max connections: " << rejectedByTotal_
+	   << ", rejected by per-ip limit: " << rejectedByIp_ << "\n";
+	return ss.str();
+}
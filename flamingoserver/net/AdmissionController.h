@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace net
+{
+
+	class InetAddress;
+
+	///
+	/// Decides whether an accepted socket may become a TcpConnection.
+	///
+	/// Three limits, each disabled when set to 0:
+	/// - a token bucket on the accept rate (acceptRate per second, burst tokens at most)
+	/// - max live connections of the server
+	/// - max live connections from one source ip
+	///
+	/// Thread safe, acceptors of all loops share one instance.
+	class AdmissionController
+	{
+	public:
+		AdmissionController(double acceptRate, int burst, int maxConnections, int maxConnectionsPerIp);
+		~AdmissionController() = default;
+
+		AdmissionController(const AdmissionController& rhs) = delete;
+		AdmissionController& operator=(const AdmissionController& rhs) = delete;
+
+		/// return true if the connection from peerAddr is admitted,
+		/// it must be paired with a release() when the connection goes away.
+		bool admit(const InetAddress& peerAddr);
+		void release(const InetAddress& peerAddr);
+
+		int64_t admittedCount() const { return admitted_; }
+		int64_t rejectedCount() const { return rejectedByRate_ + rejectedByTotal_ + rejectedByIp_; }
+
+		const std::string info() const;
+
+	private:
+		/// with mutex_ held
+		bool takeToken();
+
+	private:
+		const double                        acceptRate_;
+		const double                        burst_;
+		const int                           maxConnections_;
+		const int                           maxConnectionsPerIp_;
+
+		std::mutex                          mutex_;
+		double                              tokens_;
+		int64_t                             lastRefill_;        // microseconds
+		int                                 connections_;
+		std::unordered_map<uint32_t, int>   connectionsPerIp_;  // ip in network byte order
+
+		std::atomic<int64_t>                admitted_;
+		std::atomic<int64_t>                rejectedByRate_;
+		std::atomic<int64_t>                rejectedByTotal_;
+		std::atomic<int64_t>                rejectedByIp_;
+	};
+
+}
@@ -14,33 +14,58 @@ const size_t Buffer::kInitialSize;
 ssize_t Buffer::readFd(int fd, int* savedErrno)
 {
 	// saved an ioctl()/FIONREAD call to tell how much to read
-	char extrabuf[65536];
-	struct iovec vec[2];
+	const size_t kExtraBytes = 65536;
 	const size_t writable = writableBytes();
+	if (writable >= kExtraBytes)
+	{
+		const ssize_t n = sockets::read(fd, begin() + writerIndex_, writable);
+		if (n < 0)
+			*savedErrno = errno;
+		else
+			writerIndex_ += n;
+		return n;
+	}
+
+	// the extra chunk leaves room in front of the read data for what this
+	// buffer holds, so it can take over as storage without moving the data
+	const size_t readable = readableBytes();
+	const size_t prefix = kCheapPrepend + readable + writable;
+	const size_t chunkSize = BufferPool::chunkSize(prefix + kExtraBytes);
+	BufferPool& pool = BufferPool::local();
+	char* chunk = pool.allocate(chunkSize);
+
+	struct iovec vec[2];
 	vec[0].iov_base = begin() + writerIndex_;
 	vec[0].iov_len = writable;
-	vec[1].iov_base = extrabuf;
-	vec[1].iov_len = sizeof extrabuf;
-	// when there is enough space in this buffer, don't read into extrabuf.
-	// when extrabuf is used, we read 128k-1 bytes at most.
-	const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
-	const ssize_t n = sockets::readv(fd, vec, iovcnt);
+	vec[1].iov_base = chunk + prefix;
+	vec[1].iov_len = chunkSize - prefix;
+	const ssize_t n = sockets::readv(fd, vec, 2);
 	if (n < 0)
 	{
 		*savedErrno = errno;
+		pool.deallocate(chunk, chunkSize);
 	}
 	else if (implicit_cast<size_t>(n) <= writable)
 	{
 		writerIndex_ += n;
+		pool.deallocate(chunk, chunkSize);
+	}
+	else if (BufferPool::chunkSize(kCheapPrepend + readable + n) < chunkSize)
+	{
+		// a smaller chunk holds it all, copy the extra bytes there
+		writerIndex_ = capacity_;
+		append(chunk + prefix, n - writable);
+		pool.deallocate(chunk, chunkSize);
 	}
 	else
 	{
-		writerIndex_ = buffer_.size();
-		append(extrabuf, n - writable);
+		// adopt the chunk, only the bytes this buffer held are copied
+		::memcpy(chunk + kCheapPrepend, peek(), readable + writable);
+		pool.deallocate(buffer_, capacity_);
+		buffer_ = chunk;
+		capacity_ = chunkSize;
+		readerIndex_ = kCheapPrepend;
+		writerIndex_ = kCheapPrepend + readable + n;
 	}
-	// if (n == writable + sizeof extrabuf)
-	// {
-	//   goto line_30;
-	// }
 	return n;
 }
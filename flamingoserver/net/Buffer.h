@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "Endian.h"
+#include "BufferPool.h"
 //#include <unistd.h>  // ssize_t
 
 
@@ -23,28 +24,57 @@ namespace net
 	/// |                   |                  |                  |
 	/// 0      <=      readerIndex   <=   writerIndex    <=     size
 	/// @endcode
+	///
+	/// Storage is a chunk of the BufferPool of the thread that (re)allocates
+	/// it, so its size is always a BufferPool::chunkSize().
 	class Buffer
 	{
 	public:
 		static const size_t kCheapPrepend = 8;
-		static const size_t kInitialSize = 1024;
+		// one chunk of BufferPool::kMinChunkSize
+		static const size_t kInitialSize = BufferPool::kMinChunkSize - kCheapPrepend;
 
 		explicit Buffer(size_t initialSize = kInitialSize)
-			: buffer_(kCheapPrepend + initialSize),
+			: capacity_(BufferPool::chunkSize(kCheapPrepend + initialSize)),
 			readerIndex_(kCheapPrepend),
 			writerIndex_(kCheapPrepend)
 		{
+			buffer_ = BufferPool::local().allocate(capacity_);
 			assert(readableBytes() == 0);
-			assert(writableBytes() == initialSize);
+			assert(writableBytes() >= initialSize);
 			assert(prependableBytes() == kCheapPrepend);
 		}
 
-		// implicit copy-ctor, move-ctor, dtor and assignment are fine
-		// NOTE: implicit move-ctor is added in g++ 4.6
+		Buffer(const Buffer& rhs)
+			: capacity_(BufferPool::chunkSize(kCheapPrepend + rhs.readableBytes())),
+			readerIndex_(kCheapPrepend),
+			writerIndex_(kCheapPrepend + rhs.readableBytes())
+		{
+			buffer_ = BufferPool::local().allocate(capacity_);
+			::memcpy(begin() + readerIndex_, rhs.peek(), rhs.readableBytes());
+		}
+
+		Buffer(Buffer&& rhs)
+			: Buffer()
+		{
+			swap(rhs);
+		}
+
+		~Buffer()
+		{
+			BufferPool::local().deallocate(buffer_, capacity_);
+		}
+
+		Buffer& operator=(Buffer rhs)
+		{
+			swap(rhs);
+			return *this;
+		}
 
 		void swap(Buffer& rhs)
 		{
-			buffer_.swap(rhs.buffer_);
+			std::swap(buffer_, rhs.buffer_);
+			std::swap(capacity_, rhs.capacity_);
 			std::swap(readerIndex_, rhs.readerIndex_);
 			std::swap(writerIndex_, rhs.writerIndex_);
 		}
@@ -56,7 +86,7 @@ namespace net
 
 		size_t writableBytes() const
 		{
-			return buffer_.size() - writerIndex_;
+			return capacity_ - writerIndex_;
 		}
 
 		size_t prependableBytes() const
@@ -144,8 +174,9 @@ namespace net
 
 		void retrieveAll()
 		{
-			readerIndex_ = kCheapPrepend;
-			writerIndex_ = kCheapPrepend;
+			// a released buffer has no room for the prepend
+			readerIndex_ = capacity_ != 0 ? kCheapPrepend : 0;
+			writerIndex_ = readerIndex_;
 		}
 
 		std::string retrieveAllAsString()
@@ -359,21 +390,33 @@ namespace net
 
 		void shrink(size_t reserve)
 		{
-			// FIXME: use vector::shrink_to_fit() in C++ 11 if possible.
-			Buffer other;
-			other.ensureWritableBytes(readableBytes() + reserve);
-			other.append(toStringPiece());
+			Buffer other(readableBytes() + reserve);
+			other.append(peek(), readableBytes());
 			swap(other);
 		}
 
+		/// gives the storage back to the pool if nothing is readable, the
+		/// buffer allocates again when written to
+		void release()
+		{
+			if (readableBytes() != 0 || capacity_ == 0)
+				return;
+			BufferPool::local().deallocate(buffer_, capacity_);
+			buffer_ = NULL;
+			capacity_ = 0;
+			readerIndex_ = 0;
+			writerIndex_ = 0;
+		}
+
 		size_t internalCapacity() const
 		{
-			return buffer_.capacity();
+			return capacity_;
 		}
 
 		/// Read data directly into buffer.
 		///
-		/// It may implement with readv(2)
+		/// It may implement with readv(2), what does not fit goes into a
+		/// pooled chunk that becomes the storage when it is big enough
 		/// @return result of read(2), @c errno is saved
 		ssize_t readFd(int fd, int* savedErrno);
 
@@ -381,12 +424,12 @@ namespace net
 
 		char* begin()
 		{
-			return &*buffer_.begin();
+			return buffer_;
 		}
 
 		const char* begin() const
 		{
-			return &*buffer_.begin();
+			return buffer_;
 		}
 
 		void makeSpace(size_t len)
@@ -394,8 +437,21 @@ namespace net
 			//kCheapPrependΪĿռ
             if (writableBytes() + prependableBytes() < len + kCheapPrepend)
 			{
-				// FIXME: move readable data
-				buffer_.resize(writerIndex_ + len);
+				// move readable data to a bigger chunk, grow geometrically
+				// past the biggest size class too
+				size_t readable = readableBytes();
+				size_t capacity = BufferPool::chunkSize(kCheapPrepend + readable + len);
+				if (capacity > BufferPool::kMaxChunkSize && capacity < capacity_ * 2)
+					capacity = capacity_ * 2;
+				BufferPool& pool = BufferPool::local();
+				char* buffer = pool.allocate(capacity);
+				if (readable > 0)
+					::memcpy(buffer + kCheapPrepend, peek(), readable);
+				pool.deallocate(buffer_, capacity_);
+				buffer_ = buffer;
+				capacity_ = capacity;
+				readerIndex_ = kCheapPrepend;
+				writerIndex_ = readerIndex_ + readable;
 			}
 			else
 			{
@@ -412,7 +468,8 @@ namespace net
 		}
 
 	private:
-		std::vector<char> buffer_;
+		char* buffer_;
+		size_t capacity_;
 		size_t readerIndex_;
 		size_t writerIndex_;
 
@@ -0,0 +1,236 @@
+#include "BufferPool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <vector>
+
+using namespace net;
+
+const size_t BufferPool::kMinChunkSize;
+const int BufferPool::kNumClasses;
+const size_t BufferPool::kMaxChunkSize;
+const size_t BufferPool::kMaxCachedBytes;
+const size_t BufferPool::kSlabSize;
+
+namespace
+{
+	std::atomic<bool>           g_hugePages(false);
+	std::atomic<int64_t>        g_slabBytes(0);
+
+	// every live pool, for info()
+	std::mutex                  g_poolsMutex;
+	std::vector<BufferPool*>    g_pools;
+	// what destroyed pools had counted
+	int64_t                     g_retiredHits = 0;
+	int64_t                     g_retiredMisses = 0;
+	int64_t                     g_retiredInUse = 0;
+
+	// the counters have a single writer, a plain store is enough
+	inline void add(std::atomic<int64_t>& counter, int64_t n)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+}
+
+// the pool outlives the thread_local objects that were constructed before
+// it, buffers they own are freed after the reaper ran
+struct BufferPool::Reaper
+{
+	BufferPool*     pool;
+
+	Reaper(BufferPool* p) : pool(p) { }
+	~Reaper() { pool->retire(); }
+};
+
+BufferPool& BufferPool::local()
+{
+	static thread_local BufferPool* t_pool = NULL;
+	if (t_pool == NULL)
+	{
+		t_pool = new BufferPool();
+		static thread_local Reaper t_reaper(t_pool);
+	}
+	return *t_pool;
+}
+
+BufferPool::BufferPool()
+: tid_(static_cast<int64_t>(::syscall(SYS_gettid))),
+retired_(false),
+hits_(0),
+misses_(0),
+bytesInUse_(0),
+bytesCached_(0)
+{
+	memset(freeLists_, 0, sizeof freeLists_);
+	memset(cachedBytes_, 0, sizeof cachedBytes_);
+
+	std::lock_guard<std::mutex> guard(g_poolsMutex);
+	g_pools.push_back(this);
+}
+
+void BufferPool::retire()
+{
+	retired_ = true;
+	if (!g_hugePages)
+	{
+		for (int cls = 0; cls < kNumClasses; ++cls)
+		{
+			while (freeLists_[cls] != NULL)
+			{
+				FreeChunk* chunk = freeLists_[cls];
+				freeLists_[cls] = chunk->next;
+				::free(chunk);
+			}
+			cachedBytes_[cls] = 0;
+		}
+		bytesCached_ = 0;
+	}
+
+	std::lock_guard<std::mutex> guard(g_poolsMutex);
+	for (size_t i = 0; i < g_pools.size(); ++i)
+	{
+		if (g_pools[i] == this)
+		{
+			g_pools.erase(g_pools.begin() + i);
+			break;
+		}
+	}
+	g_retiredHits += hits_;
+	g_retiredMisses += misses_;
+	g_retiredInUse += bytesInUse_;
+}
+
+int BufferPool::sizeClass(size_t size)
+{
+	if (size > kMaxChunkSize)
+		return -1;
+
+	int cls = 0;
+	size_t chunk = kMinChunkSize;
+	while (chunk < size)
+	{
+		chunk <<= 1;
+		++cls;
+	}
+	return cls;
+}
+
+size_t BufferPool::chunkSize(size_t size)
+{
+	int cls = sizeClass(size);
+	return cls < 0 ? size : kMinChunkSize << cls;
+}
+
+void BufferPool::enableHugePages()
+{
+	g_hugePages = true;
+}
+
+char* BufferPool::allocate(size_t size)
+{
+	add(bytesInUse_, static_cast<int64_t>(size));
+
+	int cls = sizeClass(size);
+	if (cls >= 0 && freeLists_[cls] != NULL)
+	{
+		FreeChunk* chunk = freeLists_[cls];
+		freeLists_[cls] = chunk->next;
+		cachedBytes_[cls] -= size;
+		add(bytesCached_, -static_cast<int64_t>(size));
+		add(hits_, 1);
+		return reinterpret_cast<char*>(chunk);
+	}
+
+	add(misses_, 1);
+	if (cls >= 0 && g_hugePages && size <= kSlabSize)
+		return allocateFromSlab(cls, size);
+
+	void* p = ::malloc(size);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return static_cast<char*>(p);
+}
+
+void BufferPool::deallocate(char* p, size_t size)
+{
+	if (p == NULL)
+		return;
+
+	add(bytesInUse_, -static_cast<int64_t>(size));
+
+	int cls = sizeClass(size);
+	bool slabChunk = cls >= 0 && g_hugePages && size <= kSlabSize;
+	if (cls < 0 || (!slabChunk && (retired_ || cachedBytes_[cls] + size > kMaxCachedBytes)))
+	{
+		::free(p);
+		return;
+	}
+
+	FreeChunk* chunk = reinterpret_cast<FreeChunk*>(p);
+	chunk->next = freeLists_[cls];
+	freeLists_[cls] = chunk;
+	cachedBytes_[cls] += size;
+	add(bytesCached_, static_cast<int64_t>(size));
+}
+
+char* BufferPool::allocateFromSlab(int cls, size_t size)
+{
+	void* slab = ::mmap(NULL, kSlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (slab == MAP_FAILED)
+	{
+		// no reserved hugepages, ask for transparent ones
+		slab = ::mmap(NULL, kSlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (slab == MAP_FAILED)
+			throw std::bad_alloc();
+		::madvise(slab, kSlabSize, MADV_HUGEPAGE);
+	}
+	g_slabBytes += kSlabSize;
+
+	// the first chunk is returned, the rest feeds the free list
+	char* base = static_cast<char*>(slab);
+	for (size_t offset = kSlabSize - size; offset >= size; offset -= size)
+	{
+		FreeChunk* chunk = reinterpret_cast<FreeChunk*>(base + offset);
+		chunk->next = freeLists_[cls];
+		freeLists_[cls] = chunk;
+		cachedBytes_[cls] += size;
+		add(bytesCached_, static_cast<int64_t>(size));
+	}
+	return base;
+}
+
+const std::string BufferPool::info()
+{
+	std::lock_guard<std::mutex> guard(g_poolsMutex);
+	std::stringstream ss;
+	int64_t hits = g_retiredHits;
+	int64_t misses = g_retiredMisses;
+	int64_t inUse = g_retiredInUse;
+	int64_t cached = 0;
+	for (size_t i = 0; i < g_pools.size(); ++i)
+	{
+		const BufferPool* pool = g_pools[i];
+		// in use is counted where chunks are freed too, a pool alone may go negative
+		ss << "buffer pool of thread " << pool->tid_
+		   << ": hits: " << pool->hits_
+		   << ", misses: " << pool->misses_
+		   << ", bytes in use: " << pool->bytesInUse_
+		   << ", bytes cached: " << pool->bytesCached_ << "\n";
+		hits += pool->hits_;
+		misses += pool->misses_;
+		inUse += pool->bytesInUse_;
+		cached += pool->bytesCached_;
+	}
+	ss << "total hits: " << hits
+	   << ", misses: " << misses
+	   << ", bytes in use: " << inUse
+	   << ", bytes cached: " << cached
+	   << ", hugepage slabs: " << (g_hugePages ? g_slabBytes.load() : 0) << " bytes\n";
+	return ss.str();
+}
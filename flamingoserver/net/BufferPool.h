@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+namespace net
+{
+
+	///
+	/// Per-thread size-class pool of Buffer storage.
+	///
+	/// Chunks are powers of 2 from kMinChunkSize to kMaxChunkSize, each
+	/// class keeps an intrusive free list, so a buffer growing, shrinking
+	/// or the overflow chunk of Buffer::readFd costs no malloc in steady
+	/// state. Bigger requests go to malloc directly.
+	///
+	/// Every loop thread gets its own pool, a chunk freed by another thread
+	/// goes to that thread's pool. Without hugepages a class caches at most
+	/// kMaxCachedBytes, the rest is freed. With hugepages chunks are carved
+	/// from 2 MB mappings that are never unmapped and all of them are cached.
+	class BufferPool
+	{
+	public:
+		static const size_t kMinChunkSize = 1024;
+		static const int    kNumClasses = 13;
+		static const size_t kMaxChunkSize = kMinChunkSize << (kNumClasses - 1);
+		static const size_t kMaxCachedBytes = 4 * 1024 * 1024;
+		static const size_t kSlabSize = 2 * 1024 * 1024;
+
+		/// pool of the calling thread
+		static BufferPool& local();
+
+		/// size of the chunk a request of size bytes gets
+		static size_t chunkSize(size_t size);
+
+		/// back chunks up to kSlabSize with hugepages (MAP_HUGETLB, else
+		/// transparent hugepages). Must be called before any Buffer exists.
+		static void enableHugePages();
+
+		/// counters of all pools, thread safe
+		static const std::string info();
+
+		/// size must be a chunkSize()
+		char* allocate(size_t size);
+		void deallocate(char* p, size_t size);
+
+		BufferPool(const BufferPool& rhs) = delete;
+		BufferPool& operator=(const BufferPool& rhs) = delete;
+
+	private:
+		BufferPool();
+
+		static int sizeClass(size_t size);
+		char* allocateFromSlab(int cls, size_t size);
+		/// at thread exit: drops the cache, later frees go straight to free()
+		void retire();
+
+		struct Reaper;
+
+		struct FreeChunk
+		{
+			FreeChunk*  next;
+		};
+
+	private:
+		FreeChunk*              freeLists_[kNumClasses];
+		size_t                  cachedBytes_[kNumClasses];
+		int64_t                 tid_;
+		bool                    retired_;
+
+		// written by the owner thread, read by info()
+		std::atomic<int64_t>    hits_;
+		std::atomic<int64_t>    misses_;
+		std::atomic<int64_t>    bytesInUse_;
+		std::atomic<int64_t>    bytesCached_;
+	};
+
+}
@@ -76,6 +76,7 @@ namespace net
 	typedef std::function<void(const TcpConnectionPtr&)> CloseCallback;
 	typedef std::function<void(const TcpConnectionPtr&)> WriteCompleteCallback;
 	typedef std::function<void(const TcpConnectionPtr&, size_t)> HighWaterMarkCallback;
+	typedef std::function<void(const TcpConnectionPtr&, size_t)> LowWaterMarkCallback;
 
 	// the data has been read to (buf, len)
 	typedef std::function<void(const TcpConnectionPtr&, Buffer*, Timestamp)> MessageCallback;
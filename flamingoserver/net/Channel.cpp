@@ -2,6 +2,7 @@
 #include <sstream>
 #include <assert.h>
 #include <poll.h>
+#include <unistd.h>
 #include "../base/Logging.h"
 #include "EventLoop.h"
 
@@ -18,6 +19,11 @@ events_(0),
 revents_(0),
 index_(-1),
 logHup_(true),
+edgeTriggered_(false),
+exclusive_(false),
+priority_(kNormalPriority),
+ioMode_(kReadiness),
+deferred_(false),
 tied_(false),
 eventHandling_(false),
 addedToLoop_(false)
@@ -83,6 +89,7 @@ void Channel::remove()
 	assert(isNoneEvent());
 	addedToLoop_ = false;
 	loop_->removeChannel(this);
+	dropCompletions();
 }
 
 void Channel::handleEvent(Timestamp receiveTime)
@@ -140,21 +147,62 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
 		if (errorCallback_) errorCallback_();
 	}
     
-	if (revents_ & (POLLIN | POLLPRI | POLLRDHUP))
+	//Եchannelдעˣûпһ¼ҪԵ
+	int revents = revents_;
+	if (edgeTriggered_)
+	{
+		if (!isReading())
+			revents &= ~(POLLIN | POLLPRI);
+		if (!isWriting())
+			revents &= ~POLLOUT;
+	}
+
+	if (revents & (POLLIN | POLLPRI | POLLRDHUP))
 	{
 		//socketʱreadCallback_ָAcceptor::handleRead
         //ǿͻsocketʱTcpConnection::handleRead 
         if (readCallback_) readCallback_(receiveTime);
 	}
 
-	if (revents_ & POLLOUT)
+	if (revents & POLLOUT)
 	{
 		//״̬socketwriteCallback_ָConnector::handleWrite()
         if (writeCallback_) writeCallback_();
 	}
+
+	if (!completions_.empty())
+		handleCompletions(receiveTime);
 	eventHandling_ = false;
 }
 
+void Channel::handleCompletions(Timestamp receiveTime)
+{
+	//صﲻµĽӽpollerֻpoll()
+	for (size_t i = 0; i < completions_.size(); ++i)
+	{
+		const Completion& completion = completions_[i];
+		if (completionCallback_)
+			completionCallback_(completion, receiveTime);
+		if (completion.bufferId >= 0)
+			loop_->recycleBuffer(completion.bufferId);
+	}
+	completions_.clear();
+}
+
+void Channel::dropCompletions()
+{
+	//ownerѾûܻصĽջ廹polleracceptӹص
+	for (size_t i = 0; i < completions_.size(); ++i)
+	{
+		const Completion& completion = completions_[i];
+		if (completion.bufferId >= 0)
+			loop_->recycleBuffer(completion.bufferId);
+		else if (completion.op == kAccepted && completion.res >= 0)
+			::close(completion.res);
+	}
+	completions_.clear();
+}
+
 string Channel::reventsToString() const
 {
 	std::ostringstream oss;
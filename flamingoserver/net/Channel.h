@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <functional>
+#include <vector>
 
 #include "../base/Timestamp.h"
 
@@ -22,6 +23,33 @@ namespace net
 		typedef std::function<void()> EventCallback;
 		typedef std::function<void(Timestamp)> ReadEventCallback;
 
+		/// ģʽһĽEventLoop::completionIo
+		enum CompletionOp
+		{
+			kAccepted,      // resӵfd
+			kReceived,      // resյֽ0ǶԶ˹ر
+			kSent,          // resǷֽ
+			kWritable       // pollWritableȵ˿д
+		};
+		struct Completion
+		{
+			int             op;
+			int             res;        // ʧʱ-errno
+			const char*     data;       // kReceivedյݣֻڻصڼЧ
+			int             bufferId;   // dataڵĽջ壬ص󻹸pollerûʱ-1
+		};
+		typedef std::function<void(const Completion&, Timestamp)> CompletionCallback;
+
+		/// kReadinessɶд֪ͨģʽpollerѯfd
+		/// ʱmultishot acceptrecvͨCompletionCallback
+		/// ֻڼpoller֮ǰ
+		enum IoMode
+		{
+			kReadiness,
+			kAcceptCompletions,
+			kRecvCompletions
+		};
+
 		Channel(EventLoop* loop, int fd);
 		~Channel();
 
@@ -42,6 +70,10 @@ namespace net
 		{
 			errorCallback_ = cb;
 		}
+		void setCompletionCallback(const CompletionCallback& cb)
+		{
+			completionCallback_ = cb;
+		}
 
 		/// Tie this channel to the owner object managed by shared_ptr,
 		/// prevent the owner object being destroyed in handleEvent.
@@ -49,7 +81,8 @@ namespace net
 
 		int fd() const { return fd_; }
 		int events() const { return events_; }
-		void set_revents(int revt) { revents_ = revt; } // used by pollers
+		// used by pollers, Ƴٵchannelһû¼¼ϲ
+		void set_revents(int revt) { revents_ = deferred_ ? (revents_ | revt) : revt; }
 		// int revents() const { return revents_; }
 		bool isNoneEvent() const { return events_ == kNoneEvent; }
 
@@ -60,10 +93,40 @@ namespace net
         bool disableAll();
 
 		bool isWriting() const { return events_ & kWriteEvent; }
+		bool isReading() const { return events_ & kReadEvent; }
+
+		/// ԵpollerԵģʽʱЧֻڼpoller֮ǰá
+		/// ʹ߱һֱдEAGAINֻд(EAGAIN)֮enableWritingղд֪ͨ
+		void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+		bool edgeTriggered() const { return edgeTriggered_; }
+
+		/// EPOLLEXCLUSIVEעᣬloopͬһsocketʱÿֻһ
+		void setExclusive(bool on) { exclusive_ = on; }
+		bool exclusive() const { return exclusive_; }
+
+		void setIoMode(int mode) { ioMode_ = mode; }
+		int ioMode() const { return ioMode_; }
+
+		/// һloop֮ڰȼַȸߺͣͬһڰpollص˳
+		/// EventLoop::setDispatchBudgetԤʱȼchannelƳٵһ
+		enum Priority
+		{
+			kHighPriority = 0,  // wakeup fdtimerfd
+			kNormalPriority,    // Ĭ
+			kLowPriority        // ݴ
+		};
+		void setPriority(int priority) { priority_ = priority; }
+		int priority() const { return priority_; }
+
+		// for EventLoop
+		bool deferred() const { return deferred_; }
+		void set_deferred(bool on) { deferred_ = on; }
 
 		// for Poller
 		int index() { return index_; }
 		void set_index(int idx) { index_ = idx; }
+		// handleEventλصһpollж
+		void addCompletion(const Completion& completion) { completions_.push_back(completion); }
 
 		// for debug
 		string reventsToString() const;
@@ -76,6 +139,8 @@ namespace net
 	private:
 		bool update();
 		void handleEventWithGuard(Timestamp receiveTime);
+		void handleCompletions(Timestamp receiveTime);
+		void dropCompletions();
 
 		static const int            kNoneEvent;
 		static const int            kReadEvent;
@@ -87,6 +152,11 @@ namespace net
 		int                         revents_; // it's the received event types of epoll or poll
 		int                         index_; // used by Poller.
 		bool                        logHup_;
+		bool                        edgeTriggered_;
+		bool                        exclusive_;
+		int                         priority_;
+		int                         ioMode_;
+		bool                        deferred_;      //¼Ƴٵһַַ
 
 		std::weak_ptr<void>         tie_;           //std::shared_ptr<void>/std::shared_ptr<void>ָͬ
 		bool                        tied_;
@@ -96,5 +166,7 @@ namespace net
 		EventCallback               writeCallback_;
 		EventCallback               closeCallback_;
 		EventCallback               errorCallback_;
+		CompletionCallback          completionCallback_;
+		std::vector<Completion>     completions_;   //ûصɽ
 	};
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Connector.h"
+#include <algorithm>
 #include <functional>
 #include <errno.h>
 #include <sstream>
@@ -111,6 +112,13 @@ void Connector::connect()
   }
 }
 
+void Connector::retryInLoop()
+{
+  //ȴڼѾstart()restart()
+  if (state_ == kDisconnected)
+    startInLoop();
+}
+
 void Connector::restart()
 {
   loop_->assertInLoopThread();
@@ -210,10 +218,10 @@ void Connector::retry(int sockfd)
   {
     LOG_INFO << "Connector::retry - Retry connecting to " << serverAddr_.toIpPort()
              << " in " << retryDelayMs_ << " milliseconds. ";
-    //loop_->runAfter(retryDelayMs_/1000.0,
-    //                std::bind(&Connector::startInLoop, shared_from_this()));
-    //retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
-	//ʱԣ todo
+    //ʱԣÿʧһμkMaxRetryDelayMsڼstop()ĻstartInLoopʲôҲ
+    loop_->runAfter(retryDelayMs_/1000.0,
+                    std::bind(&Connector::retryInLoop, shared_from_this()));
+    retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
   }
   else
   {
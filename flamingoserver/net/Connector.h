@@ -40,6 +40,7 @@ namespace net
 		void handleWrite();
 		void handleError();
 		void retry(int sockfd);
+		void retryInLoop();
 		int removeAndResetChannel();
 		void resetChannel();
 
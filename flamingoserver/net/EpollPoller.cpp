@@ -19,6 +19,10 @@ static_assert(EPOLLRDHUP == POLLRDHUP,"EPOLLRDHUP == POLLRDHUP");
 static_assert(EPOLLERR == POLLERR, "EPOLLERR == POLLERR");
 static_assert(EPOLLHUP == POLLHUP, "EPOLLHUP == POLLHUP");
 
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
 namespace
 {
 	const int kNew = -1;
@@ -27,9 +31,10 @@ namespace
 }
 
 EPollPoller::EPollPoller(EventLoop* loop)
-:epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
+:Poller(loop),
+epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
 events_(kInitEventListSize), 
-ownerLoop_(loop)
+edgeTriggered_(false)
 {
 	if (epollfd_ < 0)
 	{
@@ -45,8 +50,8 @@ EPollPoller::~EPollPoller()
 bool EPollPoller::hasChannel(Channel* channel) const
 {
 	assertInLoopThread();
-	ChannelMap::const_iterator it = channels_.find(channel->fd());
-	return it != channels_.end() && it->second == channel;
+	int fd = channel->fd();
+	return fd >= 0 && static_cast<size_t>(fd) < channels_.size() && channels_[fd] == channel;
 }
 
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels)
@@ -89,12 +94,7 @@ void EPollPoller::fillActiveChannels(int numEvents,
 	for (int i = 0; i < numEvents; ++i)
 	{
 		Channel* channel = static_cast<Channel*>(events_[i].data.ptr);
-#ifndef NDEBUG
-		int fd = channel->fd();
-		ChannelMap::const_iterator it = channels_.find(fd);
-		assert(it != channels_.end());
-		assert(it->second == channel);
-#endif
+		assert(hasChannel(channel));
 		channel->set_revents(events_[i].events);
 		activeChannels->push_back(channel);
 	}
@@ -110,14 +110,16 @@ bool EPollPoller::updateChannel(Channel* channel)
 		// a new one, add with EPOLL_CTL_ADD
 		int fd = channel->fd();
 		if (index == kNew)
-		{          
-            assert(channels_.find(fd) == channels_.end());
+		{
+			size_t need = static_cast<size_t>(fd) + 1;
+			if (need > channels_.size())
+				channels_.resize(need > 2 * channels_.size() ? need : 2 * channels_.size(), NULL);
+			assert(channels_[fd] == NULL);
 			channels_[fd] = channel;
 		}
 		else // index == kDeleted
 		{
-			assert(channels_.find(fd) != channels_.end());
-			assert(channels_[fd] == channel);
+			assert(hasChannel(channel));
 		}
 		channel->set_index(kAdded);
 		
@@ -126,9 +128,7 @@ bool EPollPoller::updateChannel(Channel* channel)
 	else
 	{
 		// update existing one with EPOLL_CTL_MOD/DEL
-		int fd = channel->fd();
-		assert(channels_.find(fd) != channels_.end());
-		assert(channels_[fd] == channel);
+		assert(hasChannel(channel));
 		assert(index == kAdded);
 		if (channel->isNoneEvent())
 		{
@@ -139,6 +139,17 @@ bool EPollPoller::updateChannel(Channel* channel)
             }
             return false;
 		}
+		else if (edgeTriggered(channel))
+		{
+			// registered for reading and writing already, Channel filters
+			// the events the owner is not interested in
+			return true;
+		}
+		else if (channel->exclusive())
+		{
+			// EPOLLEXCLUSIVE can not be modified, only added again
+			return update(EPOLL_CTL_DEL, channel) && update(EPOLL_CTL_ADD, channel);
+		}
 		else
 		{
             return update(EPOLL_CTL_MOD, channel);
@@ -151,14 +162,11 @@ void EPollPoller::removeChannel(Channel* channel)
 	assertInLoopThread();
 	int fd = channel->fd();
 	LOG_TRACE << "fd = " << fd;
-	assert(channels_.find(fd) != channels_.end());
-	assert(channels_[fd] == channel);
+	assert(hasChannel(channel));
 	assert(channel->isNoneEvent());
 	int index = channel->index();
 	assert(index == kAdded || index == kDeleted);
-	size_t n = channels_.erase(fd);
-	(void)n;
-	assert(n == 1);
+	channels_[fd] = NULL;
 
 	if (index == kAdded)
 	{
@@ -171,7 +179,8 @@ bool EPollPoller::update(int operation, Channel* channel)
 {
 	struct epoll_event event;
 	bzero(&event, sizeof event);
-	event.events = channel->events();
+	if (operation != EPOLL_CTL_DEL)
+		event.events = epollEvents(channel);
 	event.data.ptr = channel;
 	int fd = channel->fd();
 	if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
@@ -193,3 +202,21 @@ bool EPollPoller::update(int operation, Channel* channel)
 
     return true;
 }
+
+bool EPollPoller::edgeTriggered(const Channel* channel) const
+{
+	return edgeTriggered_ && channel->edgeTriggered();
+}
+
+int EPollPoller::epollEvents(const Channel* channel) const
+{
+	int events = channel->events();
+	if (edgeTriggered(channel))
+		events = POLLIN | POLLPRI | POLLOUT | EPOLLET;
+	if (channel->exclusive())
+	{
+		// only EPOLLIN, EPOLLOUT, EPOLLET and EPOLLWAKEUP may go with EPOLLEXCLUSIVE
+		events = (events & (POLLIN | POLLOUT | EPOLLET)) | EPOLLEXCLUSIVE;
+	}
+	return events;
+}
@@ -1,10 +1,10 @@
 #pragma once
 
 #include <vector>
-#include <map>
 
 #include "../base/Timestamp.h"
 #include "EventLoop.h"
+#include "Poller.h"
 
 struct epoll_event;
 
@@ -14,11 +14,9 @@ namespace net
 	///
 	/// IO Multiplexing with epoll(4).
 	///
-	class EPollPoller
+	class EPollPoller : public Poller
 	{
 	public:
-		typedef std::vector<Channel*> ChannelList;
-
 		EPollPoller(EventLoop* loop);
 		virtual ~EPollPoller();
 
@@ -28,19 +26,25 @@ namespace net
 
 		virtual bool hasChannel(Channel* channel) const;
 
-		//static EPollPoller* newDefaultPoller(EventLoop* loop);
+		/// Registers the channels that ask for it (Channel::setEdgeTriggered)
+		/// with EPOLLET. They are registered for both reading and writing
+		/// once, so enabling and disabling writing needs no epoll_ctl, and
+		/// they must read and write until EAGAIN.
+		/// Must be called before such channels are added.
+		virtual void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+		virtual bool edgeTriggered() const { return edgeTriggered_; }
 
-		void assertInLoopThread() const
-		{
-			ownerLoop_->assertInLoopThread();
-		}
+		virtual const char* name() const { return "epoll"; }
 
 	private:
 		static const int kInitEventListSize = 16;
 
 		void fillActiveChannels(int numEvents,
 			ChannelList* activeChannels) const;
-		bool update(int operation, Channel* channel);		
+		bool update(int operation, Channel* channel);
+		/// what is registered in epoll for channel
+		int epollEvents(const Channel* channel) const;
+		bool edgeTriggered(const Channel* channel) const;
 
 	private:
 		typedef std::vector<struct epoll_event> EventList;
@@ -48,10 +52,11 @@ namespace net
 		int epollfd_;
 		EventList events_;
 
-		typedef std::map<int, Channel*> ChannelMap;
+		// indexed by fd, fds are small and dense
+		typedef std::vector<Channel*> ChannelMap;
 
 		ChannelMap channels_;
-		EventLoop* ownerLoop_;
+		bool edgeTriggered_;
 	};
 
 }
\ No newline at end of file
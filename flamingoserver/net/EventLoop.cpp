@@ -1,13 +1,15 @@
 #include "EventLoop.h"
 #include <signal.h>
 #include <sys/eventfd.h>
+#include <time.h>
 #include <unistd.h>
+#include <algorithm>
 #include <sstream>
 #include <iostream>
 #include "../base/Logging.h"
 #include "TimerQueue.h"
 #include "Channel.h"
-#include "EpollPoller.h"
+#include "Poller.h"
 #include "Sockets.h"
 
 
@@ -19,6 +21,21 @@ namespace
 
 	const int kPollTimeMs = 1;
 
+	const size_t kPendingFunctorsCapacity = 4096;
+
+	//õʱǽʱ䱻NTPsettimeofdayʱӰ
+	int64_t monotonicMicroSeconds()
+	{
+		struct timespec ts;
+		::clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+	}
+
+	bool priorityHigher(const Channel* lhs, const Channel* rhs)
+	{
+		return lhs->priority() < rhs->priority();
+	}
+
 	int createEventfd()
 	{
 		int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
@@ -58,11 +75,37 @@ eventHandling_(false),
 callingPendingFunctors_(false),
 iteration_(0),
 threadId_(std::this_thread::get_id()),
-poller_(new EPollPoller(this)),
+poller_(Poller::newDefaultPoller(this)),
 timerQueue_(new TimerQueue(this)),
 wakeupFd_(createEventfd()),
 wakeupChannel_(new Channel(this, wakeupFd_)),
-currentActiveChannel_(NULL)
+currentActiveChannel_(NULL),
+dispatchBudgetUs_(0),
+pendingFunctors_(kPendingFunctorsCapacity),
+hasOverflow_(false),
+polling_(false),
+functorsRun_(0),
+wakeups_(0),
+overflows_(0),
+maxQueueDepth_(0),
+lastDrainTimeUs_(0),
+maxDrainTimeUs_(0),
+totalDrainTimeUs_(0),
+coalescedFlushes_(0),
+coalescedSends_(0),
+coalescedBytes_(0),
+deferredEvents_(0),
+overBudgetIterations_(0),
+latencyStats_(false),
+busyPollUs_(0),
+socketBusyPollUs_(0),
+lastActiveUs_(0),
+spinPolls_(0),
+spinHits_(0),
+sleeps_(0),
+connections_(0),
+cpuUsage_(0),
+lastCpuTimeNs_(0)
 {
 	if (t_loopInThisThread)
 	{
@@ -73,6 +116,7 @@ currentActiveChannel_(NULL)
 		t_loopInThisThread = this;
 	}
 	wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleRead, this));
+	wakeupChannel_->setPriority(Channel::kHighPriority);
 	// we are always reading the wakeupfd
 	wakeupChannel_->enableReading();
 
@@ -104,35 +148,125 @@ void EventLoop::loop()
 	quit_ = false;  // FIXME: what if someone calls quit() before loop() ?
 	LOG_TRACE << "EventLoop " << this << " start looping";
 
+	//һζĵʱӣ֮ûִбľֱӵһpollʼʱ䣬0ΪҪ¶
+	int64_t clockUs = 0;
 	while (!quit_)
 	{
 		activeChannels_.clear();
-		pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+		//ԼҪټУqueueInLoopټpolling_ԣ
+		//߶seq_cstӶloopȴѵ
+		int timeoutMs = kPollTimeMs;
+		//æѯԤڲҲpolling_߳ͶʱдwakeupFd_
+		//pollerصǽʱÿΨһضʱӣʱֻæѯַԤӳͳƿʱŶ
+		//;ͳƵĴһֿʼ
+		bool stats = latencyStats_;
+		bool timed = busyPollUs_ > 0 || stats;
+		if (timed && clockUs == 0)
+			clockUs = monotonicMicroSeconds();
+		bool spinning = busyPollUs_ > 0 && clockUs - lastActiveUs_ < busyPollUs_;
+		polling_ = !spinning;
+		if (hasPendingFunctors() || !afterIterationFunctors_.empty() || !deferredChannels_.empty())
+		{
+			polling_ = false;
+			timeoutMs = 0;
+		}
+		else if (spinning)
+		{
+			timeoutMs = 0;
+		}
+		int64_t pollStartUs = clockUs;
+		pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
+		int64_t pollReturnUs = timed || dispatchBudgetUs_ > 0 ? monotonicMicroSeconds() : 0;
+		clockUs = pollReturnUs;
+		polling_ = false;
 		++iteration_;
+		//֮־ʱͻỰȡʱ䶼pollصʱ䣬ٶʱ
+		Timestamp::setCachedNow(pollReturnTime_);
+		if (stats)
+			pollWaitUs_.record(pollReturnUs - pollStartUs);
+		int64_t functorsRunBefore = functorsRun_.load(std::memory_order_relaxed);
 		if (Logger::logLevel() <= Logger::TRACE)
 		{
 			printActiveChannels();
 		}
-		// TODO sort channel by priority
+		if (!deferredChannels_.empty())
+			takeDeferredChannels();
+		//ȼȷַͬһڱpollص˳
+		if (activeChannels_.size() > 1)
+			std::stable_sort(activeChannels_.begin(), activeChannels_.end(), priorityHigher);
+		activeChannelCounts_.record(static_cast<int64_t>(activeChannels_.size()));
 		eventHandling_ = true;
+		int64_t deadlineUs = dispatchBudgetUs_ > 0 ? pollReturnUs + dispatchBudgetUs_ : 0;
+		bool lowDispatched = false;
 		for (ChannelList::iterator it = activeChannels_.begin();
 			it != activeChannels_.end(); ++it)
 		{
-			currentActiveChannel_ = *it;
+			Channel* channel = *it;
+			if (deadlineUs > 0 && channel->priority() == Channel::kLowPriority)
+			{
+				//Ԥĵȼchannel¼һ֣ÿٴһһֱ
+				if (lowDispatched && monotonicMicroSeconds() > deadlineUs)
+				{
+					channel->set_deferred(true);
+					deferredChannels_.push_back(channel);
+					continue;
+				}
+				lowDispatched = true;
+			}
+			currentActiveChannel_ = channel;
 			currentActiveChannel_->handleEvent(pollReturnTime_);
 		}
 		currentActiveChannel_ = NULL;
 		eventHandling_ = false;
-		doPendingFunctors();
+		if (stats && !activeChannels_.empty())
+		{
+			clockUs = monotonicMicroSeconds();
+			dispatchUs_.record(clockUs - pollReturnUs);
+		}
+		if (!deferredChannels_.empty())
+		{
+			deferredEvents_.store(deferredEvents_.load(std::memory_order_relaxed) + static_cast<int64_t>(deferredChannels_.size()), std::memory_order_relaxed);
+			overBudgetIterations_.store(overBudgetIterations_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+		doPendingFunctors(stats ? &clockUs : NULL);
+		if (busyPollUs_ > 0)
+		{
+			bool active = !activeChannels_.empty() || functorsRun_.load(std::memory_order_relaxed) != functorsRunBefore;
+			if (active)
+				lastActiveUs_ = pollReturnUs;
+			if (timeoutMs > 0)
+				sleeps_.store(sleeps_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			else if (spinning)
+			{
+				spinPolls_.store(spinPolls_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				if (!activeChannels_.empty())
+					spinHits_.store(spinHits_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+		}
+
+		//ֲĺϲдͳһٵǼǵһ
+		if (!afterIterationFunctors_.empty())
+		{
+			runningAfterIteration_.swap(afterIterationFunctors_);
+			for (size_t i = 0; i < runningAfterIteration_.size(); ++i)
+				runningAfterIteration_[i]();
+			runningAfterIteration_.clear();
+			clockUs = 0;
+		}
 
 		if (frameFunctor_)
 		{
 			frameFunctor_();
+			clockUs = 0;
 		}		
+		//ͳʱصִڼûʱӣclockUsѾʱ
+		if (!stats)
+			clockUs = 0;
 	}
 
 	LOG_TRACE << "EventLoop " << this << " stop looping";
 	looping_ = false;  
+	Timestamp::setCachedNow(Timestamp::invalid());
 
 
     std::ostringstream oss;
@@ -153,7 +287,7 @@ void EventLoop::quit()
 	}
 }
 
-void EventLoop::runInLoop(const Functor& cb)
+void EventLoop::runInLoop(Task cb)
 {
 	if (isInLoopThread())
 	{
@@ -161,28 +295,134 @@ void EventLoop::runInLoop(const Functor& cb)
 	}
 	else
 	{
-		queueInLoop(cb);
+		queueInLoop(std::move(cb));
 	}
 }
 
-void EventLoop::queueInLoop(const Functor& cb)
+void EventLoop::queueInLoop(Task cb)
 {
+	//֮һֱoverflowFunctors_ֱloopȡգ֤ͬһߵ
+	if (hasOverflow_ || !pendingFunctors_.push(cb))
 	{
 		std::unique_lock<std::mutex> lock(mutex_);
-		pendingFunctors_.push_back(cb);
+		overflowFunctors_.push_back(std::move(cb));
+		hasOverflow_ = true;
+		++overflows_;
 	}
 
-	if (!isInLoopThread() || callingPendingFunctors_)
+	//loop߳ԼͶݵûѣ´poll֮ǰУ
+	//ֻ߳looppollʱдwakeupFd_ֻеһд
+	if (polling_ && polling_.exchange(false))
 	{
+		++wakeups_;
 		wakeup();
 	}
 }
 
+bool EventLoop::hasPendingFunctors() const
+{
+	return pendingFunctors_.size() > 0 || hasOverflow_;
+}
+
+const std::string EventLoop::info() const
+{
+	std::stringstream ss;
+	ss << "poller: " << poller_->name()
+	   << ", pending functors: " << pendingFunctors_.size()
+	   << ", max depth: " << maxQueueDepth_
+	   << ", run: " << functorsRun_
+	   << ", wakeups: " << wakeups_
+	   << ", overflows: " << overflows_;
+	if (latencyStats_)
+	{
+		ss << ", drain time(us) last: " << lastDrainTimeUs_
+		   << " max: " << maxDrainTimeUs_
+		   << " total: " << totalDrainTimeUs_;
+	}
+	ss << ", connections: " << connections_
+	   << ", cpu: " << cpuUsage_ / 100.0 << "%";
+	if (busyPollUs_ > 0)
+	{
+		ss << ", busy poll(us): " << busyPollUs_
+		   << " spins: " << spinPolls_
+		   << " spin hits: " << spinHits_
+		   << " sleeps: " << sleeps_;
+	}
+	int64_t flushes = coalescedFlushes_;
+	if (flushes > 0)
+	{
+		int64_t sends = coalescedSends_;
+		ss << ", coalesced sends: " << sends
+		   << " flushes: " << flushes
+		   << " syscalls saved: " << sends - flushes
+		   << " bytes/flush: " << coalescedBytes_ / flushes;
+	}
+	if (dispatchBudgetUs_ > 0)
+	{
+		ss << ", dispatch budget(us): " << dispatchBudgetUs_
+		   << " over budget: " << overBudgetIterations_
+		   << " deferred: " << deferredEvents_;
+	}
+	ss << "\n";
+	return ss.str();
+}
+
+const std::string EventLoop::latencyInfo() const
+{
+	std::stringstream ss;
+	if (!latencyStats_)
+		ss << "  poll wait, callback and functor times are off, see setLatencyStats\n";
+	ss << "  poll wait(us): " << pollWaitUs_.summary() << "\n"
+	   << "  active channels: " << activeChannelCounts_.summary() << "\n"
+	   << "  callbacks(us): " << dispatchUs_.summary() << "\n"
+	   << "  functors(us): " << functorsUs_.summary() << "\n"
+	   << "  functors run: " << functorCounts_.summary() << "\n"
+	   << "  timer lag(us): " << timerLagUs_.summary() << "\n";
+	return ss.str();
+}
+
+void EventLoop::addConnections(int n)
+{
+	connections_.fetch_add(n, std::memory_order_relaxed);
+}
+
+void EventLoop::sampleCpuUsage()
+{
+	assertInLoopThread();
+	struct timespec ts;
+	if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		return;
+
+	int64_t cpuTimeNs = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+	Timestamp now(Timestamp::now());
+	if (lastCpuSampleTime_.valid())
+	{
+		int64_t wallUs = now.microSecondsSinceEpoch() - lastCpuSampleTime_.microSecondsSinceEpoch();
+		if (wallUs > 0)
+			cpuUsage_.store((cpuTimeNs - lastCpuTimeNs_) * 10 / wallUs, std::memory_order_relaxed);
+	}
+	lastCpuTimeNs_ = cpuTimeNs;
+	lastCpuSampleTime_ = now;
+}
+
 void EventLoop::setFrameFunctor(const Functor& cb)
 {
 	frameFunctor_ = cb;
 }
 
+void EventLoop::runAfterIteration(Task cb)
+{
+	assertInLoopThread();
+	afterIterationFunctors_.push_back(std::move(cb));
+}
+
+void EventLoop::recordCoalescedFlush(int64_t sends, size_t bytes)
+{
+	coalescedFlushes_.store(coalescedFlushes_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	coalescedSends_.store(coalescedSends_.load(std::memory_order_relaxed) + sends, std::memory_order_relaxed);
+	coalescedBytes_.store(coalescedBytes_.load(std::memory_order_relaxed) + static_cast<int64_t>(bytes), std::memory_order_relaxed);
+}
+
 TimerId EventLoop::runAt(const Timestamp& time, const TimerCallback& cb)
 {
     return timerQueue_->addTimer(cb, time, 0.0);
@@ -222,6 +462,88 @@ void EventLoop::cancel(TimerId timerId)
     return timerQueue_->cancel(timerId);
 }
 
+void EventLoop::useTimingWheel(double tickSeconds)
+{
+    assertInLoopThread();
+    timerQueue_->useTimingWheel(tickSeconds);
+}
+
+void EventLoop::setEdgeTriggered(bool on)
+{
+	assertInLoopThread();
+	poller_->setEdgeTriggered(on);
+}
+
+bool EventLoop::edgeTriggered() const
+{
+	return poller_->edgeTriggered();
+}
+
+bool EventLoop::completionIo() const
+{
+	return poller_->completionIo();
+}
+
+void EventLoop::submitSend(Channel* channel, const OutputQueue& output)
+{
+	assertInLoopThread();
+	poller_->submitSend(channel, output);
+}
+
+void EventLoop::pollWritable(Channel* channel)
+{
+	assertInLoopThread();
+	poller_->pollWritable(channel);
+}
+
+void EventLoop::recycleBuffer(int bufferId)
+{
+	assertInLoopThread();
+	poller_->recycleBuffer(bufferId);
+}
+
+void EventLoop::setBusyPoll(int spinUs, int socketUs)
+{
+	assertInLoopThread();
+	busyPollUs_ = spinUs > 0 ? spinUs : 0;
+	socketBusyPollUs_ = socketUs > 0 ? socketUs : 0;
+}
+
+void EventLoop::setLatencyStats(bool on)
+{
+	assertInLoopThread();
+	latencyStats_ = on;
+}
+
+void EventLoop::setDispatchBudget(int budgetUs)
+{
+	assertInLoopThread();
+	dispatchBudgetUs_ = budgetUs > 0 ? budgetUs : 0;
+}
+
+void EventLoop::takeDeferredChannels()
+{
+	//pollֱ˵ѾactiveChannels_¼set_reventsʱϲ
+	for (size_t i = 0; i < activeChannels_.size(); ++i)
+		activeChannels_[i]->set_deferred(false);
+
+	//ǰ棬ȱȴڼ䲻ٹκ¼Ĳٷַ
+	size_t n = 0;
+	for (size_t i = 0; i < deferredChannels_.size(); ++i)
+	{
+		Channel* channel = deferredChannels_[i];
+		if (!channel->deferred())
+			continue;
+		channel->set_deferred(false);
+		if (!channel->isNoneEvent())
+			deferredChannels_[n++] = channel;
+	}
+	deferredChannels_.resize(n);
+	deferredChannels_.insert(deferredChannels_.end(), activeChannels_.begin(), activeChannels_.end());
+	activeChannels_.swap(deferredChannels_);
+	deferredChannels_.clear();
+}
+
 bool EventLoop::updateChannel(Channel* channel)
 {
 	assert(channel->ownerLoop() == this);
@@ -236,9 +558,14 @@ void EventLoop::removeChannel(Channel* channel)
 	assertInLoopThread();
 	if (eventHandling_)
 	{
-		assert(currentActiveChannel_ == channel ||
+		assert(currentActiveChannel_ == channel || channel->deferred() ||
 			std::find(activeChannels_.begin(), activeChannels_.end(), channel) == activeChannels_.end());
 	}
+	if (channel->deferred())
+	{
+		deferredChannels_.erase(std::find(deferredChannels_.begin(), deferredChannels_.end(), channel));
+		channel->set_deferred(false);
+	}
 	poller_->removeChannel(channel);
 }
 
@@ -276,21 +603,70 @@ void EventLoop::handleRead()
 	}
 }
 
-void EventLoop::doPendingFunctors()
+void EventLoop::doPendingFunctors(int64_t* clockUs)
 {
-	std::vector<Functor> functors;
+	//ִֻнʱڶִйͶݵһ֣Ͷݵio
+	size_t depth = pendingFunctors_.size();
+	if (depth == 0 && !hasOverflow_)
+		return;
+
 	callingPendingFunctors_ = true;
+	int64_t start = clockUs != NULL ? *clockUs : 0;
 
+	Task task;
+	size_t n = 0;
+	while (n < depth && pendingFunctors_.pop(task))
 	{
-		std::unique_lock<std::mutex> lock(mutex_);
-		functors.swap(pendingFunctors_);
+		task();
+		++n;
 	}
+	task.reset();
 
-	for (size_t i = 0; i < functors.size(); ++i)
+	if (hasOverflow_)
 	{
-		functors[i]();
+		//ڽoverflow֮ǰͶݵܻڻ֮дģ
+		//ڰѻȡִoverflow񣬷ͬһߵ
+		//ռλûûдĲҲҪȣڼֻܽoverflowԺܿ
+		std::vector<Task> functors;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (pendingFunctors_.size() > 0)
+			{
+				if (pendingFunctors_.pop(task))
+					functors.push_back(std::move(task));
+			}
+			functors.reserve(functors.size() + overflowFunctors_.size());
+			for (size_t i = 0; i < overflowFunctors_.size(); ++i)
+			{
+				functors.push_back(std::move(overflowFunctors_[i]));
+			}
+			overflowFunctors_.clear();
+			hasOverflow_ = false;
+		}
+
+		depth += functors.size();
+		for (size_t i = 0; i < functors.size(); ++i)
+		{
+			functors[i]();
+		}
+		n += functors.size();
 	}
 	callingPendingFunctors_ = false;
+
+	if (clockUs != NULL)
+	{
+		*clockUs = monotonicMicroSeconds();
+		int64_t drainTimeUs = *clockUs - start;
+		functorsUs_.record(drainTimeUs);
+		lastDrainTimeUs_ = drainTimeUs;
+		totalDrainTimeUs_ += drainTimeUs;
+		if (drainTimeUs > maxDrainTimeUs_)
+			maxDrainTimeUs_ = drainTimeUs;
+	}
+	functorCounts_.record(static_cast<int64_t>(n));
+	functorsRun_ += static_cast<int64_t>(n);
+	if (static_cast<int64_t>(depth) > maxQueueDepth_)
+		maxQueueDepth_ = static_cast<int64_t>(depth);
 }
 
 void EventLoop::printActiveChannels() const
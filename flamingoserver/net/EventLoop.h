@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <string>
 #include <vector>
 #include <memory>
 #include <functional>
@@ -9,13 +11,16 @@
 
 #include "../base/Timestamp.h"
 #include "Callbacks.h"
+#include "Histogram.h"
+#include "TaskQueue.h"
 #include "TimerId.h"
 
 namespace net
 {
 
 	class Channel;
-	class EPollPoller;
+	class OutputQueue;
+	class Poller;
     class TimerQueue;
 
 	///
@@ -54,11 +59,52 @@ namespace net
 		/// It wakes up the loop, and run the cb.
 		/// If in the same loop thread, cb is run within the function.
 		/// Safe to call from other threads.
-		void runInLoop(const Functor& cb);
+		void runInLoop(Task cb);
 		/// Queues callback in the loop thread.
 		/// Runs after finish pooling.
 		/// Safe to call from other threads.
-		void queueInLoop(const Functor& cb);
+		/// Lock free unless the task queue is full, the loop is only woken
+		/// up if it is parked in epoll_wait.
+		void queueInLoop(Task cb);
+
+		/// Runs callback at the end of the current loop iteration, after
+		/// the events and the queued functors were handled.
+		/// Must be called in the loop thread.
+		void runAfterIteration(Task cb);
+
+		/// Pending task queue statistics, safe to call from other threads.
+		const std::string info() const;
+
+		/// Per-iteration histograms: poll wait, active channels, time in
+		/// channel callbacks, time in and number of queued functors, and
+		/// how late timers fired. Times in microseconds, functors only
+		/// counted in iterations that ran some. The times need
+		/// setLatencyStats(true). Safe to call from other threads.
+		const std::string latencyInfo() const;
+		/// For TimerQueue, in loop thread.
+		Histogram& timerLagHistogram() { return timerLagUs_; }
+
+		/// One flush of sends coalesced within an iteration, see
+		/// TcpConnection::setCoalesceWrites. In loop thread.
+		void recordCoalescedFlush(int64_t sends, size_t bytes);
+
+		/// Load gauges, read by EventLoopThreadPool to place connections.
+		/// Safe to call from other threads.
+		///
+		/// Connections placed on this loop and not yet destroyed, counted by
+		/// TcpServer.
+		void addConnections(int n);
+		int connectionCount() const { return connections_.load(std::memory_order_relaxed); }
+		/// Tasks queued and not run yet.
+		size_t pendingFunctorCount() const { return pendingFunctors_.size(); }
+		/// Tasks that found the task queue full.
+		int64_t overflowCount() const { return overflows_.load(std::memory_order_relaxed); }
+		/// Share of the last sampling interval the loop thread spent on cpu,
+		/// in 1/10000.
+		int cpuUsage() const { return static_cast<int>(cpuUsage_.load(std::memory_order_relaxed)); }
+		/// Measures cpuUsage() since the previous call, with
+		/// CLOCK_THREAD_CPUTIME_ID. In loop thread.
+		void sampleCpuUsage();
 
         // timers
 
@@ -87,6 +133,62 @@ namespace net
         TimerId runAfter(double delay, TimerCallback&& cb);
         TimerId runEvery(double interval, TimerCallback&& cb);
 
+        ///
+        /// Keeps the timers of this loop in a hierarchical timing wheel
+        /// with a @c tickSeconds resolution instead of a sorted set.
+        /// Must be called in the loop thread, e.g. from the thread init
+        /// callback of EventLoopThreadPool.
+        ///
+        void useTimingWheel(double tickSeconds);
+
+		///
+		/// Registers TcpConnection sockets of this loop edge-triggered, see
+		/// EPollPoller::setEdgeTriggered. The io_uring poller always is. Must be called in the loop thread
+		/// before any connection is created on it.
+		///
+		void setEdgeTriggered(bool on);
+		bool edgeTriggered() const;
+
+		///
+		/// True if the poller takes completion mode channels, see
+		/// Channel::IoMode. Fixed when the loop is constructed, safe to call
+		/// from other threads. The rest must be called in the loop thread.
+		///
+		bool completionIo() const;
+		void submitSend(Channel* channel, const OutputQueue& output);
+		void pollWritable(Channel* channel);
+		void recycleBuffer(int bufferId);
+
+		///
+		/// Hybrid busy polling: for spinUs microseconds after the last
+		/// iteration that had events or functors, poll with a zero timeout
+		/// instead of blocking, and nobody needs to write the wakeup fd.
+		/// Connection sockets of this loop get SO_BUSY_POLL socketUs if it
+		/// is > 0 and permitted. Must be called in the loop thread.
+		///
+		void setBusyPoll(int spinUs, int socketUs);
+		int socketBusyPollUs() const { return socketBusyPollUs_; }
+		/// SO_BUSY_POLL was refused, stop trying it. In loop thread.
+		void disableSocketBusyPoll() { socketBusyPollUs_ = 0; }
+
+		///
+		/// Channels are always dispatched by Channel::Priority within one
+		/// iteration. With a budget, once budgetUs microseconds have passed
+		/// since poll returned, the remaining low priority channels keep
+		/// their events for the next iteration, which polls without
+		/// blocking. At least one low priority channel runs per iteration.
+		/// 0 disables the budget. Must be called in the loop thread.
+		///
+		void setDispatchBudget(int budgetUs);
+
+		///
+		/// Time poll wait, channel callbacks and queued functors of every
+		/// iteration on the monotonic clock, for latencyInfo() and the drain
+		/// times of info(). Off by default, the loop then reads no clock
+		/// but the poller's. Must be called in the loop thread, before loop().
+		///
+		void setLatencyStats(bool on);
+
 		void setFrameFunctor(const Functor& cb);
 
 		// internal usage
@@ -117,7 +219,12 @@ namespace net
 	private:
 		void abortNotInLoopThread();
 		void handleRead();  // waked up
-		void doPendingFunctors();
+		// clockUs: the last monotonic reading, the drain is timed and it is
+		// updated unless NULL
+		void doPendingFunctors(int64_t* clockUs);
+		bool hasPendingFunctors() const;
+		// puts channels deferred last iteration in front of the polled ones
+		void takeDeferredChannels();
 
 		void printActiveChannels() const; // DEBUG
 
@@ -131,7 +238,7 @@ namespace net
 		int64_t                             iteration_;
 		const std::thread::id               threadId_;
 		Timestamp                           pollReturnTime_;
-		std::shared_ptr<EPollPoller>        poller_;
+		std::shared_ptr<Poller>             poller_;
         std::shared_ptr<TimerQueue>         timerQueue_;
 
 		int wakeupFd_;
@@ -142,9 +249,59 @@ namespace net
 		// scratch variables
 		ChannelList                         activeChannels_;
 		Channel*                            currentActiveChannel_;
+		// low priority channels over the dispatch budget, in loop only
+		ChannelList                         deferredChannels_;
+		int                                 dispatchBudgetUs_;
 
+		TaskQueue                           pendingFunctors_;
+		// tasks that found pendingFunctors_ full, they keep their order
+		// because producers use this while hasOverflow_ is set
 		std::mutex                          mutex_;
-		std::vector<Functor>                pendingFunctors_; // Guarded by mutex_
+		std::vector<Task>                   overflowFunctors_; // Guarded by mutex_
+		std::atomic<bool>                   hasOverflow_;
+		// true while the loop may be blocked in poll, producers write
+		// wakeupFd_ only then, the first one clears it
+		std::atomic<bool>                   polling_;
+		// run at the end of the iteration, in loop only
+		std::vector<Task>                   afterIterationFunctors_;
+		std::vector<Task>                   runningAfterIteration_;
+
+		// statistics, written by the loop thread except wakeups_ and overflows_
+		std::atomic<int64_t>                functorsRun_;
+		std::atomic<int64_t>                wakeups_;
+		std::atomic<int64_t>                overflows_;
+		std::atomic<int64_t>                maxQueueDepth_;
+		std::atomic<int64_t>                lastDrainTimeUs_;
+		std::atomic<int64_t>                maxDrainTimeUs_;
+		std::atomic<int64_t>                totalDrainTimeUs_;
+		std::atomic<int64_t>                coalescedFlushes_;
+		std::atomic<int64_t>                coalescedSends_;
+		std::atomic<int64_t>                coalescedBytes_;
+		std::atomic<int64_t>                deferredEvents_;
+		std::atomic<int64_t>                overBudgetIterations_;
+
+		// per-iteration latency, written by the loop thread only
+		bool                                latencyStats_;
+		Histogram                           pollWaitUs_;
+		Histogram                           activeChannelCounts_;
+		Histogram                           dispatchUs_;
+		Histogram                           functorsUs_;
+		Histogram                           functorCounts_;
+		Histogram                           timerLagUs_;
+
+		// busy polling, settings in loop only
+		int                                 busyPollUs_;
+		int                                 socketBusyPollUs_;
+		int64_t                             lastActiveUs_;      // CLOCK_MONOTONIC, in loop only
+		std::atomic<int64_t>                spinPolls_;
+		std::atomic<int64_t>                spinHits_;
+		std::atomic<int64_t>                sleeps_;
+
+		// load gauges
+		std::atomic<int>                    connections_;
+		std::atomic<int64_t>                cpuUsage_;
+		int64_t                             lastCpuTimeNs_;     // in loop only
+		Timestamp                           lastCpuSampleTime_; // in loop only
 
 		Functor                             frameFunctor_;
 	};
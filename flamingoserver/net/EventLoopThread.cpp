@@ -5,10 +5,12 @@
 using namespace net;
 
 EventLoopThread::EventLoopThread(const ThreadInitCallback& cb,
-								 const std::string& name)
+								 const std::string& name,
+								 const ThreadStartCallback& startCb)
 								 : loop_(NULL),
 								 exiting_(false),
-								 callback_(cb)
+								 callback_(cb),
+								 startCallback_(startCb)
 {
 }
 
@@ -52,6 +54,11 @@ void EventLoopThread::stopLoop()
 
 void EventLoopThread::threadFunc()
 {
+	if (startCallback_)
+	{
+		startCallback_();
+	}
+
 	EventLoop loop;
 
 	if (callback_)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <mutex>
 #include <condition_variable> 
 #include <thread>
@@ -14,9 +15,12 @@ namespace net
 	{
 	public:
 		typedef std::function<void(EventLoop*)> ThreadInitCallback;
+		/// runs in the new thread before its EventLoop is created
+		typedef std::function<void()> ThreadStartCallback;
 
 		EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(),
-			const std::string& name = std::string());
+			const std::string& name = std::string(),
+			const ThreadStartCallback& startCb = ThreadStartCallback());
 		~EventLoopThread();
 		EventLoop* startLoop();
         void stopLoop();
@@ -30,6 +34,7 @@ namespace net
 		std::mutex                   mutex_;
 		std::condition_variable      cond_;
 		ThreadInitCallback           callback_;
+		ThreadStartCallback          startCallback_;
 	};
 
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "EventLoopThreadPool.h"
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <sstream>
 #include <string>
@@ -9,15 +10,49 @@
 
 using namespace net;
 
+const double EventLoopThreadPool::kLoadSampleInterval = 1.0;
 
 EventLoopThreadPool::EventLoopThreadPool()
 : baseLoop_(NULL),
 started_(false),
 numThreads_(0),
-next_(0)
+next_(0),
+placementPolicy_(kRoundRobin)
 {
 }
 
+bool EventLoopThreadPool::parsePlacementPolicy(const char* name, PlacementPolicy* policy)
+{
+	if (strcmp(name, "roundrobin") == 0)
+		*policy = kRoundRobin;
+	else if (strcmp(name, "leastconn") == 0)
+		*policy = kLeastConnections;
+	else if (strcmp(name, "leastcpu") == 0)
+		*policy = kLeastCpu;
+	else if (strcmp(name, "leastbacklog") == 0)
+		*policy = kLeastBacklog;
+	else
+		return false;
+	return true;
+}
+
+const char* EventLoopThreadPool::placementPolicyName(PlacementPolicy policy)
+{
+	switch (policy)
+	{
+	case kRoundRobin:
+		return "roundrobin";
+	case kLeastConnections:
+		return "leastconn";
+	case kLeastCpu:
+		return "leastcpu";
+	case kLeastBacklog:
+		return "leastbacklog";
+	default:
+		return "custom";
+	}
+}
+
 EventLoopThreadPool::~EventLoopThreadPool()
 {
 	// Don't delete loop, it's stack variable
@@ -42,10 +77,15 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
 		char buf[name_.size() + 32];
 		snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
 
-		std::shared_ptr<EventLoopThread> t(new EventLoopThread(cb, buf));
+		EventLoopThread::ThreadStartCallback startCb;
+		if (threadStartCallback_)
+			startCb = std::bind(threadStartCallback_, i);
+		std::shared_ptr<EventLoopThread> t(new EventLoopThread(cb, buf, startCb));
 		//EventLoopThread* t = new EventLoopThread(cb, buf);
 		threads_.push_back(t);
-		loops_.push_back(t->startLoop());
+		EventLoop* loop = t->startLoop();
+		loops_.push_back(loop);
+		loop->runEvery(kLoadSampleInterval, std::bind(&EventLoop::sampleCpuUsage, loop));
 	}
 	if (numThreads_ == 0 && cb)
 	{
@@ -92,6 +132,52 @@ EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode)
 	return loop;
 }
 
+EventLoop* EventLoopThreadPool::getLoopForConnection()
+{
+	baseLoop_->assertInLoopThread();
+	assert(started_);
+	if (loops_.empty() || placementPolicy_ == kRoundRobin)
+		return getNextLoop();
+
+	if (placementPolicy_ == kCustom)
+	{
+		EventLoop* loop = placementCallback_ ? placementCallback_(loops_) : NULL;
+		return loop != NULL ? loop : getNextLoop();
+	}
+
+	// start after the last pick, loops that tie take turns
+	size_t n = loops_.size();
+	size_t best = next_;
+	int64_t bestLoad = loadOf(loops_[best]);
+	for (size_t i = 1; i < n; ++i)
+	{
+		size_t index = (next_ + i) % n;
+		int64_t load = loadOf(loops_[index]);
+		if (load < bestLoad)
+		{
+			best = index;
+			bestLoad = load;
+		}
+	}
+	next_ = static_cast<int>((best + 1) % n);
+	return loops_[best];
+}
+
+int64_t EventLoopThreadPool::loadOf(const EventLoop* loop) const
+{
+	int64_t connections = loop->connectionCount();
+	switch (placementPolicy_)
+	{
+	case kLeastCpu:
+		// whole percents, smaller differences are noise of the sampling
+		return static_cast<int64_t>(loop->cpuUsage() / 100) << 32 | connections;
+	case kLeastBacklog:
+		return static_cast<int64_t>(loop->pendingFunctorCount()) << 32 | connections;
+	default:
+		return connections;
+	}
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
 {
 	baseLoop_->assertInLoopThread();
@@ -109,10 +195,36 @@ std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
 const std::string EventLoopThreadPool::info() const
 {
 	std::stringstream ss;
+	int minConnections = 0;
+	int maxConnections = 0;
+	for (size_t i = 0; i < loops_.size(); i++)
+	{
+		int connections = loops_[i]->connectionCount();
+		if (i == 0 || connections < minConnections)
+			minConnections = connections;
+		if (i == 0 || connections > maxConnections)
+			maxConnections = connections;
+	}
+	ss << "placement: " << placementPolicyName(placementPolicy_)
+	   << ", connections per loop min: " << minConnections
+	   << " max: " << maxConnections << endl;
 	ss << "print threads id info " << endl;
 	for (size_t i = 0; i < loops_.size(); i++)
 	{
 		ss << i << ": id = " << loops_[i]->getThreadID() << endl;
+		ss << loops_[i]->info();
+	}
+	return ss.str();
+}
+
+const std::string EventLoopThreadPool::latencyInfo() const
+{
+	std::stringstream ss;
+	for (size_t i = 0; i < loops_.size(); i++)
+	{
+		ss << i << ": id = " << loops_[i]->getThreadID()
+		   << ", connections: " << loops_[i]->connectionCount() << endl;
+		ss << loops_[i]->latencyInfo();
 	}
 	return ss.str();
 }
\ No newline at end of file
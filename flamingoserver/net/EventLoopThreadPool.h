@@ -15,11 +15,37 @@ namespace net
 	{
 	public:
 		typedef std::function<void(EventLoop*)> ThreadInitCallback;
+		/// runs in the index-th io loop thread before its EventLoop is created,
+		/// e.g. to pin the thread, so the loop and its buffer pool are
+		/// allocated where it runs
+		typedef std::function<void(int index)> ThreadStartCallback;
+		/// picks the loop of a new connection among the io loops
+		typedef std::function<EventLoop*(const std::vector<EventLoop*>& loops)> PlacementCallback;
+
+		/// how getLoopForConnection() places new connections
+		enum PlacementPolicy
+		{
+			kRoundRobin,
+			kLeastConnections,
+			/// least cpu time of the loop thread in the last sampling
+			/// interval, connection count breaks ties
+			kLeastCpu,
+			/// fewest queued functors, connection count breaks ties
+			kLeastBacklog,
+			/// setPlacementCallback()
+			kCustom
+		};
+
+		/// "roundrobin", "leastconn", "leastcpu" or "leastbacklog"
+		static bool parsePlacementPolicy(const char* name, PlacementPolicy* policy);
+		static const char* placementPolicyName(PlacementPolicy policy);
 
 		EventLoopThreadPool();
 		~EventLoopThreadPool();
 		
 		void Init(EventLoop* baseLoop, int numThreads);
+		/// before start()
+		void setThreadStartCallback(const ThreadStartCallback& cb) { threadStartCallback_ = cb; }
 		void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
         void stop();
@@ -31,6 +57,16 @@ namespace net
 		/// with the same hash code, it will always return the same EventLoop
 		EventLoop* getLoopForHash(size_t hashCode);
 
+		/// loop for a new connection, chosen by the placement policy.
+		/// Loops that tie are taken in round-robin order.
+		EventLoop* getLoopForConnection();
+
+		/// may be called at any time from the base loop thread
+		void setPlacementPolicy(PlacementPolicy policy) { placementPolicy_ = policy; }
+		void setPlacementCallback(const PlacementCallback& cb)
+		{ placementCallback_ = cb; placementPolicy_ = kCustom; }
+		PlacementPolicy placementPolicy() const { return placementPolicy_; }
+
 		std::vector<EventLoop*> getAllLoops();
 
 		bool started() const
@@ -40,8 +76,15 @@ namespace net
 		{ return name_; }
 
 		const std::string info() const;
+		/// EventLoop::latencyInfo of each loop
+		const std::string latencyInfo() const;
+
+		/// interval of EventLoop::sampleCpuUsage() on the io loops
+		static const double kLoadSampleInterval;
 
 	private:
+		/// load of a loop under the policy, lower is better
+		int64_t loadOf(const EventLoop* loop) const;
 
 		EventLoop*                                      baseLoop_;
 		std::string                                     name_;
@@ -50,6 +93,9 @@ namespace net
 		int                                             next_;
 		std::vector<std::shared_ptr<EventLoopThread> >  threads_;
 		std::vector<EventLoop*>                         loops_;
+		PlacementPolicy                                 placementPolicy_;
+		PlacementCallback                               placementCallback_;
+		ThreadStartCallback                             threadStartCallback_;
 	};
 
 }
\ No newline at end of file
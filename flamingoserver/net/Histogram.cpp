@@ -0,0 +1,90 @@
+#include "Histogram.h"
+#include <sstream>
+
+using namespace net;
+
+const int Histogram::kSubBucketBits;
+const int Histogram::kSubBuckets;
+const int Histogram::kBuckets;
+
+Histogram::Histogram()
+: count_(0),
+sum_(0),
+max_(0)
+{
+	for (int i = 0; i < kBuckets; ++i)
+		counts_[i].store(0, std::memory_order_relaxed);
+}
+
+int Histogram::bucketOf(int64_t value)
+{
+	if (value < 2 * kSubBuckets)
+		return static_cast<int>(value);
+
+	// value is in [2^msb, 2^(msb+1)), its top kSubBucketBits + 1 bits pick the bucket
+	int msb = 63 - __builtin_clzll(static_cast<unsigned long long>(value));
+	int shift = msb - kSubBucketBits;
+	int index = shift * kSubBuckets + static_cast<int>(value >> shift);
+	return index < kBuckets ? index : kBuckets - 1;
+}
+
+int64_t Histogram::lowerBound(int index)
+{
+	if (index < 2 * kSubBuckets)
+		return index;
+
+	int shift = index / kSubBuckets - 1;
+	return static_cast<int64_t>(index % kSubBuckets + kSubBuckets) << shift;
+}
+
+int64_t Histogram::upperBound(int index)
+{
+	if (index < 2 * kSubBuckets)
+		return index;
+
+	int shift = index / kSubBuckets - 1;
+	return lowerBound(index) + (static_cast<int64_t>(1) << shift) - 1;
+}
+
+int64_t Histogram::mean() const
+{
+	int64_t n = count();
+	return n > 0 ? sum_.load(std::memory_order_relaxed) / n : 0;
+}
+
+int64_t Histogram::percentile(double p) const
+{
+	int64_t n = count();
+	if (n <= 0)
+		return 0;
+
+	int64_t rank = static_cast<int64_t>(p / 100.0 * static_cast<double>(n) + 0.5);
+	if (rank < 1)
+		rank = 1;
+	int64_t seen = 0;
+	for (int i = 0; i < kBuckets; ++i)
+	{
+		seen += counts_[i].load(std::memory_order_relaxed);
+		if (seen >= rank)
+		{
+			// the bucket bound can overshoot what was actually recorded
+			int64_t bound = upperBound(i);
+			int64_t top = max();
+			return bound < top ? bound : top;
+		}
+	}
+	return max();
+}
+
+std::string Histogram::summary() const
+{
+	std::stringstream ss;
+	ss << "count: " << count()
+	   << " mean: " << mean()
+	   << " p50: " << percentile(50)
+	   << " p90: " << percentile(90)
+	   << " p99: " << percentile(99)
+	   << " p999: " << percentile(99.9)
+	   << " max: " << max();
+	return ss.str();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+namespace net
+{
+
+	///
+	/// Log-linear histogram of non-negative int64 values, HDR style.
+	///
+	/// Values below 2 * kSubBuckets have a bucket each, above that every
+	/// power of 2 is split into kSubBuckets linear buckets, so a bucket is
+	/// never wider than 1/kSubBuckets of its values (12.5%). Values beyond
+	/// the last bucket are counted in it.
+	///
+	/// One writer, e.g. the loop thread, any number of readers. Counters
+	/// are relaxed atomics, readers see a slightly torn but never invalid
+	/// snapshot and nobody takes a lock.
+	class Histogram
+	{
+	public:
+		static const int kSubBucketBits = 3;
+		static const int kSubBuckets = 1 << kSubBucketBits;
+		// up to 2^48, 8.9 years in microseconds
+		static const int kBuckets = (48 - kSubBucketBits + 1) * kSubBuckets;
+
+		Histogram();
+		~Histogram() = default;
+
+		Histogram(const Histogram& rhs) = delete;
+		Histogram& operator=(const Histogram& rhs) = delete;
+
+		/// Writer only.
+		void record(int64_t value)
+		{
+			if (value < 0)
+				value = 0;
+			int index = bucketOf(value);
+			counts_[index].store(counts_[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+			if (value > max_.load(std::memory_order_relaxed))
+				max_.store(value, std::memory_order_relaxed);
+		}
+
+		/// Thread safe.
+		int64_t count() const { return count_.load(std::memory_order_relaxed); }
+		int64_t max() const { return max_.load(std::memory_order_relaxed); }
+		int64_t mean() const;
+		/// Upper bound of the bucket holding the p-th percentile, 0 < p <= 100.
+		/// 0 if nothing was recorded.
+		int64_t percentile(double p) const;
+
+		/// "count: n mean: m p50: a p90: b p99: c p999: d max: e"
+		std::string summary() const;
+
+		static int bucketOf(int64_t value);
+		/// Smallest and largest value of a bucket.
+		static int64_t lowerBound(int index);
+		static int64_t upperBound(int index);
+
+	private:
+		std::atomic<int64_t>        counts_[kBuckets];
+		std::atomic<int64_t>        count_;
+		std::atomic<int64_t>        sum_;
+		std::atomic<int64_t>        max_;
+	};
+
+}
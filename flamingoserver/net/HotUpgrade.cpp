@@ -0,0 +1,319 @@
+#include "HotUpgrade.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "../base/Logging.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Sockets.h"
+#include "TcpServer.h"
+
+extern char** environ;
+
+using namespace net;
+
+const char* const HotUpgrade::kEnvName = "FLAMINGO_UPGRADE_FD";
+
+namespace
+{
+	const char kReady = 'R';
+	// how often the loop looks for a pending SIGUSR2
+	const double kSignalCheckInterval = 0.5;
+
+	volatile sig_atomic_t                       g_upgradeRequested = 0;
+
+	std::mutex                                  g_serversMutex;
+	std::vector<TcpServer*>                     g_servers;
+
+	// old process, touched in g_loop only
+	EventLoop*                                  g_loop = NULL;
+	std::string                                 g_exePath;
+	std::vector<std::string>                    g_argv;
+	HotUpgrade::UpgradedCallback                g_upgradedCallback;
+	std::shared_ptr<Channel>                    g_replyChannel;
+	pid_t                                       g_childPid = -1;
+
+	// new process, touched in main() only
+	int                                         g_readyFd = -1;
+	std::map<std::string, std::vector<int> >    g_inherited;
+
+	void onSignal(int)
+	{
+		g_upgradeRequested = 1;
+	}
+
+	// only for a child that is known to exit: it saw EOF on the socketpair or closed it
+	void reap(pid_t pid)
+	{
+		while (::waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+			;
+	}
+}
+
+bool HotUpgrade::inheritListeners()
+{
+	const char* env = ::getenv(kEnvName);
+	if (env == NULL)
+		return false;
+
+	int fd = ::atoi(env);
+	// programs this process starts must not take it for an upgrade
+	::unsetenv(kEnvName);
+
+	std::vector<int> fds;
+	std::string hostports;
+	// the old process gave up the upgrade and waits for this one to exit,
+	// it keeps serving, binding the same addresses here would run two servers
+	if (!sockets::recvFds(fd, &fds, &hostports))
+	{
+		LOG_ERROR << "HotUpgrade: no listening sockets received from the old process, exit";
+		::exit(1);
+	}
+	::fcntl(fd, F_SETFD, FD_CLOEXEC);
+	g_readyFd = fd;
+
+	// one line per fd
+	size_t start = 0;
+	for (size_t i = 0; i < fds.size(); ++i)
+	{
+		size_t end = hostports.find('\n', start);
+		if (end == std::string::npos)
+		{
+			LOG_ERROR << "HotUpgrade: no address for inherited socket " << fds[i];
+			::close(fds[i]);
+			continue;
+		}
+		g_inherited[hostports.substr(start, end - start)].push_back(fds[i]);
+		start = end + 1;
+	}
+
+	LOG_INFO << "HotUpgrade: inherited " << fds.size() << " listening sockets on " << g_inherited.size() << " addresses";
+	return true;
+}
+
+std::vector<int> HotUpgrade::takeListeners(const std::string& hostport)
+{
+	std::vector<int> fds;
+	std::map<std::string, std::vector<int> >::iterator it = g_inherited.find(hostport);
+	if (it != g_inherited.end())
+	{
+		fds.swap(it->second);
+		g_inherited.erase(it);
+	}
+	return fds;
+}
+
+void HotUpgrade::notifyReady()
+{
+	if (g_readyFd < 0)
+		return;
+
+	// addresses no longer configured, their queued connections are lost.
+	// the old process still holds these sockets, a close() alone would
+	// leave them listening and in their SO_REUSEPORT group with nobody
+	// accepting. shutdown() stops the socket itself for both processes
+	for (const auto& inherited : g_inherited)
+	{
+		LOG_WARN << "HotUpgrade: nobody listens on " << inherited.first << " any more, shutting down " << inherited.second.size() << " inherited sockets";
+		for (size_t i = 0; i < inherited.second.size(); ++i)
+		{
+			::shutdown(inherited.second[i], SHUT_RDWR);
+			::close(inherited.second[i]);
+		}
+	}
+	g_inherited.clear();
+
+	if (sockets::write(g_readyFd, &kReady, 1) != 1)
+		LOG_SYSERR << "HotUpgrade: notify the old process";
+	else
+		LOG_INFO << "HotUpgrade: ready, the old process stops accepting";
+	::close(g_readyFd);
+	g_readyFd = -1;
+}
+
+void HotUpgrade::enable(EventLoop* loop, char* const argv[], const UpgradedCallback& cb)
+{
+	g_loop = loop;
+	g_upgradedCallback = cb;
+	g_argv.clear();
+	for (int i = 0; argv[i] != NULL; ++i)
+		g_argv.push_back(argv[i]);
+
+	// the path, not /proc/self/exe itself: the binary there may be replaced before the upgrade
+	char path[4096];
+	ssize_t n = ::readlink("/proc/self/exe", path, sizeof path - 1);
+	if (n <= 0)
+	{
+		LOG_SYSERR << "HotUpgrade: readlink /proc/self/exe";
+		return;
+	}
+	g_exePath.assign(path, static_cast<size_t>(n));
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof sa);
+	sa.sa_handler = onSignal;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	::sigaction(SIGUSR2, &sa, NULL);
+
+	loop->runEvery(kSignalCheckInterval, []() {
+		if (g_upgradeRequested)
+		{
+			g_upgradeRequested = 0;
+			upgrade();
+		}
+	});
+	LOG_INFO << "HotUpgrade: send SIGUSR2 to " << ::getpid() << " to restart " << g_exePath;
+}
+
+bool HotUpgrade::upgrade()
+{
+	g_loop->assertInLoopThread();
+	if (g_replyChannel)
+	{
+		LOG_WARN << "HotUpgrade: process " << g_childPid << " is still starting, upgrade ignored";
+		return false;
+	}
+
+	std::vector<int> fds;
+	std::string hostports;
+	{
+		std::lock_guard<std::mutex> guard(g_serversMutex);
+		for (auto server : g_servers)
+		{
+			std::vector<int> serverFds = server->listenFds();
+			for (size_t i = 0; i < serverFds.size(); ++i)
+			{
+				fds.push_back(serverFds[i]);
+				hostports += server->hostport() + "\n";
+			}
+		}
+	}
+	if (fds.empty() || fds.size() > static_cast<size_t>(sockets::kMaxPassedFds))
+	{
+		LOG_ERROR << "HotUpgrade: cannot hand over " << fds.size() << " listening sockets";
+		return false;
+	}
+
+	int sv[2];
+	if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+	{
+		LOG_SYSERR << "HotUpgrade: socketpair";
+		return false;
+	}
+
+	// everything the child needs is built before fork, it may only exec
+	char fdEnv[64];
+	snprintf(fdEnv, sizeof fdEnv, "%s=%d", kEnvName, sv[1]);
+	std::vector<char*> envp;
+	size_t nameLen = strlen(kEnvName);
+	for (char** env = environ; *env != NULL; ++env)
+	{
+		if (strncmp(*env, kEnvName, nameLen) != 0 || (*env)[nameLen] != '=')
+			envp.push_back(*env);
+	}
+	envp.push_back(fdEnv);
+	envp.push_back(NULL);
+	std::vector<char*> argv;
+	for (size_t i = 0; i < g_argv.size(); ++i)
+		argv.push_back(const_cast<char*>(g_argv[i].c_str()));
+	argv.push_back(NULL);
+
+	pid_t pid = ::fork();
+	if (pid == 0)
+	{
+		::fcntl(sv[1], F_SETFD, 0);
+		::execve(g_exePath.c_str(), &argv[0], &envp[0]);
+		::_exit(127);
+	}
+	::close(sv[1]);
+	if (pid < 0)
+	{
+		LOG_SYSERR << "HotUpgrade: fork";
+		::close(sv[0]);
+		return false;
+	}
+
+	// a few hundred bytes, they wait in the socket until the child reads them
+	if (!sockets::sendFds(sv[0], fds, hostports))
+	{
+		LOG_ERROR << "HotUpgrade: hand over to process " << pid << " failed";
+		// the child reads EOF and exits
+		::close(sv[0]);
+		reap(pid);
+		return false;
+	}
+
+	LOG_INFO << "HotUpgrade: started " << g_exePath << " as process " << pid << " with " << fds.size() << " listening sockets";
+	g_childPid = pid;
+	g_replyChannel.reset(new Channel(g_loop, sv[0]));
+	g_replyChannel->setReadCallback([](Timestamp) { handleReply(); });
+	g_replyChannel->enableReading();
+	return true;
+}
+
+void HotUpgrade::handleReply()
+{
+	char reply = 0;
+	ssize_t n = sockets::read(g_replyChannel->fd(), &reply, 1);
+	if (n == 1 && reply == kReady)
+	{
+		LOG_INFO << "HotUpgrade: process " << g_childPid << " is ready, stop accepting";
+		{
+			std::lock_guard<std::mutex> guard(g_serversMutex);
+			for (auto server : g_servers)
+				server->stopAccepting();
+		}
+		finish();
+		if (g_upgradedCallback)
+			g_upgradedCallback();
+		return;
+	}
+
+	// exec failed or the new process died during its initialization
+	// EOF comes when the child's fds are closed, its exit status may not be there yet
+	LOG_ERROR << "HotUpgrade: process " << g_childPid << " exited before it was ready, still serving";
+	reap(g_childPid);
+	finish();
+}
+
+void HotUpgrade::finish()
+{
+	// called from the channel's own callback, it is destroyed afterwards
+	std::shared_ptr<Channel> channel;
+	channel.swap(g_replyChannel);
+	channel->disableAll();
+	channel->remove();
+	g_loop->queueInLoop([channel]() { ::close(channel->fd()); });
+	g_childPid = -1;
+}
+
+void HotUpgrade::addServer(TcpServer* server)
+{
+	std::lock_guard<std::mutex> guard(g_serversMutex);
+	g_servers.push_back(server);
+}
+
+void HotUpgrade::removeServer(TcpServer* server)
+{
+	std::lock_guard<std::mutex> guard(g_serversMutex);
+	for (size_t i = 0; i < g_servers.size(); ++i)
+	{
+		if (g_servers[i] == server)
+		{
+			g_servers.erase(g_servers.begin() + i);
+			break;
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace net
+{
+
+	class EventLoop;
+	class TcpServer;
+
+	///
+	/// Restart without closing the listening sockets.
+	///
+	/// On SIGUSR2 the running binary is exec'd again and gets the listening
+	/// sockets of every started TcpServer over a unix socket (SCM_RIGHTS).
+	/// The new process adopts them instead of binding, so connections queued
+	/// in the accept backlog are not reset. Once it has started its servers
+	/// it reports ready, the old process stops accepting and keeps serving
+	/// the connections it has until it exits.
+	///
+	/// If the new process dies before it is ready, nothing changes and the
+	/// upgrade may be retried.
+	class HotUpgrade
+	{
+	public:
+		typedef std::function<void()> UpgradedCallback;
+
+		/// names the inherited unix socket in the environment of the new process
+		static const char* const kEnvName;
+
+		/// In the new process, before any TcpServer is constructed. Receives
+		/// the listening sockets of the old one, false if this process was
+		/// not started by an upgrade. Exits if the old process gave up the
+		/// upgrade before it handed the sockets over.
+		static bool inheritListeners();
+
+		/// inherited sockets listening on hostport, the caller owns them
+		static std::vector<int> takeListeners(const std::string& hostport);
+
+		/// In the new process, after all servers are started. Closes the
+		/// inherited sockets nobody took and tells the old process to stop
+		/// accepting.
+		static void notifyReady();
+
+		/// In the old process: SIGUSR2 runs upgrade() in loop, cb runs in
+		/// loop once the new process is ready and accepting has stopped.
+		/// argv is what the new process is started with.
+		static void enable(EventLoop* loop, char* const argv[], const UpgradedCallback& cb);
+
+		/// starts the new process, false if it could not be started
+		/// Must be called in the loop of enable()
+		static bool upgrade();
+
+		/// called by TcpServer::start and ~TcpServer, thread safe
+		static void addServer(TcpServer* server);
+		static void removeServer(TcpServer* server);
+
+	private:
+		static void handleReply();
+		static void finish();
+	};
+
+}
@@ -0,0 +1,842 @@
+#include "IoUringPoller.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#endif
+#endif
+
+#include "../base/Logging.h"
+#include "Channel.h"
+
+using namespace net;
+
+const unsigned IoUringPoller::kRingEntries;
+const unsigned IoUringPoller::kBufferCount;
+const unsigned IoUringPoller::kBufferSize;
+const int IoUringPoller::kBufferGroup;
+
+IoUringPoller::Entry::Entry()
+: channel(NULL),
+generation(0),
+armedEvents(0),
+revents(0),
+activeRound(0),
+rearm(false),
+receiveState(kReceiveIdle),
+pollingWritable(false),
+sending(false)
+{
+}
+
+// multishot poll and IORING_FEAT_RSRC_TAGS both came with 5.13
+#ifdef IORING_FEAT_RSRC_TAGS
+
+namespace
+{
+	const int kNew = -1;
+	const int kAdded = 1;
+	const int kDeleted = 2;
+
+	// kind of request, part of user_data
+	enum Op
+	{
+		kOpPoll,
+		kOpAccept,
+		kOpRecv,
+		kOpSend,
+		kOpPollOut
+	};
+
+	// user_data of the POLL_REMOVE, ASYNC_CANCEL and PROVIDE_BUFFERS requests, their completions are dropped
+	const uint64_t kRemoveTag = UINT64_MAX;
+	const uint32_t kGenerationMask = 0xffffff;
+
+	int sysIoUringSetup(unsigned entries, struct io_uring_params* params)
+	{
+		return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+	}
+
+	int sysIoUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize)
+	{
+		return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, arg, argSize));
+	}
+
+	// generation:24 | op:8 | fd:32
+	uint64_t makeUserData(int fd, uint32_t generation, int op)
+	{
+		return (static_cast<uint64_t>(generation & kGenerationMask) << 40)
+			| (static_cast<uint64_t>(op) << 32)
+			| static_cast<uint32_t>(fd);
+	}
+}
+
+// multishot recv and provided buffer rings came with 6.0
+#ifdef IORING_RECV_MULTISHOT
+#define FLAMINGO_IORING_COMPLETIONS 1
+#endif
+
+IoUringPoller::IoUringPoller(EventLoop* loop, bool completions)
+: Poller(loop),
+ringFd_(-1),
+features_(0),
+ringPtr_(NULL),
+ringSize_(0),
+sqes_(NULL),
+sqesSize_(0),
+sqHead_(NULL),
+sqTail_(NULL),
+sqMask_(0),
+sqEntries_(0),
+sqArray_(NULL),
+sqPending_(0),
+cqHead_(NULL),
+cqTail_(NULL),
+cqMask_(0),
+cqes_(NULL),
+completionIo_(false),
+buffers_(NULL),
+freeBuffers_(0),
+round_(0)
+{
+	if (setupRing() && completions)
+		completionIo_ = setupBuffers();
+}
+
+IoUringPoller::~IoUringPoller()
+{
+	for (std::map<uint64_t, SendOp*>::iterator it = orphanSends_.begin(); it != orphanSends_.end(); ++it)
+		delete it->second;
+	// closing the ring cancels whatever is still in flight
+	if (sqes_ != NULL)
+		::munmap(sqes_, sqesSize_);
+	if (ringPtr_ != NULL)
+		::munmap(ringPtr_, ringSize_);
+	if (ringFd_ >= 0)
+		::close(ringFd_);
+	if (buffers_ != NULL)
+		::munmap(buffers_, static_cast<size_t>(kBufferCount) * kBufferSize);
+}
+
+bool IoUringPoller::setupRing()
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof params);
+	// every channel keeps a poll request in flight, leave room for bursts
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = kRingEntries * 4;
+
+	int ringFd = sysIoUringSetup(kRingEntries, &params);
+	if (ringFd < 0)
+	{
+		LOG_SYSERR << "io_uring_setup";
+		return false;
+	}
+
+	const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+	if ((params.features & required) != required)
+	{
+		LOG_ERROR << "io_uring features " << params.features << " lack multishot poll, need Linux 5.13";
+		::close(ringFd);
+		return false;
+	}
+
+	size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	size_t ringSize = sqSize > cqSize ? sqSize : cqSize;
+	void* ring = ::mmap(NULL, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	if (ring == MAP_FAILED)
+	{
+		LOG_SYSERR << "mmap io_uring rings";
+		::close(ringFd);
+		return false;
+	}
+
+	size_t sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	void* sqes = ::mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+	{
+		LOG_SYSERR << "mmap io_uring sqes";
+		::munmap(ring, ringSize);
+		::close(ringFd);
+		return false;
+	}
+
+	char* p = static_cast<char*>(ring);
+	ringPtr_ = ring;
+	ringSize_ = ringSize;
+	sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+	sqesSize_ = sqesSize;
+	sqHead_ = reinterpret_cast<unsigned*>(p + params.sq_off.head);
+	sqTail_ = reinterpret_cast<unsigned*>(p + params.sq_off.tail);
+	sqMask_ = *reinterpret_cast<unsigned*>(p + params.sq_off.ring_mask);
+	sqEntries_ = params.sq_entries;
+	sqArray_ = reinterpret_cast<unsigned*>(p + params.sq_off.array);
+	cqHead_ = reinterpret_cast<unsigned*>(p + params.cq_off.head);
+	cqTail_ = reinterpret_cast<unsigned*>(p + params.cq_off.tail);
+	cqMask_ = *reinterpret_cast<unsigned*>(p + params.cq_off.ring_mask);
+	cqes_ = reinterpret_cast<struct io_uring_cqe*>(p + params.cq_off.cqes);
+	features_ = params.features;
+	ringFd_ = ringFd;
+	return true;
+}
+
+bool IoUringPoller::setupBuffers()
+{
+#ifdef FLAMINGO_IORING_COMPLETIONS
+	size_t bufferBytes = static_cast<size_t>(kBufferCount) * kBufferSize;
+	void* buffers = ::mmap(NULL, bufferBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffers == MAP_FAILED)
+	{
+		LOG_SYSERR << "mmap io_uring receive buffers";
+		return false;
+	}
+
+	// the ring is still empty, so the one completion is the answer to this
+	struct io_uring_sqe* sqe = getSqe();
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = static_cast<int>(kBufferCount);
+	sqe->addr = reinterpret_cast<uint64_t>(buffers);
+	sqe->len = kBufferSize;
+	sqe->off = 0;
+	sqe->buf_group = kBufferGroup;
+	int n = sysIoUringEnter(ringFd_, sqPending_, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+	int res = -EIO;
+	if (n >= 0)
+	{
+		sqPending_ = 0;
+		unsigned head = *cqHead_;
+		if (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+		{
+			res = cqes_[head & cqMask_].res;
+			__atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+		}
+	}
+	else
+	{
+		res = -errno;
+	}
+	if (res < 0)
+	{
+		LOG_ERROR << "io_uring provide buffers failed: " << strerror(-res) << ", staying with poll requests";
+		::munmap(buffers, bufferBytes);
+		return false;
+	}
+
+	buffers_ = static_cast<char*>(buffers);
+	freeBuffers_ = kBufferCount;
+	return true;
+#else
+	LOG_ERROR << "built without multishot recv, staying with poll requests";
+	return false;
+#endif
+}
+
+struct io_uring_sqe* IoUringPoller::getSqe()
+{
+	unsigned tail = *sqTail_;
+	if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+	{
+		// full, hand what we have to the kernel without waiting
+		int n = sysIoUringEnter(ringFd_, sqPending_, 0, 0, NULL, 0);
+		if (n < 0)
+		{
+			LOG_SYSFATAL << "io_uring_enter";
+		}
+		sqPending_ -= static_cast<unsigned>(n);
+	}
+
+	// without SQPOLL the kernel reads the queue in io_uring_enter only,
+	// so the entry can be published before it is filled in
+	unsigned index = tail & sqMask_;
+	struct io_uring_sqe* sqe = &sqes_[index];
+	memset(sqe, 0, sizeof *sqe);
+	sqArray_[index] = index;
+	__atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+	++sqPending_;
+	return sqe;
+}
+
+int IoUringPoller::submitAndWait(int timeoutMs)
+{
+	unsigned minComplete = 0;
+	unsigned flags = 0;
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	memset(&ts, 0, sizeof ts);
+	memset(&arg, 0, sizeof arg);
+	const void* argp = NULL;
+	size_t argSize = 0;
+
+	bool cqEmpty = *cqHead_ == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+	if (timeoutMs != 0 && cqEmpty)
+	{
+		minComplete = 1;
+		flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+		if (timeoutMs > 0)
+		{
+			ts.tv_sec = timeoutMs / 1000;
+			ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+			arg.ts = reinterpret_cast<uint64_t>(&ts);
+		}
+		arg.sigmask_sz = _NSIG / 8;
+		argp = &arg;
+		argSize = sizeof arg;
+	}
+
+	if (sqPending_ == 0 && minComplete == 0)
+		return 0;
+
+	int n = sysIoUringEnter(ringFd_, sqPending_, minComplete, flags, argp, argSize);
+	if (n > 0)
+		sqPending_ -= static_cast<unsigned>(n) < sqPending_ ? static_cast<unsigned>(n) : sqPending_;
+	return n;
+}
+
+uint32_t IoUringPoller::pollEvents(const Channel* channel) const
+{
+	// like EPOLLET, edge-triggered channels are armed for both directions once
+	if (channel->edgeTriggered())
+		return POLLIN | POLLPRI | POLLOUT;
+	return static_cast<uint32_t>(channel->events());
+}
+
+void IoUringPoller::arm(Entry& entry, int fd)
+{
+	uint32_t events = pollEvents(entry.channel);
+	struct io_uring_sqe* sqe = getSqe();
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = events;
+	if (entry.channel->edgeTriggered())
+		sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = makeUserData(fd, entry.generation, kOpPoll);
+	entry.armedEvents = events;
+}
+
+void IoUringPoller::disarm(Entry& entry, int fd)
+{
+	if (entry.armedEvents != 0)
+	{
+		struct io_uring_sqe* sqe = getSqe();
+		sqe->opcode = IORING_OP_POLL_REMOVE;
+		sqe->fd = -1;
+		sqe->addr = makeUserData(fd, entry.generation, kOpPoll);
+		sqe->user_data = kRemoveTag;
+		entry.armedEvents = 0;
+	}
+	// whatever the old request still completes with is dropped
+	++entry.generation;
+}
+
+void IoUringPoller::cancel(uint64_t userData)
+{
+	struct io_uring_sqe* sqe = getSqe();
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = userData;
+	sqe->user_data = kRemoveTag;
+}
+
+void IoUringPoller::armReceive(Entry& entry, int fd)
+{
+#ifdef FLAMINGO_IORING_COMPLETIONS
+	struct io_uring_sqe* sqe = getSqe();
+	sqe->fd = fd;
+	if (entry.channel->ioMode() == Channel::kAcceptCompletions)
+	{
+		// the peer address is asked with getpeername() by the Acceptor
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->user_data = makeUserData(fd, entry.generation, kOpAccept);
+	}
+	else
+	{
+		sqe->opcode = IORING_OP_RECV;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = kBufferGroup;
+		sqe->user_data = makeUserData(fd, entry.generation, kOpRecv);
+	}
+	entry.receiveState = kReceiveArmed;
+#endif
+}
+
+void IoUringPoller::scheduleRearm(Entry& entry, int fd)
+{
+	if (!entry.rearm)
+	{
+		entry.rearm = true;
+		rearmFds_.push_back(fd);
+	}
+}
+
+void IoUringPoller::submitSend(Channel* channel, const OutputQueue& output)
+{
+	assertInLoopThread();
+	int fd = channel->fd();
+	assert(hasChannel(channel));
+	Entry& entry = entries_[fd];
+	assert(!entry.sending);
+	if (!entry.send)
+		entry.send.reset(new SendOp);
+
+	SendOp* op = entry.send.get();
+	op->holds.clear();
+	int iovcnt = output.peek(op->iov, OutputQueue::kMaxIovec, &op->holds);
+	memset(&op->msg, 0, sizeof op->msg);
+	op->msg.msg_iov = op->iov;
+	op->msg.msg_iovlen = iovcnt;
+
+	struct io_uring_sqe* sqe = getSqe();
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = fd;
+	sqe->addr = reinterpret_cast<uint64_t>(&op->msg);
+	sqe->len = 1;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = makeUserData(fd, entry.generation, kOpSend);
+	entry.sending = true;
+}
+
+void IoUringPoller::pollWritable(Channel* channel)
+{
+	assertInLoopThread();
+	int fd = channel->fd();
+	assert(hasChannel(channel));
+	Entry& entry = entries_[fd];
+	if (entry.pollingWritable)
+		return;
+
+	struct io_uring_sqe* sqe = getSqe();
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = POLLOUT;
+	sqe->user_data = makeUserData(fd, entry.generation, kOpPollOut);
+	entry.pollingWritable = true;
+}
+
+void IoUringPoller::recycleBuffer(int bufferId)
+{
+	assert(bufferId >= 0 && static_cast<unsigned>(bufferId) < kBufferCount);
+	recycled_.push_back(static_cast<uint16_t>(bufferId));
+	++freeBuffers_;
+}
+
+void IoUringPoller::publishBuffers()
+{
+#ifdef FLAMINGO_IORING_COMPLETIONS
+	// one PROVIDE_BUFFERS per run of consecutive ids, they reach the kernel
+	// with the io_uring_enter of this poll(), ahead of the recvs that need them
+	size_t i = 0;
+	while (i < recycled_.size())
+	{
+		size_t j = i + 1;
+		while (j < recycled_.size() && recycled_[j] == recycled_[j - 1] + 1)
+			++j;
+		struct io_uring_sqe* sqe = getSqe();
+		sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+		sqe->fd = static_cast<int>(j - i);
+		sqe->addr = reinterpret_cast<uint64_t>(buffers_ + static_cast<size_t>(recycled_[i]) * kBufferSize);
+		sqe->len = kBufferSize;
+		sqe->off = recycled_[i];
+		sqe->buf_group = kBufferGroup;
+		sqe->user_data = kRemoveTag;
+		i = j;
+	}
+	recycled_.clear();
+#endif
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList* activeChannels)
+{
+	++round_;
+	publishBuffers();
+
+	size_t kept = 0;
+	for (size_t i = 0; i < rearmFds_.size(); ++i)
+	{
+		int fd = rearmFds_[i];
+		Entry& entry = entries_[fd];
+		entry.rearm = false;
+		if (entry.channel == NULL)
+			continue;
+		if (entry.channel->ioMode() == Channel::kReadiness)
+		{
+			if (entry.armedEvents == 0 && !entry.channel->isNoneEvent())
+				arm(entry, fd);
+		}
+		else if (entry.receiveState == kReceiveIdle && entry.channel->isReading())
+		{
+			// a recv armed without buffers would end right away, wait until some come back
+			if (entry.channel->ioMode() == Channel::kRecvCompletions && freeBuffers_ == 0)
+			{
+				entry.rearm = true;
+				rearmFds_[kept++] = fd;
+				continue;
+			}
+			armReceive(entry, fd);
+		}
+	}
+	rearmFds_.resize(kept);
+
+	int n = submitAndWait(timeoutMs);
+	int savedErrno = errno;
+	Timestamp now(Timestamp::now());
+	if (n < 0 && savedErrno != ETIME && savedErrno != EINTR && savedErrno != EAGAIN && savedErrno != EBUSY)
+	{
+		errno = savedErrno;
+		LOG_SYSERR << "IoUringPoller::poll()";
+	}
+
+	size_t first = activeChannels->size();
+	unsigned head = *cqHead_;
+	unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+	for (; head != tail; ++head)
+	{
+		handleCompletion(&cqes_[head & cqMask_], activeChannels);
+	}
+	__atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+	for (size_t i = first; i < activeChannels->size(); ++i)
+	{
+		Channel* channel = (*activeChannels)[i];
+		channel->set_revents(static_cast<int>(entries_[channel->fd()].revents));
+	}
+	if (activeChannels->size() > first)
+	{
+		LOG_TRACE << activeChannels->size() - first << " events happended";
+	}
+	return now;
+}
+
+void IoUringPoller::markActive(Entry& entry, uint32_t revents, ChannelList* activeChannels)
+{
+	if (entry.activeRound != round_)
+	{
+		entry.activeRound = round_;
+		entry.revents = revents;
+		activeChannels->push_back(entry.channel);
+	}
+	else
+	{
+		entry.revents |= revents;
+	}
+}
+
+void IoUringPoller::handleCompletion(const struct io_uring_cqe* cqe, ChannelList* activeChannels)
+{
+	if (cqe->user_data == kRemoveTag)
+		return;
+
+	int fd = static_cast<int>(cqe->user_data & 0xffffffff);
+	int op = static_cast<int>((cqe->user_data >> 32) & 0xff);
+	uint32_t generation = static_cast<uint32_t>(cqe->user_data >> 40);
+	if (fd < 0 || static_cast<size_t>(fd) >= entries_.size())
+		return;
+	Entry& entry = entries_[fd];
+	if (entry.channel == NULL || (entry.generation & kGenerationMask) != generation)
+	{
+		dropStaleCompletion(op, cqe);
+		return;
+	}
+
+	if (op == kOpSend)
+	{
+		entry.sending = false;
+		entry.send->holds.clear();
+		Channel::Completion completion = { Channel::kSent, cqe->res, NULL, -1 };
+		entry.channel->addCompletion(completion);
+		markActive(entry, 0, activeChannels);
+		return;
+	}
+	if (op == kOpPollOut)
+	{
+		entry.pollingWritable = false;
+		if (cqe->res == -ECANCELED)
+			return;
+		Channel::Completion completion = { Channel::kWritable, cqe->res, NULL, -1 };
+		entry.channel->addCompletion(completion);
+		markActive(entry, 0, activeChannels);
+		return;
+	}
+	if (op == kOpAccept || op == kOpRecv)
+	{
+		handleReceiveCompletion(entry, fd, cqe, activeChannels);
+		return;
+	}
+
+	if (!(cqe->flags & IORING_CQE_F_MORE))
+	{
+		// oneshot done, or the kernel ended the multishot request
+		entry.armedEvents = 0;
+		scheduleRearm(entry, fd);
+	}
+
+	uint32_t revents;
+	if (cqe->res >= 0)
+	{
+		revents = static_cast<uint32_t>(cqe->res);
+	}
+	else if (cqe->res == -ECANCELED)
+	{
+		return;
+	}
+	else
+	{
+		LOG_ERROR << "IoUringPoller poll fd=" << fd << " failed: " << strerror(-cqe->res);
+		revents = POLLERR;
+	}
+	markActive(entry, revents, activeChannels);
+}
+
+void IoUringPoller::handleReceiveCompletion(Entry& entry, int fd, const struct io_uring_cqe* cqe, ChannelList* activeChannels)
+{
+	bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+	int res = cqe->res;
+	Channel::Completion completion = { Channel::kAccepted, res, NULL, -1 };
+	bool deliver = res != -ECANCELED && res != -ENOBUFS;
+#ifdef FLAMINGO_IORING_COMPLETIONS
+	if (cqe->flags & IORING_CQE_F_BUFFER)
+	{
+		completion.bufferId = static_cast<int>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+		completion.data = buffers_ + static_cast<size_t>(completion.bufferId) * kBufferSize;
+		--freeBuffers_;
+	}
+#endif
+	if (entry.channel->ioMode() == Channel::kRecvCompletions)
+		completion.op = Channel::kReceived;
+
+	if (!more)
+	{
+		// the request ended: cancelled, out of buffers, EOF or an error.
+		// only the first two mean the socket can still deliver something
+		entry.receiveState = kReceiveIdle;
+		bool stillOpen = res > 0 || res == -ENOBUFS || res == -ECANCELED
+			|| (completion.op == Channel::kAccepted && res != -EINVAL && res != -EBADF);
+		if (stillOpen && entry.channel->isReading())
+			scheduleRearm(entry, fd);
+	}
+
+	if (deliver)
+	{
+		entry.channel->addCompletion(completion);
+		markActive(entry, 0, activeChannels);
+	}
+	else if (completion.bufferId >= 0)
+	{
+		recycleBuffer(completion.bufferId);
+	}
+}
+
+void IoUringPoller::dropStaleCompletion(int op, const struct io_uring_cqe* cqe)
+{
+	// the channel is gone, free what the request still produced
+	if (op == kOpSend)
+	{
+		std::map<uint64_t, SendOp*>::iterator it = orphanSends_.find(cqe->user_data);
+		if (it != orphanSends_.end())
+		{
+			delete it->second;
+			orphanSends_.erase(it);
+		}
+		return;
+	}
+#ifdef FLAMINGO_IORING_COMPLETIONS
+	if (cqe->flags & IORING_CQE_F_BUFFER)
+	{
+		--freeBuffers_;
+		recycleBuffer(static_cast<int>(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+	}
+#endif
+	if (op == kOpAccept && cqe->res >= 0)
+		::close(cqe->res);
+}
+
+void IoUringPoller::updateCompletionChannel(Entry& entry, int fd)
+{
+	//写不用关注：发送都是提交的请求，Channel的写标志只表示有发送在途
+	if (entry.channel->isReading())
+	{
+		if (entry.receiveState == kReceiveIdle)
+		{
+			if (entry.channel->ioMode() == Channel::kRecvCompletions && freeBuffers_ == 0)
+				scheduleRearm(entry, fd);
+			else
+				armReceive(entry, fd);
+		}
+		// while cancelling, the last completion of the old request arms it again
+	}
+	else if (entry.receiveState == kReceiveArmed)
+	{
+		// what arrives before the cancel takes effect is still delivered
+		int op = entry.channel->ioMode() == Channel::kAcceptCompletions ? kOpAccept : kOpRecv;
+		cancel(makeUserData(fd, entry.generation, op));
+		entry.receiveState = kReceiveCancelling;
+	}
+}
+
+bool IoUringPoller::updateChannel(Channel* channel)
+{
+	assertInLoopThread();
+	LOG_TRACE << "fd = " << channel->fd() << " events = " << channel->events();
+	const int index = channel->index();
+	int fd = channel->fd();
+	if (index == kNew || index == kDeleted)
+	{
+		if (index == kNew)
+		{
+			size_t need = static_cast<size_t>(fd) + 1;
+			if (need > entries_.size())
+				entries_.resize(need > 2 * entries_.size() ? need : 2 * entries_.size());
+			assert(entries_[fd].channel == NULL);
+			entries_[fd].channel = channel;
+		}
+		else // index == kDeleted
+		{
+			assert(hasChannel(channel));
+		}
+		channel->set_index(kAdded);
+		if (channel->ioMode() != Channel::kReadiness)
+		{
+			if (!completionIo_)
+				LOG_FATAL << "completion mode channel fd=" << fd << " on a poll-only io_uring";
+			updateCompletionChannel(entries_[fd], fd);
+		}
+		else
+		{
+			arm(entries_[fd], fd);
+		}
+		return true;
+	}
+
+	assert(hasChannel(channel));
+	assert(index == kAdded);
+	Entry& entry = entries_[fd];
+	if (channel->ioMode() != Channel::kReadiness)
+	{
+		updateCompletionChannel(entry, fd);
+		if (channel->isNoneEvent())
+			channel->set_index(kDeleted);
+		return true;
+	}
+
+	if (channel->isNoneEvent())
+	{
+		disarm(entry, fd);
+		channel->set_index(kDeleted);
+		return true;
+	}
+
+	// an unchanged mask, always the case for edge-triggered channels, needs nothing
+	if (entry.armedEvents == pollEvents(channel))
+		return true;
+
+	disarm(entry, fd);
+	arm(entry, fd);
+	return true;
+}
+
+void IoUringPoller::removeChannel(Channel* channel)
+{
+	assertInLoopThread();
+	int fd = channel->fd();
+	LOG_TRACE << "fd = " << fd;
+	assert(hasChannel(channel));
+	assert(channel->isNoneEvent());
+	int index = channel->index();
+	assert(index == kAdded || index == kDeleted);
+
+	Entry& entry = entries_[fd];
+	if (channel->ioMode() != Channel::kReadiness)
+	{
+		int op = channel->ioMode() == Channel::kAcceptCompletions ? kOpAccept : kOpRecv;
+		if (entry.receiveState == kReceiveArmed)
+			cancel(makeUserData(fd, entry.generation, op));
+		if (entry.pollingWritable)
+			cancel(makeUserData(fd, entry.generation, kOpPollOut));
+		// the kernel may still read the frames of a send, they are freed when it completes
+		if (entry.sending)
+			orphanSends_[makeUserData(fd, entry.generation, kOpSend)] = entry.send.release();
+		entry.receiveState = kReceiveIdle;
+		entry.pollingWritable = false;
+		entry.sending = false;
+	}
+	disarm(entry, fd);
+	entry.channel = NULL;
+	channel->set_index(kNew);
+}
+
+bool IoUringPoller::hasChannel(Channel* channel) const
+{
+	assertInLoopThread();
+	int fd = channel->fd();
+	return fd >= 0 && static_cast<size_t>(fd) < entries_.size() && entries_[fd].channel == channel;
+}
+
+#else // no io_uring headers, Poller::newDefaultPoller falls back to epoll
+
+IoUringPoller::IoUringPoller(EventLoop* loop, bool completions)
+: Poller(loop),
+ringFd_(-1),
+completionIo_(false),
+round_(0)
+{
+	LOG_ERROR << "built without io_uring support";
+}
+
+IoUringPoller::~IoUringPoller()
+{
+}
+
+// valid() is false, newDefaultPoller never hands this poller to a loop
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList* activeChannels)
+{
+	LOG_ERROR << "IoUringPoller::poll built without io_uring support";
+	if (timeoutMs > 0)
+		::usleep(timeoutMs * 1000);
+	return Timestamp::now();
+}
+
+bool IoUringPoller::updateChannel(Channel* channel)
+{
+	LOG_ERROR << "IoUringPoller::updateChannel built without io_uring support, fd=" << channel->fd();
+	return false;
+}
+
+void IoUringPoller::removeChannel(Channel* channel)
+{
+	LOG_ERROR << "IoUringPoller::removeChannel built without io_uring support, fd=" << channel->fd();
+}
+
+bool IoUringPoller::hasChannel(Channel* channel) const
+{
+	return false;
+}
+
+void IoUringPoller::submitSend(Channel* channel, const OutputQueue& output)
+{
+	LOG_ERROR << "IoUringPoller::submitSend built without io_uring support, fd=" << channel->fd();
+}
+
+void IoUringPoller::pollWritable(Channel* channel)
+{
+	LOG_ERROR << "IoUringPoller::pollWritable built without io_uring support, fd=" << channel->fd();
+}
+
+void IoUringPoller::recycleBuffer(int bufferId)
+{
+}
+
+#endif
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "OutputQueue.h"
+#include "Poller.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace net
+{
+
+	///
+	/// IO Multiplexing with io_uring(7), talking to the kernel with raw
+	/// syscalls.
+	///
+	/// Readiness channels (Channel::kReadiness) each have a poll request in
+	/// the ring. Edge-triggered channels get a multishot poll for reading
+	/// and writing that stays armed, like EPOLLET. The others get a oneshot
+	/// poll that is armed again at the next poll() while they are still
+	/// interested, which behaves like level-triggered epoll.
+	///
+	/// Completion channels are not polled. While reading is enabled a
+	/// listening socket keeps a multishot accept and a connection a
+	/// multishot recv in the ring. Received bytes land in provided buffers
+	/// shared by all connections of the loop, and are handed to the channel
+	/// as Channel::Completion, the buffer is provided again after the
+	/// callback. Sends are sendmsg requests that
+	/// reach the kernel with the next io_uring_enter, together with the
+	/// sends of every other connection of that iteration.
+	///
+	/// Arming, disarming, sending and waiting all go through the submission
+	/// queue, so one io_uring_enter per loop iteration replaces epoll_wait
+	/// plus the epoll_ctl, read and write calls of that iteration.
+	///
+	/// Needs Linux 5.13 (multishot poll, IORING_FEAT_EXT_ARG), completions
+	/// need Linux 6.0 (multishot recv).
+	/// EPOLLEXCLUSIVE has no counterpart, shared listen sockets wake all loops.
+	class IoUringPoller : public Poller
+	{
+	public:
+		/// completions: take completion mode channels if the kernel can
+		IoUringPoller(EventLoop* loop, bool completions);
+		virtual ~IoUringPoller();
+
+		/// false if the ring could not be set up
+		bool valid() const { return ringFd_ >= 0; }
+
+		virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels);
+		virtual bool updateChannel(Channel* channel);
+		virtual void removeChannel(Channel* channel);
+
+		virtual bool hasChannel(Channel* channel) const;
+
+		/// multishot poll is always edge-triggered
+		virtual void setEdgeTriggered(bool on) { }
+		virtual bool edgeTriggered() const { return true; }
+
+		virtual const char* name() const { return completionIo_ ? "io_uring(completions)" : "io_uring"; }
+
+		virtual bool completionIo() const { return completionIo_; }
+		virtual void submitSend(Channel* channel, const OutputQueue& output);
+		virtual void pollWritable(Channel* channel);
+		virtual void recycleBuffer(int bufferId);
+
+	private:
+		static const unsigned kRingEntries = 4096;
+		// provided receive buffers, 4MB per loop
+		static const unsigned kBufferCount = 1024;
+		static const unsigned kBufferSize = 4096;
+		static const int      kBufferGroup = 0;
+
+		// a sendmsg in flight, the kernel reads msg and iov and the bytes
+		// of holds until it completes
+		struct SendOp
+		{
+			struct msghdr               msg;
+			struct iovec                iov[OutputQueue::kMaxIovec];
+			std::vector<SharedBuffer>   holds;
+		};
+
+		// multishot accept or recv of a completion channel
+		enum ReceiveState
+		{
+			kReceiveIdle,
+			kReceiveArmed,
+			kReceiveCancelling
+		};
+
+		struct Entry
+		{
+			Entry();
+
+			Channel*    channel;
+			// part of user_data, completions of older requests are dropped
+			uint32_t    generation;
+			// mask of the poll request in flight, 0 if none
+			uint32_t    armedEvents;
+			uint32_t    revents;
+			// last poll() round this entry was put into activeChannels
+			uint64_t    activeRound;
+			bool        rearm;
+
+			// completion channels
+			int                         receiveState;
+			bool                        pollingWritable;
+			bool                        sending;
+			std::unique_ptr<SendOp>     send;   // reused, NULL until the first send
+		};
+
+		bool setupRing();
+		bool setupBuffers();
+		io_uring_sqe* getSqe();
+		/// submits what is queued, waiting for one completion at most timeoutMs
+		int submitAndWait(int timeoutMs);
+		void arm(Entry& entry, int fd);
+		void disarm(Entry& entry, int fd);
+		uint32_t pollEvents(const Channel* channel) const;
+		void handleCompletion(const io_uring_cqe* cqe, ChannelList* activeChannels);
+		void markActive(Entry& entry, uint32_t revents, ChannelList* activeChannels);
+
+		void updateCompletionChannel(Entry& entry, int fd);
+		void armReceive(Entry& entry, int fd);
+		void cancel(uint64_t userData);
+		void scheduleRearm(Entry& entry, int fd);
+		void handleReceiveCompletion(Entry& entry, int fd, const io_uring_cqe* cqe, ChannelList* activeChannels);
+		void dropStaleCompletion(int op, const io_uring_cqe* cqe);
+		void publishBuffers();
+
+	private:
+		int                     ringFd_;
+		unsigned                features_;
+
+		void*                   ringPtr_;
+		size_t                  ringSize_;
+		io_uring_sqe*           sqes_;
+		size_t                  sqesSize_;
+
+		unsigned*               sqHead_;
+		unsigned*               sqTail_;
+		unsigned                sqMask_;
+		unsigned                sqEntries_;
+		unsigned*               sqArray_;
+		unsigned                sqPending_;
+
+		unsigned*               cqHead_;
+		unsigned*               cqTail_;
+		unsigned                cqMask_;
+		io_uring_cqe*           cqes_;
+
+		bool                    completionIo_;
+		char*                   buffers_;
+		// buffers given back since the last poll(), provided again by it
+		std::vector<uint16_t>   recycled_;
+		unsigned                freeBuffers_;
+
+		// indexed by fd
+		std::vector<Entry>      entries_;
+		// channels that need a request armed again at the next poll()
+		std::vector<int>        rearmFds_;
+		// sends of removed channels, by user_data, freed when they complete
+		std::map<uint64_t, SendOp*> orphanSends_;
+		uint64_t                round_;
+	};
+
+}
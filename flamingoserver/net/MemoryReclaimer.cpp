@@ -0,0 +1,149 @@
+#include "MemoryReclaimer.h"
+
+#include <sstream>
+
+#include "../base/Logging.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+
+using namespace net;
+
+const double MemoryReclaimer::kSweepInterval = 1.0;
+
+MemoryReclaimer::MemoryReclaimer(double idleSeconds, size_t budgetBytes, bool disconnectOverBudget)
+: idleSeconds_(idleSeconds),
+budgetBytes_(budgetBytes),
+disconnectOverBudget_(disconnectOverBudget)
+{
+}
+
+MemoryReclaimer::~MemoryReclaimer()
+{
+}
+
+void MemoryReclaimer::addLoop(EventLoop* loop)
+{
+	if (stateOf(loop) != NULL)
+		return;
+
+	LoopState* state = new LoopState();
+	state->loop = loop;
+	state->connectionCount = 0;
+	state->bytesReserved = 0;
+	state->bytesInUse = 0;
+	state->bytesReclaimed = 0;
+	state->idleReclaims = 0;
+	state->budgetReclaims = 0;
+	state->budgetDisconnects = 0;
+	loops_.push_back(std::unique_ptr<LoopState>(state));
+
+	// FIXME: unsafe, the reclaimer lives as long as the server
+	loop->runEvery(kSweepInterval, std::bind(&MemoryReclaimer::sweep, this, state));
+}
+
+MemoryReclaimer::LoopState* MemoryReclaimer::stateOf(EventLoop* loop) const
+{
+	for (size_t i = 0; i < loops_.size(); ++i)
+	{
+		if (loops_[i]->loop == loop)
+			return loops_[i].get();
+	}
+	return NULL;
+}
+
+void MemoryReclaimer::track(const TcpConnectionPtr& conn)
+{
+	conn->getLoop()->assertInLoopThread();
+	LoopState* state = stateOf(conn->getLoop());
+	if (state != NULL)
+		state->connections[conn.get()] = conn;
+}
+
+void MemoryReclaimer::untrack(const TcpConnectionPtr& conn)
+{
+	conn->getLoop()->assertInLoopThread();
+	LoopState* state = stateOf(conn->getLoop());
+	if (state != NULL)
+		state->connections.erase(conn.get());
+}
+
+void MemoryReclaimer::sweep(LoopState* state)
+{
+	Timestamp now = Timestamp::cachedNow();
+	int64_t reserved = 0;
+	int64_t inUse = 0;
+	std::vector<TcpConnectionPtr> overBudget;
+
+	auto it = state->connections.begin();
+	while (it != state->connections.end())
+	{
+		TcpConnectionPtr conn = it->second.lock();
+		if (!conn || !conn->connected())
+		{
+			it = state->connections.erase(it);
+			continue;
+		}
+		++it;
+
+		size_t connReserved = conn->memoryReserved();
+		if (budgetBytes_ > 0 && connReserved > budgetBytes_)
+		{
+			state->bytesReclaimed += conn->reclaimMemory();
+			++state->budgetReclaims;
+			connReserved = conn->memoryReserved();
+			if (connReserved > budgetBytes_ && disconnectOverBudget_)
+				overBudget.push_back(conn);
+		}
+		else if (idleSeconds_ > 0 && connReserved > 0 && timeDifference(now, conn->lastActiveTime()) >= idleSeconds_)
+		{
+			// a connection whose buffers are already at their minimum frees nothing
+			size_t freed = conn->reclaimMemory();
+			if (freed > 0)
+			{
+				state->bytesReclaimed += freed;
+				++state->idleReclaims;
+				connReserved = conn->memoryReserved();
+			}
+		}
+
+		reserved += connReserved;
+		inUse += conn->memoryInUse();
+	}
+
+	// forceClose() ends in untrack(), close after the iteration
+	for (size_t i = 0; i < overBudget.size(); ++i)
+	{
+		LOG_WARN << "MemoryReclaimer: connection " << overBudget[i]->name() << " holds " << overBudget[i]->memoryReserved()
+				 << " bytes, over the budget of " << budgetBytes_ << ", force close";
+		++state->budgetDisconnects;
+		overBudget[i]->forceClose();
+	}
+
+	state->connectionCount = static_cast<int64_t>(state->connections.size());
+	state->bytesReserved = reserved;
+	state->bytesInUse = inUse;
+}
+
+const std::string MemoryReclaimer::info() const
+{
+	std::stringstream ss;
+	int64_t reserved = 0;
+	int64_t inUse = 0;
+	for (size_t i = 0; i < loops_.size(); ++i)
+	{
+		const LoopState* state = loops_[i].get();
+		ss << "loop " << i << ": connections: " << state->connectionCount
+		   << ", bytes reserved: " << state->bytesReserved
+		   << ", bytes in use: " << state->bytesInUse
+		   << ", bytes reclaimed: " << state->bytesReclaimed
+		   << ", idle reclaims: " << state->idleReclaims
+		   << ", budget reclaims: " << state->budgetReclaims
+		   << ", budget disconnects: " << state->budgetDisconnects << "\n";
+		reserved += state->bytesReserved;
+		inUse += state->bytesInUse;
+	}
+	ss << "total bytes reserved: " << reserved << ", bytes in use: " << inUse
+	   << ", idle after " << idleSeconds_ << "s, budget " << budgetBytes_ << " bytes"
+	   << (disconnectOverBudget_ ? " (disconnect)" : "") << "\n";
+	return ss.str();
+}
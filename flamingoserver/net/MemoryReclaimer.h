@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Callbacks.h"
+
+namespace net
+{
+
+	class EventLoop;
+
+	///
+	/// Gives the buffer memory of idle connections back to the BufferPool
+	/// and keeps connections within a memory budget.
+	///
+	/// Every loop sweeps its own connections once per kSweepInterval:
+	/// - a connection that read nothing for idleSeconds has its input buffer
+	///   shrunk to what it holds (freed when empty) and its empty output
+	///   queue freed
+	/// - a connection holding more than budgetBytes is shrunk the same way
+	///   at once, and closed if disconnectOverBudget and still over budget
+	///
+	/// The sweep also sums up the bytes reserved and in use per loop for info().
+	/// TcpServer shares one instance among its loops.
+	class MemoryReclaimer
+	{
+	public:
+		static const double kSweepInterval;
+
+		/// idleSeconds or budgetBytes of 0 disables that part
+		MemoryReclaimer(double idleSeconds, size_t budgetBytes, bool disconnectOverBudget);
+		~MemoryReclaimer();
+
+		MemoryReclaimer(const MemoryReclaimer& rhs) = delete;
+		MemoryReclaimer& operator=(const MemoryReclaimer& rhs) = delete;
+
+		/// starts sweeping loop, all loops must be added before the first track()
+		void addLoop(EventLoop* loop);
+
+		/// in the loop of conn
+		void track(const TcpConnectionPtr& conn);
+		void untrack(const TcpConnectionPtr& conn);
+
+		/// thread safe
+		const std::string info() const;
+
+	private:
+		struct LoopState
+		{
+			EventLoop*                                                  loop;
+			std::unordered_map<TcpConnection*, std::weak_ptr<TcpConnection> > connections;
+
+			// results of the last sweep
+			std::atomic<int64_t>                                        connectionCount;
+			std::atomic<int64_t>                                        bytesReserved;
+			std::atomic<int64_t>                                        bytesInUse;
+			// since start
+			std::atomic<int64_t>                                        bytesReclaimed;
+			std::atomic<int64_t>                                        idleReclaims;
+			std::atomic<int64_t>                                        budgetReclaims;
+			std::atomic<int64_t>                                        budgetDisconnects;
+		};
+
+		LoopState* stateOf(EventLoop* loop) const;
+		void sweep(LoopState* state);
+
+	private:
+		const double                                idleSeconds_;
+		const size_t                                budgetBytes_;
+		const bool                                  disconnectOverBudget_;
+		std::vector<std::unique_ptr<LoopState> >    loops_;
+	};
+
+}
@@ -0,0 +1,182 @@
+#include "OutputQueue.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "Sockets.h"
+
+using namespace net;
+
+const size_t OutputQueue::kChunkSize;
+const int OutputQueue::kMaxIovec;
+
+FileRegion::~FileRegion()
+{
+	::close(fd);
+}
+
+void OutputQueue::append(const void* data, size_t len)
+{
+	if (len == 0)
+		return;
+
+	// the tail chunk never grows past the capacity it was created with,
+	// so the bytes already in it are not reallocated.
+	if (!tail_ || tail_->capacity() - tail_->size() < len)
+	{
+		tail_ = std::make_shared<std::string>();
+		tail_->reserve(len > kChunkSize ? len : kChunkSize);
+		pushBack(tail_, FileRegionPtr(), 0);
+	}
+	tail_->append(static_cast<const char*>(data), len);
+	bytes_ += len;
+}
+
+void OutputQueue::append(const SharedBuffer& buf, size_t offset)
+{
+	if (!buf || offset >= buf->size())
+		return;
+
+	tail_.reset();
+	pushBack(buf, FileRegionPtr(), offset);
+	bytes_ += buf->size() - offset;
+}
+
+void OutputQueue::append(const FileRegionPtr& file, size_t offset)
+{
+	if (!file || offset >= file->length)
+		return;
+
+	// what is appended later must go after the file
+	tail_.reset();
+	pushBack(SharedBuffer(), file, offset);
+	bytes_ += file->length - offset;
+	fileBytes_ += file->length - offset;
+}
+
+int OutputQueue::peek(struct iovec* iov, int maxIov) const
+{
+	int n = 0;
+	for (std::vector<Slice>::const_iterator it = slices_.begin() + head_; it != slices_.end() && n < maxIov && it->buf; ++it, ++n)
+	{
+		iov[n].iov_base = const_cast<char*>(it->buf->data()) + it->offset;
+		iov[n].iov_len = it->buf->size() - it->offset;
+	}
+	return n;
+}
+
+int OutputQueue::peek(struct iovec* iov, int maxIov, std::vector<SharedBuffer>* holds) const
+{
+	int n = peek(iov, maxIov);
+	for (int i = 0; i < n; ++i)
+		holds->push_back(slices_[head_ + i].buf);
+	return n;
+}
+
+void OutputQueue::retrieve(size_t len)
+{
+	if (len >= bytes_)
+	{
+		retrieveAll();
+		return;
+	}
+
+	bytes_ -= len;
+	while (len > 0)
+	{
+		Slice& front = slices_[head_];
+		size_t sliceLen = front.size() - front.offset;
+		if (len < sliceLen)
+		{
+			front.offset += len;
+			if (front.file)
+				fileBytes_ -= len;
+			break;
+		}
+
+		len -= sliceLen;
+		if (front.file)
+			fileBytes_ -= sliceLen;
+		if (front.buf == tail_)
+			tail_.reset();
+		front.buf.reset();
+		front.file.reset();
+		++head_;
+	}
+}
+
+void OutputQueue::retrieveAll()
+{
+	slices_.clear();
+	head_ = 0;
+	tail_.reset();
+	bytes_ = 0;
+	fileBytes_ = 0;
+}
+
+void OutputQueue::pushBack(const SharedBuffer& buf, const FileRegionPtr& file, size_t offset)
+{
+	// reuse the room of retrieved slices instead of growing
+	if (head_ > 0 && slices_.size() == slices_.capacity())
+	{
+		slices_.erase(slices_.begin(), slices_.begin() + head_);
+		head_ = 0;
+	}
+	Slice slice = { buf, file, offset };
+	slices_.push_back(slice);
+}
+
+size_t OutputQueue::reservedBytes() const
+{
+	// file bytes stay in the page cache
+	size_t bytes = bytes_ - fileBytes_ + slices_.capacity() * sizeof(Slice);
+	if (tail_)
+		bytes += tail_->capacity() - tail_->size();
+	return bytes;
+}
+
+void OutputQueue::shrink()
+{
+	if (empty())
+		std::vector<Slice>().swap(slices_);
+}
+
+ssize_t OutputQueue::writeFd(int fd, int* savedErrno)
+{
+	if (!empty() && slices_[head_].file)
+	{
+		const Slice& front = slices_[head_];
+		int64_t offset = front.file->offset + static_cast<int64_t>(front.offset);
+		ssize_t n = sockets::sendfile(fd, front.file->fd, &offset, front.file->length - front.offset);
+		if (n < 0)
+		{
+			*savedErrno = errno;
+		}
+		else if (n == 0)
+		{
+			// the file was truncated, the region can never be completed
+			*savedErrno = EIO;
+			n = -1;
+		}
+		else
+		{
+			retrieve(static_cast<size_t>(n));
+		}
+		return n;
+	}
+
+	struct iovec vec[kMaxIovec];
+	int iovcnt = peek(vec, kMaxIovec);
+	ssize_t n = sockets::writev(fd, vec, iovcnt);
+	if (n < 0)
+	{
+		*savedErrno = errno;
+	}
+	else
+	{
+		retrieve(static_cast<size_t>(n));
+	}
+	return n;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <sys/types.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct iovec;
+
+namespace net
+{
+
+	/// An immutable, refcounted frame. Built once, it can be queued on
+	/// any number of connections and is freed after the last one wrote it.
+	typedef std::shared_ptr<const std::string> SharedBuffer;
+
+	/// [offset, offset + length) of a file, written with sendfile(2) from
+	/// the page cache. Owns fd, closed when the last reference goes.
+	struct FileRegion
+	{
+		FileRegion(int fdArg, int64_t offsetArg, size_t lengthArg)
+			: fd(fdArg), offset(offsetArg), length(lengthArg) { }
+		~FileRegion();
+
+		FileRegion(const FileRegion& rhs) = delete;
+		FileRegion& operator=(const FileRegion& rhs) = delete;
+
+		const int       fd;
+		const int64_t   offset;
+		const size_t    length;
+	};
+	typedef std::shared_ptr<const FileRegion> FileRegionPtr;
+
+	///
+	/// Output side of TcpConnection, a queue of slices of SharedBuffers.
+	///
+	/// Queued bytes are never moved or copied again, growing the queue
+	/// does not reallocate what is already in it. Small copied writes are
+	/// packed into a private tail chunk so that chatty senders do not
+	/// produce one slice per call. A file region is a slice too, it goes
+	/// out with sendfile(2) in its place in the queue.
+	///
+	/// Not thread safe, used in the loop of its connection only.
+	class OutputQueue
+	{
+	public:
+		static const size_t kChunkSize = 4096;
+		static const int    kMaxIovec = 64;
+
+		OutputQueue() : head_(0), bytes_(0), fileBytes_(0) { }
+
+		OutputQueue(const OutputQueue& rhs) = delete;
+		OutputQueue& operator=(const OutputQueue& rhs) = delete;
+
+		size_t readableBytes() const { return bytes_; }
+		/// readableBytes() without the file regions, what the queue buffers in memory
+		size_t memoryBytes() const { return bytes_ - fileBytes_; }
+		bool empty() const { return bytes_ == 0; }
+
+		/// copies [data, data + len)
+		void append(const void* data, size_t len);
+		/// queues buf from offset on without copying
+		void append(const SharedBuffer& buf, size_t offset = 0);
+		/// queues file from offset on, file bytes count in readableBytes()
+		void append(const FileRegionPtr& file, size_t offset = 0);
+
+		/// fills at most maxIov iovecs from the front up to the first file
+		/// region, returns the count
+		int peek(struct iovec* iov, int maxIov) const;
+		/// same, and appends the frames the iovecs point into to holds,
+		/// which keeps them alive while the kernel still reads them
+		int peek(struct iovec* iov, int maxIov, std::vector<SharedBuffer>* holds) const;
+		/// true if a file region is at the front, peek() returns 0 then
+		bool frontIsFile() const { return !empty() && slices_[head_].file; }
+		void retrieve(size_t len);
+		void retrieveAll();
+
+		/// writev() as much as the socket takes, or sendfile() when a file
+		/// region is at the front, the written part is retrieved.
+		/// returns what writev() or sendfile() returns, -1 with EIO if the
+		/// file is shorter than its region.
+		ssize_t writeFd(int fd, int* savedErrno);
+
+		/// bytes held for the queue, including queued frames and the unused
+		/// part of the tail chunk
+		size_t reservedBytes() const;
+		/// frees the slice array when the queue is empty
+		void shrink();
+
+	private:
+		// buf or file is set
+		struct Slice
+		{
+			SharedBuffer    buf;
+			FileRegionPtr   file;
+			size_t          offset;
+
+			size_t size() const { return buf ? buf->size() : file->length; }
+		};
+
+		void pushBack(const SharedBuffer& buf, const FileRegionPtr& file, size_t offset);
+
+		// slices_[head_] is the front, a vector so that an empty queue can
+		// give all its memory back
+		std::vector<Slice>              slices_;
+		size_t                          head_;
+		// slices_.back().buf when it is a chunk created by append(data, len)
+		std::shared_ptr<std::string>    tail_;
+		size_t                          bytes_;
+		// part of bytes_ in file regions
+		size_t                          fileBytes_;
+	};
+
+}
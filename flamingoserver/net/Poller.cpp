@@ -0,0 +1,64 @@
+#include "Poller.h"
+
+#include <atomic>
+
+#include "../base/Logging.h"
+#include "EventLoop.h"
+#include "EpollPoller.h"
+#include "IoUringPoller.h"
+
+using namespace net;
+
+namespace
+{
+	std::atomic<int> g_defaultType(Poller::kEPoll);
+}
+
+Poller::Poller(EventLoop* loop)
+: ownerLoop_(loop)
+{
+}
+
+Poller::~Poller()
+{
+}
+
+void Poller::assertInLoopThread() const
+{
+	ownerLoop_->assertInLoopThread();
+}
+
+void Poller::submitSend(Channel* channel, const OutputQueue& output)
+{
+	LOG_FATAL << name() << " poller has no completion based I/O";
+}
+
+void Poller::pollWritable(Channel* channel)
+{
+	LOG_FATAL << name() << " poller has no completion based I/O";
+}
+
+void Poller::recycleBuffer(int bufferId)
+{
+	LOG_FATAL << name() << " poller has no completion based I/O";
+}
+
+void Poller::setDefaultType(Type type)
+{
+	g_defaultType = type;
+}
+
+Poller* Poller::newDefaultPoller(EventLoop* loop)
+{
+	int type = g_defaultType;
+	if (type == kIoUring || type == kIoUringPoll)
+	{
+		IoUringPoller* poller = new IoUringPoller(loop, type == kIoUring);
+		if (poller->valid())
+			return poller;
+
+		LOG_ERROR << "io_uring is not available, falling back to epoll";
+		delete poller;
+	}
+	return new EPollPoller(loop);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+#include "../base/Timestamp.h"
+
+namespace net
+{
+
+	class Channel;
+	class EventLoop;
+	class OutputQueue;
+
+	///
+	/// Base class for IO Multiplexing
+	///
+	/// This class doesn't own the Channel objects.
+	class Poller
+	{
+	public:
+		typedef std::vector<Channel*> ChannelList;
+
+		enum Type
+		{
+			kEPoll,
+			kIoUring,       // completion based where the kernel can, see IoUringPoller
+			kIoUringPoll,   // io_uring poll requests only, readiness like epoll
+		};
+
+		Poller(EventLoop* loop);
+		virtual ~Poller();
+
+		/// Polls the I/O events.
+		/// Must be called in the loop thread.
+		virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels) = 0;
+
+		/// Changes the interested I/O events.
+		/// Must be called in the loop thread.
+		virtual bool updateChannel(Channel* channel) = 0;
+
+		/// Remove the channel, when it destructs.
+		/// Must be called in the loop thread.
+		virtual void removeChannel(Channel* channel) = 0;
+
+		virtual bool hasChannel(Channel* channel) const = 0;
+
+		/// Edge-triggered registration of the channels that ask for it,
+		/// see Channel::setEdgeTriggered.
+		virtual void setEdgeTriggered(bool on) = 0;
+		virtual bool edgeTriggered() const = 0;
+
+		virtual const char* name() const = 0;
+
+		/// Completion based I/O, see Channel::IoMode. Only the io_uring
+		/// poller has it, the other calls below are only valid then.
+		virtual bool completionIo() const { return false; }
+		/// Queues a sendmsg of the front of output, it goes to the kernel
+		/// with the next poll() and completes with Channel::kSent. The
+		/// poller keeps the queued frames alive until then, one send in
+		/// flight per channel.
+		virtual void submitSend(Channel* channel, const OutputQueue& output);
+		/// Queues a oneshot wait for POLLOUT, completes with Channel::kWritable.
+		virtual void pollWritable(Channel* channel);
+		/// Gives back the receive buffer of a Channel::kReceived completion.
+		virtual void recycleBuffer(int bufferId);
+
+		/// Type of the pollers of loops constructed from now on, kEPoll by
+		/// default. Loops fall back to epoll if io_uring is not available.
+		static void setDefaultType(Type type);
+		static Poller* newDefaultPoller(EventLoop* loop);
+
+		void assertInLoopThread() const;
+
+	protected:
+		EventLoop* ownerLoop_;
+
+	private:
+		Poller(const Poller& rhs) = delete;
+		Poller& operator=(const Poller& rhs) = delete;
+	};
+
+}
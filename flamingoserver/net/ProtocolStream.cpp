@@ -147,6 +147,15 @@ namespace net
         cur += outlen;
         return true;
     }
+    bool BinaryReadStream::ReadString(StringPiece* str, size_t maxlen, size_t& outlen)
+    {
+        const char* field;
+        if (!ReadCCString(&field, maxlen, outlen))
+            return false;
+
+        str->set(field, outlen);
+        return true;
+    }
     bool BinaryReadStream::ReadCCString(const char** str, size_t maxlen, size_t& outlen)
     {
         size_t headlen;
@@ -287,7 +296,8 @@ namespace net
 
     //=================class BinaryWriteStream implementation============//
     BinaryWriteStream::BinaryWriteStream(string *data) :
-        m_data(data)
+        m_data(data),
+        m_externalLength(0)
     {
         m_data->clear();
         char str[BINARY_PACKLEN_LEN_2 + CHECKSUM_LEN];
@@ -311,6 +321,19 @@ namespace net
     {
         return WriteCString(str.c_str(), str.length());
     }
+    bool BinaryWriteStream::WriteString(const StringPiece& str)
+    {
+        return WriteCString(str.data(), str.size());
+    }
+    bool BinaryWriteStream::WriteStringHeader(size_t len)
+    {
+        char buf[5];
+        size_t buflen;
+        compress_(len, buf, buflen);
+        m_data->append(buf, sizeof(char)*buflen);
+        m_externalLength += len;
+        return true;
+    }
     const char* BinaryWriteStream::GetData() const
     {
         return m_data->data();
@@ -374,12 +397,13 @@ namespace net
     void BinaryWriteStream::Flush()
     {
         char *ptr = &(*m_data)[0];
-        unsigned int ulen = htonl(m_data->length());
+        unsigned int ulen = htonl(m_data->length() + m_externalLength);
         memcpy(ptr, &ulen, sizeof(ulen));
     }
     void BinaryWriteStream::Clear()
     {
         m_data->clear();
+        m_externalLength = 0;
         char str[BINARY_PACKLEN_LEN_2 + CHECKSUM_LEN];
         m_data->append(str, sizeof(str));
     }
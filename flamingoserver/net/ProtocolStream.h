@@ -11,6 +11,7 @@
 #include <string>
 #include <sstream>
 #include <stdint.h>
+#include "../base/StringPiece.h"
 
 using namespace std;
 
@@ -68,6 +69,8 @@ namespace net
         virtual size_t GetSize() const;
         bool IsEmpty() const;
         bool ReadString(string* str, size_t maxlen, size_t& outlen);
+        //strָʱݣֻǿЧڼ
+        bool ReadString(StringPiece* str, size_t maxlen, size_t& outlen);
         bool ReadCString(char* str, size_t strlen, size_t& len);
         bool ReadCCString(const char** str, size_t maxlen, size_t& outlen);
         bool ReadInt32(int32_t& i);
@@ -91,6 +94,10 @@ namespace net
         virtual size_t GetSize() const;
         bool WriteCString(const char* str, size_t len);
         bool WriteString(const string& str);
+        bool WriteString(const StringPiece& str);
+        //ֻдַĳǰ׺lenֽڵݲm_dataɵ÷űз(sendfile)
+        //ԱһֶΣFlushдİ
+        bool WriteStringHeader(size_t len);
         bool WriteDouble(double value, bool isNULL = false);
         bool WriteInt64(int64_t value, bool isNULL = false);
         bool WriteInt32(int32_t i, bool isNULL = false);
@@ -101,6 +108,7 @@ namespace net
         void Clear();
     private:
         string* m_data;
+        size_t  m_externalLength;
     };
 
 }// end namespace
@@ -0,0 +1,273 @@
+#include "RpcClient.h"
+
+#include <limits.h>
+#include <stdio.h>  // snprintf
+#include <string.h>
+#include <sstream>
+
+#include "../base/Logging.h"
+#include "EventLoop.h"
+#include "ProtocolStream.h"
+#include "TcpClient.h"
+
+using namespace net;
+
+void rpc::encode(int32_t cmd, int32_t seq, const std::string& payload, std::string* frame)
+{
+	std::string body;
+	BinaryWriteStream writeStream(&body);
+	writeStream.WriteInt32(cmd);
+	writeStream.WriteInt32(seq);
+	writeStream.WriteString(payload);
+	writeStream.Flush();
+
+	Header header;
+	memset(&header, 0, sizeof header);
+	header.originsize = static_cast<int32_t>(body.size());
+
+	frame->clear();
+	frame->reserve(sizeof header + body.size());
+	frame->append(reinterpret_cast<const char*>(&header), sizeof header);
+	frame->append(body);
+}
+
+rpc::DecodeResult rpc::decode(Buffer* buf, int32_t* cmd, int32_t* seq, std::string* payload)
+{
+	if (buf->readableBytes() < sizeof(Header))
+		return kIncomplete;
+
+	Header header;
+	memcpy(&header, buf->peek(), sizeof header);
+	if (header.compressflag != 0 || header.originsize <= 0 || header.originsize > kMaxFrameSize)
+		return kInvalid;
+	if (buf->readableBytes() < sizeof header + static_cast<size_t>(header.originsize))
+		return kIncomplete;
+
+	BinaryReadStream readStream(buf->peek() + sizeof header, static_cast<size_t>(header.originsize));
+	size_t payloadLength;
+	bool ok = readStream.ReadInt32(*cmd) && readStream.ReadInt32(*seq) && readStream.ReadString(payload, 0, payloadLength);
+	buf->retrieve(sizeof header + static_cast<size_t>(header.originsize));
+	return ok ? kFrame : kInvalid;
+}
+
+RpcClient::RpcClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name, int poolSize)
+	: loop_(CHECK_NOTNULL(loop)),
+	serverAddr_(serverAddr),
+	name_(name),
+	pool_(poolSize > 0 ? poolSize : 1),
+	nextSeq_(1),
+	connected_(0),
+	calls_(0),
+	succeeded_(0),
+	timeouts_(0),
+	failures_(0),
+	inFlight_(0)
+{
+	for (size_t i = 0; i < pool_.size(); ++i)
+	{
+		char buf[32];
+		snprintf(buf, sizeof buf, "#%zu", i);
+		PooledConnection& pooled = pool_[i];
+		pooled.client.reset(new TcpClient(loop, serverAddr, name_ + buf));
+		pooled.client->enableRetry();
+		pooled.client->setConnectionCallback(std::bind(&RpcClient::onConnection, this, i, std::placeholders::_1));
+		pooled.client->setMessageCallback(std::bind(&RpcClient::onMessage, this, std::placeholders::_1, std::placeholders::_2));
+		pooled.inFlight = 0;
+	}
+}
+
+RpcClient::~RpcClient()
+{
+	loop_->assertInLoopThread();
+	for (const auto& call : pending_)
+		loop_->cancel(call.second.timer);
+	pending_.clear();
+
+	// the connections may outlive this, TcpClient closes them once nobody else holds them
+	for (auto& pooled : pool_)
+	{
+		if (pooled.conn)
+		{
+			pooled.conn->setConnectionCallback(defaultConnectionCallback);
+			pooled.conn->setMessageCallback(defaultMessageCallback);
+			pooled.conn.reset();
+		}
+	}
+}
+
+void RpcClient::start()
+{
+	LOG_INFO << "RpcClient[" << name_ << "] - " << pool_.size() << " connections to " << serverAddr_.toIpPort();
+	for (auto& pooled : pool_)
+		pooled.client->connect();
+}
+
+void RpcClient::stop()
+{
+	loop_->assertInLoopThread();
+	for (size_t i = 0; i < pool_.size(); ++i)
+	{
+		pool_[i].client->stop();
+		pool_[i].client->disconnect();
+		failConnection(i);
+	}
+}
+
+void RpcClient::call(int32_t cmd, const std::string& request, double timeoutSeconds, const ResponseCallback& cb)
+{
+	loop_->runInLoop(std::bind(&RpcClient::callInLoop, this, cmd, request, timeoutSeconds, cb));
+}
+
+void RpcClient::callInLoop(int32_t cmd, const std::string& request, double timeoutSeconds, const ResponseCallback& cb)
+{
+	loop_->assertInLoopThread();
+	++calls_;
+
+	// the connection with the fewest calls in flight
+	size_t index = pool_.size();
+	for (size_t i = 0; i < pool_.size(); ++i)
+	{
+		if (pool_[i].conn && (index == pool_.size() || pool_[i].inFlight < pool_[index].inFlight))
+			index = i;
+	}
+	if (index == pool_.size())
+	{
+		++failures_;
+		cb(kUnavailable, std::string());
+		return;
+	}
+
+	int32_t seq = nextSeq_;
+	nextSeq_ = nextSeq_ == INT_MAX ? 1 : nextSeq_ + 1;
+	std::string frame;
+	rpc::encode(cmd, seq, request, &frame);
+
+	PendingCall& call = pending_[seq];
+	call.callback = cb;
+	call.connIndex = index;
+	call.timer = loop_->runAfter(timeoutSeconds, std::bind(&RpcClient::onTimeout, this, seq));
+	++pool_[index].inFlight;
+	++inFlight_;
+	pool_[index].conn->send(std::move(frame));
+}
+
+void RpcClient::onConnection(size_t index, const TcpConnectionPtr& conn)
+{
+	PooledConnection& pooled = pool_[index];
+	if (conn->connected())
+	{
+		conn->setTcpNoDelay(true);
+		pooled.conn = conn;
+		++connected_;
+		LOG_INFO << "RpcClient[" << name_ << "] - " << conn->name() << " up";
+	}
+	else if (pooled.conn == conn)
+	{
+		pooled.conn.reset();
+		--connected_;
+		failConnection(index);
+		// TcpClient reconnects, Connector backs off while the peer is down
+		LOG_WARN << "RpcClient[" << name_ << "] - " << conn->name() << " down, reconnecting";
+	}
+	else
+	{
+		return;
+	}
+
+	if (poolStateCallback_)
+		poolStateCallback_(connected_);
+}
+
+void RpcClient::onMessage(const TcpConnectionPtr& conn, Buffer* buf)
+{
+	int32_t cmd;
+	int32_t seq;
+	std::string payload;
+	rpc::DecodeResult result;
+	while ((result = rpc::decode(buf, &cmd, &seq, &payload)) == rpc::kFrame)
+	{
+		std::map<int32_t, PendingCall>::iterator it = pending_.find(seq);
+		// late responses of timed out calls
+		if (it != pending_.end())
+			complete(it, kOk, payload);
+	}
+
+	if (result == rpc::kInvalid)
+	{
+		LOG_ERROR << "RpcClient[" << name_ << "] - invalid frame from " << conn->name() << ", closing";
+		conn->forceClose();
+	}
+}
+
+void RpcClient::onTimeout(int32_t seq)
+{
+	std::map<int32_t, PendingCall>::iterator it = pending_.find(seq);
+	if (it != pending_.end())
+		complete(it, kTimeout, std::string());
+}
+
+void RpcClient::complete(std::map<int32_t, PendingCall>::iterator it, Status status, const std::string& response)
+{
+	PendingCall call = it->second;
+	pending_.erase(it);
+	// a timer that fired is already gone
+	if (status != kTimeout)
+		loop_->cancel(call.timer);
+	--pool_[call.connIndex].inFlight;
+	--inFlight_;
+
+	if (status == kOk)
+		++succeeded_;
+	else if (status == kTimeout)
+		++timeouts_;
+	else
+		++failures_;
+	call.callback(status, response);
+}
+
+void RpcClient::failConnection(size_t index)
+{
+	std::vector<int32_t> seqs;
+	for (const auto& call : pending_)
+	{
+		if (call.second.connIndex == index)
+			seqs.push_back(call.first);
+	}
+	for (size_t i = 0; i < seqs.size(); ++i)
+	{
+		// a callback may have completed others
+		std::map<int32_t, PendingCall>::iterator it = pending_.find(seqs[i]);
+		if (it != pending_.end())
+			complete(it, kConnectionLost, std::string());
+	}
+	pool_[index].inFlight = 0;
+}
+
+const char* RpcClient::statusName(Status status)
+{
+	switch (status)
+	{
+	case kOk:
+		return "ok";
+	case kTimeout:
+		return "timeout";
+	case kConnectionLost:
+		return "connection lost";
+	case kUnavailable:
+		return "unavailable";
+	}
+	return "unknown";
+}
+
+std::string RpcClient::info() const
+{
+	std::stringstream ss;
+	ss << "rpc client " << name_ << " to " << serverAddr_.toIpPort()
+	   << ": connections up: " << connected_ << "/" << pool_.size()
+	   << ", calls: " << calls_
+	   << ", ok: " << succeeded_
+	   << ", timeouts: " << timeouts_
+	   << ", failures: " << failures_
+	   << ", in flight: " << inFlight_ << "\n";
+	return ss.str();
+}
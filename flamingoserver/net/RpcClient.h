@@ -0,0 +1,148 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "InetAddress.h"
+#include "TimerId.h"
+#include "TcpConnection.h"
+
+namespace net
+{
+
+	class EventLoop;
+	class TcpClient;
+
+	///
+	/// Frames of the internal RPC protocol.
+	///
+	/// The chat protocol's msg header followed by a BinaryWriteStream of
+	/// cmd, seq and the payload, so a peer decodes them the way it decodes
+	/// client packets. Internal traffic is never compressed.
+	namespace rpc
+	{
+
+#pragma pack(push, 1)
+		/// same layout as msg of chatserversrc/Msg.h
+		struct Header
+		{
+			char     compressflag;
+			int32_t  originsize;
+			int32_t  compresssize;
+			char     reserved[16];
+		};
+#pragma pack(pop)
+
+		static const int32_t kMaxFrameSize = 10 * 1024 * 1024;
+
+		enum DecodeResult
+		{
+			kIncomplete,
+			kFrame,
+			kInvalid,
+		};
+
+		void encode(int32_t cmd, int32_t seq, const std::string& payload, std::string* frame);
+		/// takes one frame off buf, kInvalid means the connection must be closed
+		DecodeResult decode(Buffer* buf, int32_t* cmd, int32_t* seq, std::string* payload);
+
+	}
+
+	///
+	/// Client of one RPC peer over a pool of connections.
+	///
+	/// Calls are pipelined: each goes out on the connected connection with
+	/// the fewest calls in flight, and the response is matched by seq.
+	/// Every call has its own timeout on the loop's timer queue. A lost
+	/// connection fails its calls and reconnects with exponential backoff.
+	///
+	/// All connections and callbacks live in one loop, the client must be
+	/// destroyed in it.
+	class RpcClient
+	{
+	public:
+		enum Status
+		{
+			kOk,
+			kTimeout,
+			kConnectionLost,    // the connection closed before the response
+			kUnavailable,       // no connection is up
+		};
+
+		typedef std::function<void(Status status, const std::string& response)> ResponseCallback;
+		/// number of connections up
+		typedef std::function<void(int connected)> PoolStateCallback;
+
+		RpcClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name, int poolSize);
+		~RpcClient();
+
+		RpcClient(const RpcClient& rhs) = delete;
+		RpcClient& operator=(const RpcClient& rhs) = delete;
+
+		/// runs in loop whenever a connection goes up or down
+		/// Must be called before @c start
+		void setPoolStateCallback(const PoolStateCallback& cb)
+		{ poolStateCallback_ = cb; }
+
+		void start();
+		/// fails calls in flight with kConnectionLost, must be called in loop
+		void stop();
+
+		/// cb runs in loop with the response payload, called in loop it may
+		/// run before call() returns. Thread safe.
+		void call(int32_t cmd, const std::string& request, double timeoutSeconds, const ResponseCallback& cb);
+
+		static const char* statusName(Status status);
+
+		/// pool and call counters, thread safe
+		std::string info() const;
+
+		EventLoop* getLoop() const { return loop_; }
+
+	private:
+		struct PendingCall
+		{
+			ResponseCallback    callback;
+			TimerId             timer;
+			size_t              connIndex;
+		};
+
+		struct PooledConnection
+		{
+			std::unique_ptr<TcpClient>  client;
+			TcpConnectionPtr            conn;       // set while connected
+			int                         inFlight;
+		};
+
+		void callInLoop(int32_t cmd, const std::string& request, double timeoutSeconds, const ResponseCallback& cb);
+		void onConnection(size_t index, const TcpConnectionPtr& conn);
+		void onMessage(const TcpConnectionPtr& conn, Buffer* buf);
+		void onTimeout(int32_t seq);
+		/// removes the call and runs its callback
+		void complete(std::map<int32_t, PendingCall>::iterator it, Status status, const std::string& response);
+		void failConnection(size_t index);
+
+	private:
+		EventLoop*                          loop_;
+		const InetAddress                   serverAddr_;
+		const std::string                   name_;
+		std::vector<PooledConnection>       pool_;
+		std::map<int32_t, PendingCall>      pending_;
+		int32_t                             nextSeq_;
+		PoolStateCallback                   poolStateCallback_;
+
+		// written in loop, read by info()
+		std::atomic<int>                    connected_;
+		std::atomic<int64_t>                calls_;
+		std::atomic<int64_t>                succeeded_;
+		std::atomic<int64_t>                timeouts_;
+		std::atomic<int64_t>                failures_;
+		std::atomic<int64_t>                inFlight_;
+	};
+
+}
@@ -2,6 +2,7 @@
 
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <linux/filter.h>
 #include <strings.h>  // bzero
 #include <stdio.h>  // snprintf
 
@@ -9,6 +10,7 @@
 #include <fcntl.h>
 #include <stdio.h>  // snprintf
 #include <strings.h>  // bzero
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <unistd.h>
 //for ubuntu readv not found
@@ -112,6 +114,32 @@ void Socket::setReusePort(bool on)
 	}
 }
 
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+bool Socket::attachReusePortCbpf(int groupSize)
+{
+	struct sock_filter code[] = {
+		// A = random
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_RANDOM) },
+		// A = A % groupSize
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(groupSize) },
+		// return A, index of the socket in the group
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+	struct sock_fprog prog;
+	prog.len = static_cast<unsigned short>(sizeof code / sizeof code[0]);
+	prog.filter = code;
+	int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, static_cast<socklen_t>(sizeof prog));
+	if (ret < 0)
+	{
+		LOG_SYSERR << "SO_ATTACH_REUSEPORT_CBPF failed.";
+		return false;
+	}
+	return true;
+}
+
 void Socket::setKeepAlive(bool on)
 {
 	int optval = on ? 1 : 0;
@@ -120,6 +148,12 @@ void Socket::setKeepAlive(bool on)
 	// FIXME CHECK
 }
 
+bool Socket::setBusyPoll(int usec)
+{
+	return ::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL,
+		&usec, static_cast<socklen_t>(sizeof usec)) == 0;
+}
+
 namespace
 {
 
@@ -218,7 +252,9 @@ int sockets::accept(int sockfd, struct sockaddr_in* addr)
 	if (connfd < 0)
 	{
 		int savedErrno = errno;
-		LOG_SYSERR << "Socket::accept";
+		// EAGAIN just ends the accept loop of Acceptor::handleRead
+		if (savedErrno != EAGAIN)
+			LOG_SYSERR << "Socket::accept";
 		switch (savedErrno)
 		{
 		case EAGAIN:
@@ -264,6 +300,89 @@ ssize_t sockets::readv(int sockfd, const struct iovec *iov, int iovcnt)
 	return ::readv(sockfd, iov, iovcnt);
 }
 
+ssize_t sockets::writev(int sockfd, const struct iovec *iov, int iovcnt)
+{
+	return ::writev(sockfd, iov, iovcnt);
+}
+
+ssize_t sockets::sendfile(int sockfd, int infd, int64_t* offset, size_t count)
+{
+	off_t off = static_cast<off_t>(*offset);
+	ssize_t n = ::sendfile(sockfd, infd, &off, count);
+	*offset = static_cast<int64_t>(off);
+	return n;
+}
+
+bool sockets::sendFds(int sockfd, const std::vector<int>& fds, const std::string& data)
+{
+	if (fds.size() > static_cast<size_t>(kMaxPassedFds) || data.empty())
+		return false;
+
+	struct iovec iov;
+	iov.iov_base = const_cast<char*>(data.data());
+	iov.iov_len = data.size();
+
+	std::vector<char> control(CMSG_SPACE(sizeof(int) * kMaxPassedFds));
+	struct msghdr msg;
+	bzero(&msg, sizeof msg);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (!fds.empty())
+	{
+		msg.msg_control = &control[0];
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+		struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+		memcpy(CMSG_DATA(cmsg), &fds[0], sizeof(int) * fds.size());
+	}
+
+	ssize_t n = ::sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+	if (n != static_cast<ssize_t>(data.size()))
+	{
+		LOG_SYSERR << "sockets::sendFds";
+		return false;
+	}
+	return true;
+}
+
+bool sockets::recvFds(int sockfd, std::vector<int>* fds, std::string* data)
+{
+	char buf[65536];
+	struct iovec iov;
+	iov.iov_base = buf;
+	iov.iov_len = sizeof buf;
+
+	std::vector<char> control(CMSG_SPACE(sizeof(int) * kMaxPassedFds));
+	struct msghdr msg;
+	bzero(&msg, sizeof msg);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = &control[0];
+	msg.msg_controllen = control.size();
+
+	ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+	if (n <= 0)
+	{
+		if (n < 0)
+			LOG_SYSERR << "sockets::recvFds";
+		return false;
+	}
+
+	fds->clear();
+	for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		const int* received = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+		fds->insert(fds->end(), received, received + count);
+	}
+	data->assign(buf, static_cast<size_t>(n));
+	return (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) == 0;
+}
+
 ssize_t sockets::write(int sockfd, const void *buf, size_t count)
 {
 	return ::write(sockfd, buf, count);
@@ -277,6 +396,16 @@ void sockets::close(int sockfd)
 	}
 }
 
+void sockets::resetAndClose(int sockfd)
+{
+	// SO_LINGER with zero timeout, close() sends RST and skips TIME_WAIT
+	struct linger lg;
+	lg.l_onoff = 1;
+	lg.l_linger = 0;
+	::setsockopt(sockfd, SOL_SOCKET, SO_LINGER, &lg, static_cast<socklen_t>(sizeof lg));
+	close(sockfd);
+}
+
 void sockets::shutdownWrite(int sockfd)
 {
 	if (::shutdown(sockfd, SHUT_WR) < 0)
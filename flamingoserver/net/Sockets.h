@@ -1,6 +1,8 @@
 #pragma once
 
 #include <arpa/inet.h>
+#include <string>
+#include <vector>
 
 // struct tcp_info is in <netinet/tcp.h>
 struct tcp_info;
@@ -58,11 +60,25 @@ namespace net
 		///
 		void setReusePort(bool on);
 
+		///
+		/// Attach a classic BPF program to the SO_REUSEPORT group of this
+		/// socket, which picks one of the groupSize members at random, so
+		/// new connections spread evenly no matter how the 4-tuples hash.
+		/// return true if success.
+		bool attachReusePortCbpf(int groupSize);
+
 		///
 		/// Enable/disable SO_KEEPALIVE
 		///
 		void setKeepAlive(bool on);
 
+		///
+		/// Set SO_BUSY_POLL, the microseconds a blocking read busy waits on
+		/// the device queue. Raising it above net.core.busy_read needs
+		/// CAP_NET_ADMIN. return true if success.
+		///
+		bool setBusyPoll(int usec);
+
 	private:
 		const int sockfd_;
 	};
@@ -82,9 +98,21 @@ namespace net
 		ssize_t read(int sockfd, void *buf, size_t count);
 		ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
 		ssize_t write(int sockfd, const void *buf, size_t count);
+		ssize_t writev(int sockfd, const struct iovec *iov, int iovcnt);
+		/// count bytes of infd from *offset on, *offset is advanced
+		ssize_t sendfile(int sockfd, int infd, int64_t* offset, size_t count);
 		void close(int sockfd);
+		/// close with RST, for sockets rejected right after accept
+		void resetAndClose(int sockfd);
 		void shutdownWrite(int sockfd);
 
+		/// passes fds with SCM_RIGHTS plus data over a blocking unix
+		/// socket, at most kMaxPassedFds at a time. false on error.
+		static const int kMaxPassedFds = 253;
+		bool sendFds(int sockfd, const std::vector<int>& fds, const std::string& data);
+		/// received fds are close-on-exec. false on error or eof.
+		bool recvFds(int sockfd, std::vector<int>* fds, std::string* data);
+
 		void toIpPort(char* buf, size_t size,
 			const struct sockaddr_in& addr);
 		void toIp(char* buf, size_t size,
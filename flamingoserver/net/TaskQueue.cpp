@@ -0,0 +1,76 @@
+#include "TaskQueue.h"
+
+using namespace net;
+
+const size_t Task::kInlineSize;
+
+namespace
+{
+	size_t roundUpPowerOf2(size_t n)
+	{
+		size_t v = 2;
+		while (v < n)
+			v <<= 1;
+		return v;
+	}
+}
+
+TaskQueue::TaskQueue(size_t capacity)
+: buffer_(new Cell[roundUpPowerOf2(capacity)]),
+mask_(roundUpPowerOf2(capacity) - 1),
+enqueuePos_(0),
+dequeuePos_(0)
+{
+	for (size_t i = 0; i <= mask_; ++i)
+	{
+		buffer_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+bool TaskQueue::push(Task& task)
+{
+	Cell* cell;
+	size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		cell = &buffer_[pos & mask_];
+		size_t seq = cell->sequence.load(std::memory_order_acquire);
+		intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+		if (dif == 0)
+		{
+			// seq_cst, pairs with the load of EventLoop::polling_ after it
+			if (enqueuePos_.compare_exchange_weak(pos, pos + 1))
+				break;
+		}
+		else if (dif < 0)
+		{
+			// full
+			return false;
+		}
+		else
+		{
+			pos = enqueuePos_.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->task = std::move(task);
+	cell->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+bool TaskQueue::pop(Task& task)
+{
+	size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+	Cell* cell = &buffer_[pos & mask_];
+	size_t seq = cell->sequence.load(std::memory_order_acquire);
+	if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0)
+	{
+		// empty, or the producer of this slot has not finished writing it
+		return false;
+	}
+
+	task = std::move(cell->task);
+	cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+	dequeuePos_.store(pos + 1, std::memory_order_relaxed);
+	return true;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace net
+{
+
+	///
+	/// A move-only void() callable with small buffer optimization.
+	///
+	/// Callables up to kInlineSize bytes, e.g. std::bind of a member function
+	/// with a shared_ptr, or a std::function, are stored in place, so queuing
+	/// them costs no heap allocation. Larger ones are moved to the heap.
+	class Task
+	{
+	public:
+		static const size_t kInlineSize = 48;
+
+		Task() : ops_(NULL) { }
+
+		template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+		Task(F&& f)
+			: ops_(NULL)
+		{
+			typedef typename std::decay<F>::type Callable;
+			init<Callable>(std::forward<F>(f), std::integral_constant<bool, fitsInline<Callable>()>());
+		}
+
+		Task(Task&& rhs)
+			: ops_(rhs.ops_)
+		{
+			if (ops_ != NULL)
+			{
+				ops_->move(&storage_, &rhs.storage_);
+				rhs.ops_ = NULL;
+			}
+		}
+
+		Task& operator=(Task&& rhs)
+		{
+			if (this != &rhs)
+			{
+				reset();
+				if (rhs.ops_ != NULL)
+				{
+					rhs.ops_->move(&storage_, &rhs.storage_);
+					ops_ = rhs.ops_;
+					rhs.ops_ = NULL;
+				}
+			}
+			return *this;
+		}
+
+		Task(const Task& rhs) = delete;
+		Task& operator=(const Task& rhs) = delete;
+
+		~Task() { reset(); }
+
+		void operator()() { ops_->invoke(&storage_); }
+
+		explicit operator bool() const { return ops_ != NULL; }
+
+		void reset()
+		{
+			if (ops_ != NULL)
+			{
+				ops_->destroy(&storage_);
+				ops_ = NULL;
+			}
+		}
+
+	private:
+		typedef std::aligned_storage<kInlineSize, alignof(void*)>::type Storage;
+
+		struct Ops
+		{
+			void (*invoke)(void* p);
+			void (*move)(void* dst, void* src);
+			void (*destroy)(void* p);
+		};
+
+		template<typename F>
+		static constexpr bool fitsInline()
+		{
+			return sizeof(F) <= kInlineSize && alignof(F) <= alignof(Storage) && std::is_nothrow_move_constructible<F>::value;
+		}
+
+		template<typename F>
+		struct InlineOps
+		{
+			static void invoke(void* p) { (*static_cast<F*>(p))(); }
+			static void move(void* dst, void* src)
+			{
+				::new (dst) F(std::move(*static_cast<F*>(src)));
+				static_cast<F*>(src)->~F();
+			}
+			static void destroy(void* p) { static_cast<F*>(p)->~F(); }
+			static const Ops* get()
+			{
+				static const Ops ops = { &invoke, &move, &destroy };
+				return &ops;
+			}
+		};
+
+		template<typename F>
+		struct HeapOps
+		{
+			static void invoke(void* p) { (**static_cast<F**>(p))(); }
+			static void move(void* dst, void* src) { *static_cast<F**>(dst) = *static_cast<F**>(src); }
+			static void destroy(void* p) { delete *static_cast<F**>(p); }
+			static const Ops* get()
+			{
+				static const Ops ops = { &invoke, &move, &destroy };
+				return &ops;
+			}
+		};
+
+		template<typename F, typename Arg>
+		void init(Arg&& f, std::true_type)
+		{
+			::new (&storage_) F(std::forward<Arg>(f));
+			ops_ = InlineOps<F>::get();
+		}
+
+		template<typename F, typename Arg>
+		void init(Arg&& f, std::false_type)
+		{
+			*reinterpret_cast<F**>(&storage_) = new F(std::forward<Arg>(f));
+			ops_ = HeapOps<F>::get();
+		}
+
+	private:
+		Storage         storage_;
+		const Ops*      ops_;
+	};
+
+	///
+	/// Bounded lock-free multi-producer/single-consumer queue of Tasks.
+	///
+	/// Dmitry Vyukov's bounded queue: every cell carries a sequence number,
+	/// producers claim a slot with one CAS on enqueuePos_, the consumer
+	/// never writes anything the producers contend on.
+	class TaskQueue
+	{
+	public:
+		/// capacity is rounded up to a power of 2
+		explicit TaskQueue(size_t capacity);
+		~TaskQueue() = default;
+
+		TaskQueue(const TaskQueue& rhs) = delete;
+		TaskQueue& operator=(const TaskQueue& rhs) = delete;
+
+		/// Thread safe. false if the queue is full, task is untouched then.
+		bool push(Task& task);
+		/// Consumer thread only. false if nothing is ready.
+		bool pop(Task& task);
+
+		/// Number of claimed slots, including ones still being written.
+		/// Thread safe. sequentially consistent with push(), which the
+		/// wakeup protocol of EventLoop relies on.
+		size_t size() const
+		{
+			return enqueuePos_.load() - dequeuePos_.load(std::memory_order_relaxed);
+		}
+
+		size_t capacity() const { return mask_ + 1; }
+
+	private:
+		struct Cell
+		{
+			std::atomic<size_t>     sequence;
+			Task                    task;
+		};
+
+		std::unique_ptr<Cell[]>     buffer_;
+		size_t                      mask_;
+		// producers and the consumer write to different cache lines
+		alignas(64) std::atomic<size_t> enqueuePos_;
+		alignas(64) std::atomic<size_t> dequeuePos_;
+	};
+
+}
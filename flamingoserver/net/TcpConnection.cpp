@@ -4,6 +4,8 @@
 #include <thread>
 #include <sstream>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
 #include "../base/Logging.h"
 #include "Sockets.h"
 #include "EventLoop.h"
@@ -38,12 +40,25 @@ TcpConnection::TcpConnection(EventLoop* loop,
     channel_(new Channel(loop, sockfd)),
     localAddr_(localAddr),
     peerAddr_(peerAddr),
-    highWaterMark_(64 * 1024 * 1024)
+    highWaterMark_(64 * 1024 * 1024),
+    lowWaterMark_(0),
+    aboveHighWaterMark_(false),
+    pendingFlushQueued_(false),
+    coalesceWrites_(false),
+    completionIo_(loop->completionIo()),
+    flushScheduled_(false),
+    coalescedSends_(0)
 {
     channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
     channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
     channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
     channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
+    channel_->setEdgeTriggered(loop->edgeTriggered());
+    if (completionIo_)
+    {
+        channel_->setIoMode(Channel::kRecvCompletions);
+        channel_->setCompletionCallback(std::bind(&TcpConnection::handleCompletion, this, std::placeholders::_1, std::placeholders::_2));
+    }
     LOG_DEBUG << "TcpConnection::ctor[" << name_ << "] at " << this << " fd=" << sockfd;
     socket_->setKeepAlive(true);
 }
@@ -69,6 +84,39 @@ string TcpConnection::getTcpInfoString() const
     return buf;
 }
 
+size_t TcpConnection::memoryReserved() const
+{
+    return inputBuffer_.internalCapacity()
+        + outputQueue_.reservedBytes()
+        + drainingSends_.capacity() * sizeof(PendingSend);
+}
+
+size_t TcpConnection::memoryInUse() const
+{
+    return inputBuffer_.readableBytes() + outputQueue_.readableBytes();
+}
+
+size_t TcpConnection::reclaimMemory()
+{
+    loop_->assertInLoopThread();
+    size_t before = memoryReserved();
+    //半个包留在缓冲区里时只缩到刚好装下它
+    if (inputBuffer_.readableBytes() == 0)
+        inputBuffer_.release();
+    else if (inputBuffer_.internalCapacity() > BufferPool::chunkSize(Buffer::kCheapPrepend + inputBuffer_.readableBytes()))
+        inputBuffer_.shrink(0);
+    outputQueue_.shrink();
+    if (drainingSends_.empty())
+        std::vector<PendingSend>().swap(drainingSends_);
+    {
+        std::lock_guard<std::mutex> guard(pendingMutex_);
+        if (pendingSends_.empty())
+            std::vector<PendingSend>().swap(pendingSends_);
+    }
+    size_t after = memoryReserved();
+    return before > after ? before - after : 0;
+}
+
 void TcpConnection::send(const void* data, int len)
 {
     if (state_ == kConnected)
@@ -79,11 +127,8 @@ void TcpConnection::send(const void* data, int len)
         }
         else
         {
-            string message(static_cast<const char*>(data), len);
-            loop_->runInLoop(
-                std::bind(static_cast<void (TcpConnection::*)(const string&)>(&TcpConnection::sendInLoop),
-                this,     // FIXME
-                message));
+            // the only copy, the frame is shared from here to the socket
+            queuePendingSend(std::make_shared<const string>(static_cast<const char*>(data), len));
         }
     }
 }
@@ -98,16 +143,26 @@ void TcpConnection::send(const string& message)
         }
         else
         {
-            loop_->runInLoop(
-                std::bind(static_cast<void (TcpConnection::*)(const string&)>(&TcpConnection::sendInLoop),
-                this,     // FIXME
-                message));
-            //std::forward<string>(message)));
+            queuePendingSend(std::make_shared<const string>(message));
+        }
+    }
+}
+
+void TcpConnection::send(string&& message)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(message);
+        }
+        else
+        {
+            queuePendingSend(std::make_shared<const string>(std::move(message)));
         }
     }
 }
 
-// FIXME efficiency!!!
 void TcpConnection::send(Buffer* buf)
 {
     if (state_ == kConnected)
@@ -119,13 +174,219 @@ void TcpConnection::send(Buffer* buf)
         }
         else
         {
-            loop_->runInLoop(
-                std::bind(static_cast<void (TcpConnection::*)(const string&)>(&TcpConnection::sendInLoop),
-                this,     // FIXME
-                buf->retrieveAllAsString()));
-            //std::forward<string>(message)));
+            queuePendingSend(std::make_shared<const string>(buf->retrieveAllAsString()));
+        }
+    }
+}
+
+void TcpConnection::send(const SharedBuffer& frame)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(frame);
+        }
+        else
+        {
+            queuePendingSend(frame);
+        }
+    }
+}
+
+void TcpConnection::sendFile(int fd, int64_t offset, size_t len)
+{
+    if (state_ != kConnected || len == 0)
+        return;
+
+    //dup出的fd与原fd共享文件偏移，但sendfile带offset参数时不改它
+    int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dupfd < 0)
+    {
+        LOG_SYSERR << "TcpConnection::sendFile dup";
+        return;
+    }
+
+    FileRegionPtr file(new FileRegion(dupfd, offset, len));
+    if (loop_->isInLoopThread())
+    {
+        sendInLoop(file);
+    }
+    else
+    {
+        //和send的数据走同一个队列，保证顺序
+        queuePendingSend(SharedBuffer(), file);
+    }
+}
+
+void TcpConnection::queuePendingSend(const SharedBuffer& frame, const FileRegionPtr& file)
+{
+    bool needFlush = false;
+    {
+        std::lock_guard<std::mutex> guard(pendingMutex_);
+        PendingSend pending = { frame, file };
+        pendingSends_.push_back(pending);
+        if (!pendingFlushQueued_)
+        {
+            pendingFlushQueued_ = true;
+            needFlush = true;
         }
     }
+
+    // one functor per batch, later frames just join pendingSends_
+    if (needFlush)
+        loop_->queueInLoop(std::bind(&TcpConnection::flushPendingSends, shared_from_this()));
+}
+
+void TcpConnection::flushPendingSends()
+{
+    loop_->assertInLoopThread();
+    {
+        std::lock_guard<std::mutex> guard(pendingMutex_);
+        // both vectors keep their capacity, no allocation in steady state
+        drainingSends_.swap(pendingSends_);
+        pendingFlushQueued_ = false;
+    }
+
+    if (state_ == kDisconnected)
+    {
+        LOG_WARN << "disconnected, give up writing";
+        drainingSends_.clear();
+        return;
+    }
+
+    size_t len = 0;
+    for (const auto& pending : drainingSends_)
+    {
+        if (pending.frame)
+            len += pending.frame->size();
+    }
+
+    bool idle = !channel_->isWriting() && outputQueue_.empty();
+    checkHighWaterMark(len);
+    for (const auto& pending : drainingSends_)
+    {
+        if (pending.file)
+            outputQueue_.append(pending.file);
+        else
+            outputQueue_.append(pending.frame);
+    }
+    drainingSends_.clear();
+
+    if (!idle)
+    {
+        // handleWrite or the scheduled flush will get to them
+        return;
+    }
+
+    // the whole batch goes out in one writev
+    writeQueuedOutput("TcpConnection::flushPendingSends");
+}
+
+void TcpConnection::scheduleFlush()
+{
+    if (flushScheduled_)
+        return;
+
+    flushScheduled_ = true;
+    coalescedSends_ = 0;
+    loop_->runAfterIteration(std::bind(&TcpConnection::flushCoalesced, shared_from_this()));
+}
+
+void TcpConnection::flushCoalesced()
+{
+    loop_->assertInLoopThread();
+    flushScheduled_ = false;
+    if (state_ == kDisconnected || channel_->isWriting())
+        return;
+    if (outputQueue_.empty())
+    {
+        if (state_ == kDisconnecting)
+            shutdownInLoop();
+        return;
+    }
+
+    loop_->recordCoalescedFlush(coalescedSends_, outputQueue_.readableBytes());
+    writeQueuedOutput("TcpConnection::flushCoalesced");
+}
+
+void TcpConnection::writeQueuedOutput(const char* caller)
+{
+    if (completionIo_)
+    {
+        submitOutput();
+        return;
+    }
+
+    int savedErrno = 0;
+    if (writeOutput(&savedErrno) < 0 && savedErrno != EWOULDBLOCK)
+    {
+        errno = savedErrno;
+        LOG_SYSERR << caller;
+        if (savedErrno == EPIPE || savedErrno == ECONNRESET)
+            return;
+    }
+    checkLowWaterMark();
+
+    if (outputQueue_.empty())
+    {
+        if (writeCompleteCallback_)
+            loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        //shutdown()在数据发完之前被调用过
+        if (state_ == kDisconnecting)
+            shutdownInLoop();
+    }
+    else
+    {
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::submitOutput()
+{
+    assert(!outputQueue_.empty());
+    if (!outputQueue_.frontIsFile())
+    {
+        channel_->enableWriting();
+        loop_->submitSend(channel_.get(), outputQueue_);
+        return;
+    }
+
+    //文件不走ring，sendfile本来就不拷贝到用户态
+    int savedErrno = 0;
+    ssize_t n = outputQueue_.writeFd(channel_->fd(), &savedErrno);
+    if (n < 0 && savedErrno == EIO)
+    {
+        LOG_ERROR << "TcpConnection::submitOutput file shorter than the region to send, close " << name_;
+        forceClose();
+        return;
+    }
+    if (n < 0 && savedErrno != EWOULDBLOCK)
+    {
+        errno = savedErrno;
+        LOG_SYSERR << "TcpConnection::submitOutput";
+        channel_->disableWriting();
+        return;
+    }
+    checkLowWaterMark();
+
+    if (n < 0)
+    {
+        channel_->enableWriting();
+        loop_->pollWritable(channel_.get());
+    }
+    else if (!outputQueue_.empty())
+    {
+        submitOutput();
+    }
+    else
+    {
+        channel_->disableWriting();
+        if (writeCompleteCallback_)
+            loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        if (state_ == kDisconnecting)
+            shutdownInLoop();
+    }
 }
 
 void TcpConnection::sendInLoop(const string& message)
@@ -136,60 +397,175 @@ void TcpConnection::sendInLoop(const string& message)
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
     loop_->assertInLoopThread();
-    ssize_t nwrote = 0;
-    size_t remaining = len;
-    bool faultError = false;
+    size_t nwrote = 0;
+    if (!writeDirectly(data, len, &nwrote))
+        return;
+
+    if (nwrote < len)
+    {
+        beforeQueueOutput(len - nwrote);
+        outputQueue_.append(static_cast<const char*>(data) + nwrote, len - nwrote);
+    }
+}
+
+void TcpConnection::sendInLoop(const SharedBuffer& frame)
+{
+    loop_->assertInLoopThread();
+    if (!frame)
+        return;
+
+    size_t nwrote = 0;
+    if (!writeDirectly(frame->data(), frame->size(), &nwrote))
+        return;
+
+    if (nwrote < frame->size())
+    {
+        beforeQueueOutput(frame->size() - nwrote);
+        outputQueue_.append(frame, nwrote);
+    }
+}
+
+void TcpConnection::sendInLoop(const FileRegionPtr& file)
+{
+    loop_->assertInLoopThread();
     if (state_ == kDisconnected)
     {
         LOG_WARN << "disconnected, give up writing";
         return;
     }
+
+    size_t nwrote = 0;
+    //输出队列为空时直接sendfile，文件比请求的短时剩下的留给writeOutput报错
+    if ((coalesceWrites_ || completionIo_) && !channel_->isWriting() && outputQueue_.empty())
+    {
+        scheduleFlush();
+    }
+    else if (!channel_->isWriting() && outputQueue_.empty())
+    {
+        int64_t offset = file->offset;
+        ssize_t n = sockets::sendfile(channel_->fd(), file->fd, &offset, file->length);
+        if (n >= 0)
+        {
+            nwrote = static_cast<size_t>(n);
+            if (nwrote == file->length && writeCompleteCallback_)
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        }
+        else if (errno != EWOULDBLOCK)
+        {
+            LOG_SYSERR << "TcpConnection::sendInLoop sendfile";
+            if (errno == EPIPE || errno == ECONNRESET)
+                return;
+        }
+    }
+
+    if (nwrote < file->length)
+    {
+        //文件留在page cache里，不占内存，不算进高水位
+        beforeQueueOutput(0);
+        outputQueue_.append(file, nwrote);
+    }
+}
+
+bool TcpConnection::writeDirectly(const void* data, size_t len, size_t* nwrote)
+{
+    *nwrote = 0;
+    if (state_ == kDisconnected)
+    {
+        LOG_WARN << "disconnected, give up writing";
+        return false;
+    }
     // if no thing in output queue, try writing directly
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    if (!channel_->isWriting() && outputQueue_.empty())
     {
-        nwrote = sockets::write(channel_->fd(), data, len);
+        //合并写模式下先入队，本轮末尾统一写；完成模式下所有连接的send在本轮末尾一起提交
+        if (coalesceWrites_ || completionIo_)
+        {
+            scheduleFlush();
+            return true;
+        }
+
+        ssize_t n = sockets::write(channel_->fd(), data, len);
         //TODO: 打印threadid用于调试，后面去掉
         //std::stringstream ss;
         //ss << std::this_thread::get_id();
         //LOG_INFO << "send data in threadID = " << ss;
         
-        if (nwrote >= 0)
+        if (n >= 0)
         {
-            remaining = len - nwrote;
-            if (remaining == 0 && writeCompleteCallback_)
+            *nwrote = static_cast<size_t>(n);
+            if (*nwrote == len && writeCompleteCallback_)
             {
                 loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
             }
         }
-        else // nwrote < 0
+        else // n < 0
         {
-            nwrote = 0;
             if (errno != EWOULDBLOCK)
             {
                 LOG_SYSERR << "TcpConnection::sendInLoop";
                 if (errno == EPIPE || errno == ECONNRESET) // FIXME: any others?
                 {
-                    faultError = true;
+                    return false;
                 }
             }
         }
     }
 
-    assert(remaining <= len);
-    if (!faultError && remaining > 0)
+    assert(*nwrote <= len);
+    return true;
+}
+
+void TcpConnection::checkHighWaterMark(size_t len)
+{
+    size_t oldLen = outputQueue_.memoryBytes();
+    if (oldLen + len >= highWaterMark_
+        && oldLen < highWaterMark_
+        && highWaterMarkCallback_)
     {
-        size_t oldLen = outputBuffer_.readableBytes();
-        if (oldLen + remaining >= highWaterMark_
-            && oldLen < highWaterMark_
-            && highWaterMarkCallback_)
-        {
-            loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
-        }
-        outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);
-        if (!channel_->isWriting())
-        {
-            channel_->enableWriting();
-        }
+        loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + len));
+    }
+    if (oldLen + len >= highWaterMark_)
+        aboveHighWaterMark_ = true;
+}
+
+void TcpConnection::checkLowWaterMark()
+{
+    size_t remaining = outputQueue_.memoryBytes();
+    if (!aboveHighWaterMark_ || remaining > lowWaterMark_)
+        return;
+
+    aboveHighWaterMark_ = false;
+    if (lowWaterMarkCallback_)
+        loop_->queueInLoop(std::bind(lowWaterMarkCallback_, shared_from_this(), remaining));
+}
+
+ssize_t TcpConnection::writeOutput(int* savedErrno)
+{
+    ssize_t n = outputQueue_.writeFd(channel_->fd(), savedErrno);
+    //边缘触发下socket没写满就不会再有可写通知
+    while (channel_->edgeTriggered() && n > 0 && !outputQueue_.empty())
+        n = outputQueue_.writeFd(channel_->fd(), savedErrno);
+    //要发送的文件被截断了，这个包永远发不完，只能断开
+    if (n < 0 && *savedErrno == EIO)
+    {
+        LOG_ERROR << "TcpConnection::writeOutput file shorter than the region to send, close " << name_;
+        forceClose();
+    }
+    return n;
+}
+
+void TcpConnection::beforeQueueOutput(size_t len)
+{
+    checkHighWaterMark(len);
+    //本轮末尾会flush，不用关注可写事件
+    if (flushScheduled_)
+    {
+        ++coalescedSends_;
+        return;
+    }
+    if (!channel_->isWriting())
+    {
+        channel_->enableWriting();
     }
 }
 
@@ -207,7 +583,8 @@ void TcpConnection::shutdown()
 void TcpConnection::shutdownInLoop()
 {
     loop_->assertInLoopThread();
-    if (!channel_->isWriting())
+    //合并写的数据还在队列里时，由flush写完后再shutdown
+    if (!channel_->isWriting() && !flushScheduled_)
     {
         // we are not writing
         socket_->shutdownWrite();
@@ -281,12 +658,32 @@ void TcpConnection::setTcpNoDelay(bool on)
     socket_->setTcpNoDelay(on);
 }
 
+void TcpConnection::setPriority(int priority)
+{
+    if (loop_->isInLoopThread())
+    {
+        channel_->setPriority(priority);
+    }
+    else
+    {
+        std::shared_ptr<TcpConnection> self(shared_from_this());
+        loop_->queueInLoop([self, priority]() { self->channel_->setPriority(priority); });
+    }
+}
+
 void TcpConnection::connectEstablished()
 {
     loop_->assertInLoopThread();
     assert(state_ == kConnecting);
     setState(kConnected);
     channel_->tie(shared_from_this());
+    lastActiveTime_ = Timestamp::cachedNow();
+    //没有CAP_NET_ADMIN时不能调高SO_BUSY_POLL，第一次失败后本loop不再尝试
+    if (loop_->socketBusyPollUs() > 0 && !socket_->setBusyPoll(loop_->socketBusyPollUs()))
+    {
+        LOG_SYSERR << "SO_BUSY_POLL " << loop_->socketBusyPollUs() << "us refused, disabled on this loop";
+        loop_->disableSocketBusyPoll();
+    }
 
     //假如正在执行这行代码时，对端关闭了连接
     if (!channel_->enableReading())
@@ -317,23 +714,43 @@ void TcpConnection::connectDestroyed()
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
     loop_->assertInLoopThread();
-    int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-    if (n > 0)
-    {
-        //messageCallback_指向CTcpSession::OnRead(const std::shared_ptr<TcpConnection>& conn, Buffer* pBuffer, Timestamp receiveTime)
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
-    }
-    else if (n == 0)
-    {
-        handleClose();
-    }
-    else
+    //投递的补读执行前连接可能已经关闭
+    if (state_ == kDisconnected)
+        return;
+    lastActiveTime_ = receiveTime;
+
+    //边缘触发时要读到EAGAIN，但一次最多读kMaxReadsPerEvent次，剩下的投递到本轮末尾再读，不让一个连接占住loop
+    const int kMaxReadsPerEvent = 16;
+    int reads = 0;
+    do
     {
-        errno = savedErrno;
-        LOG_SYSERR << "TcpConnection::handleRead";
-        handleError();
-    }
+        int savedErrno = 0;
+        ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+        if (n > 0)
+        {
+            //messageCallback_指向CTcpSession::OnRead(const std::shared_ptr<TcpConnection>& conn, Buffer* pBuffer, Timestamp receiveTime)
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        }
+        else if (n == 0)
+        {
+            handleClose();
+            return;
+        }
+        else if (savedErrno == EAGAIN && channel_->edgeTriggered())
+        {
+            return;
+        }
+        else
+        {
+            errno = savedErrno;
+            LOG_SYSERR << "TcpConnection::handleRead";
+            handleError();
+            return;
+        }
+    } while (channel_->edgeTriggered() && state_ != kDisconnected && ++reads < kMaxReadsPerEvent);
+
+    if (channel_->edgeTriggered() && state_ != kDisconnected)
+        loop_->queueInLoop(std::bind(&TcpConnection::handleRead, shared_from_this(), receiveTime));
 }
 
 void TcpConnection::handleWrite()
@@ -341,13 +758,12 @@ void TcpConnection::handleWrite()
     loop_->assertInLoopThread();
     if (channel_->isWriting())
     {
-        ssize_t n = sockets::write(channel_->fd(),
-            outputBuffer_.peek(),
-            outputBuffer_.readableBytes());
-        if (n > 0)
+        int savedErrno = 0;
+        ssize_t n = writeOutput(&savedErrno);
+        if (n > 0 || (n < 0 && savedErrno == EWOULDBLOCK && channel_->edgeTriggered()))
         {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0)
+            checkLowWaterMark();
+            if (outputQueue_.empty())
             {
                 channel_->disableWriting();
                 if (writeCompleteCallback_)
@@ -362,6 +778,7 @@ void TcpConnection::handleWrite()
         }
         else
         {
+            errno = savedErrno;
             LOG_SYSERR << "TcpConnection::handleWrite";
             // if (state_ == kDisconnecting)
             // {
@@ -376,6 +793,71 @@ void TcpConnection::handleWrite()
     }
 }
 
+void TcpConnection::handleCompletion(const Channel::Completion& completion, Timestamp receiveTime)
+{
+    loop_->assertInLoopThread();
+    //连接关闭后取消的recv和没发完的send还会有结果回来
+    if (state_ == kDisconnected)
+        return;
+
+    switch (completion.op)
+    {
+    case Channel::kReceived:
+        if (completion.res > 0)
+        {
+            lastActiveTime_ = receiveTime;
+            inputBuffer_.append(completion.data, completion.res);
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        }
+        else if (completion.res == 0)
+        {
+            handleClose();
+        }
+        else
+        {
+            errno = -completion.res;
+            LOG_SYSERR << "TcpConnection::handleCompletion recv";
+            handleError();
+        }
+        break;
+
+    case Channel::kSent:
+        if (completion.res < 0)
+        {
+            errno = -completion.res;
+            LOG_SYSERR << "TcpConnection::handleCompletion send";
+            //出错的连接由recv的结果关闭
+            channel_->disableWriting();
+            break;
+        }
+        outputQueue_.retrieve(completion.res);
+        checkLowWaterMark();
+        if (!outputQueue_.empty())
+        {
+            submitOutput();
+        }
+        else
+        {
+            channel_->disableWriting();
+            if (writeCompleteCallback_)
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            if (state_ == kDisconnecting)
+                shutdownInLoop();
+        }
+        break;
+
+    case Channel::kWritable:
+        if (outputQueue_.empty())
+            channel_->disableWriting();
+        else
+            submitOutput();
+        break;
+
+    default:
+        break;
+    }
+}
+
 void TcpConnection::handleClose()
 {
     loop_->assertInLoopThread();
@@ -390,9 +872,11 @@ void TcpConnection::handleClose()
     // must be the last line
     closeCallback_(guardThis);
 
+    // fd number must stay reserved until channel_ is removed in connectDestroyed,
+    // otherwise it may be reused by a connection accepted on this loop meanwhile.
     if (socket_)
     {
-        sockets::close(socket_->fd());
+        ::shutdown(socket_->fd(), SHUT_RDWR);
     }
 }
 
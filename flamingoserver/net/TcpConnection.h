@@ -1,10 +1,14 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "Callbacks.h"
 #include "Buffer.h"
+#include "Channel.h"
 #include "InetAddress.h"
+#include "OutputQueue.h"
 
 // struct tcp_info is in <netinet/tcp.h>
 struct tcp_info;
@@ -12,7 +16,6 @@ struct tcp_info;
 namespace net
 {
 
-	class Channel;
 	class EventLoop;
 	class Socket;
 
@@ -42,17 +45,32 @@ namespace net
 		bool getTcpInfo(struct tcp_info*) const;
 		string getTcpInfoString() const;
 
-		// void send(string&& message); // C++11
+		// ̵߳ʱֻ�һΣֱߣ֮Թframe
+		// pendingSends_loopһȡߣϲһwritev
 		void send(const void* message, int len);
 		void send(const string& message);
+		void send(string&& message);
 		// void send(Buffer&& message); // C++11
 		void send(Buffer* message);  // this one will swap data
+		// ͬһframeͬʱڶӵ
+		void send(const SharedBuffer& frame);
+		// ļ[offset, offset + len)sendfile(2)page cacheֱдsocketû̬
+		// sendݰ˳򷢳fddupú󼴿ɹر
+		void sendFile(int fd, int64_t offset, size_t len);
 		void shutdown(); // NOT thread safe, no simultaneous calling
 		// void shutdownAndForceCloseAfter(double seconds); // NOT thread safe, no simultaneous calling
 		void forceClose();
 
 		void setTcpNoDelay(bool on);
 
+		// loopķַȼChannel::Priority
+		// ݵΪȼͲᵲСǰ
+		void setPriority(int priority);
+
+		// ϲдloopһ֮ڱsendȽУĩβһwritev
+		// ʡȥsendwriteãҲٳСTCPΡwrite completeصÿκϲдصһ
+		void setCoalesceWrites(bool on) { coalesceWrites_ = on; }
+
 		void setConnectionCallback(const ConnectionCallback& cb)
 		{
 			connectionCallback_ = cb;
@@ -74,17 +92,35 @@ namespace net
 			highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark;
 		}
 
+		// ߵˮλֻռڴֽڣsendFileŶӵļ䲻
+		// гˮλֱ֮дlowWaterMarkʱصΪʣֽ
+		void setLowWaterMarkCallback(const LowWaterMarkCallback& cb, size_t lowWaterMark)
+		{
+			lowWaterMarkCallback_ = cb; lowWaterMark_ = lowWaterMark;
+		}
+
 		/// Advanced interface
 		Buffer* inputBuffer()
 		{
 			return &inputBuffer_;
 		}
 
-		Buffer* outputBuffer()
+		OutputQueue* outputQueue()
 		{
-			return &outputBuffer_;
+			return &outputQueue_;
 		}
 
+		/// time of the last read, or of connectEstablished()
+		Timestamp lastActiveTime() const { return lastActiveTime_; }
+		/// bytes held by the input buffer and the output queue, in loop
+		size_t memoryReserved() const;
+		/// bytes of unconsumed input and unsent output, in loop
+		size_t memoryInUse() const;
+		/// shrinks the input buffer to its content, frees it and the empty
+		/// output queue when nothing is buffered. returns the bytes released.
+		/// in loop
+		size_t reclaimMemory();
+
 		/// Internal use only.
 		void setCloseCallback(const CloseCallback& cb)
 		{
@@ -105,6 +141,34 @@ namespace net
 		// void sendInLoop(string&& message);
 		void sendInLoop(const string& message);
 		void sendInLoop(const void* message, size_t len);
+		void sendInLoop(const SharedBuffer& frame);
+		void sendInLoop(const FileRegionPtr& file);
+		// Ϊʱֱдsocket*nwroteΪдֽѶϿʱfalse
+		bool writeDirectly(const void* data, size_t len, size_t* nwrote);
+		// ʣ֮ǰãˮλעд¼
+		void beforeQueueOutput(size_t len);
+		void checkHighWaterMark(size_t len);
+		// дһ֮
+		void checkLowWaterMark();
+		// дoutputQueue_ԵʱһֱдEAGAINһwritevķֵ
+		ssize_t writeOutput(int* savedErrno);
+		// ̷߳͵ȷpendingSends_ÿֻloopͶһflushPendingSends
+		struct PendingSend
+		{
+			SharedBuffer    frame;
+			FileRegionPtr   file;
+		};
+		void queuePendingSend(const SharedBuffer& frame, const FileRegionPtr& file = FileRegionPtr());
+		void flushPendingSends();
+		// ϲдڱĩβִеflush
+		void scheduleFlush();
+		void flushCoalesced();
+		// вڵȿд¼ʱдȥдٹעд¼
+		void writeQueuedOutput(const char* caller);
+		// ģʽ°нpollerͣļڶʱͬsendfile
+		void submitOutput();
+		// ģʽrecvsend͵ȿдĽ
+		void handleCompletion(const Channel::Completion& completion, Timestamp receiveTime);
 		void shutdownInLoop();
 		// void shutdownAndForceCloseInLoop(double seconds);
 		void forceCloseInLoop();
@@ -124,10 +188,23 @@ namespace net
 		MessageCallback             messageCallback_;
 		WriteCompleteCallback       writeCompleteCallback_;
 		HighWaterMarkCallback       highWaterMarkCallback_;
+		LowWaterMarkCallback        lowWaterMarkCallback_;
 		CloseCallback               closeCallback_;
 		size_t                      highWaterMark_;
+		size_t                      lowWaterMark_;
+		bool                        aboveHighWaterMark_; // in loop only
+		Timestamp                   lastActiveTime_;
 		Buffer                      inputBuffer_;
-		Buffer                      outputBuffer_; // FIXME: use list<Buffer> as output buffer.
+		OutputQueue                 outputQueue_;
+		std::mutex                  pendingMutex_;
+		std::vector<PendingSend>    pendingSends_;      // guarded by pendingMutex_
+		bool                        pendingFlushQueued_;// guarded by pendingMutex_
+		std::vector<PendingSend>    drainingSends_;     // in loop only
+		bool                        coalesceWrites_;
+		// looppollerģʽI/Ochannel_д¼ʾsend;
+		const bool                  completionIo_;
+		bool                        flushScheduled_;    // in loop only
+		int64_t                     coalescedSends_;    // in loop only, sends of the scheduled flush
 
 		// FIXME: creationTime_, lastReceiveTime_
 		//        bytesReceived_, bytesSent_
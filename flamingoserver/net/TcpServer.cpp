@@ -1,31 +1,58 @@
 #include "TcpServer.h"
 
+#include <fcntl.h>
 #include <stdio.h>  // snprintf
 #include <functional>
 
 #include "../base/Logging.h"
 #include "../base/Singleton.h"
 #include "Acceptor.h"
+#include "AdmissionController.h"
+#include "Channel.h"
 #include "EventLoop.h"
 #include "EventLoopThreadPool.h"
+#include "HotUpgrade.h"
+#include "MemoryReclaimer.h"
 #include "Sockets.h"
 
 using namespace net;
 
+namespace
+{
+    int dupListenFd(int listenfd)
+    {
+        int fd = ::fcntl(listenfd, F_DUPFD_CLOEXEC, 0);
+        if (fd < 0)
+            LOG_SYSFATAL << "TcpServer dup listen socket";
+        return fd;
+    }
+}
+
 TcpServer::TcpServer(EventLoop* loop,
     const InetAddress& listenAddr,
     const std::string& nameArg,
     Option option)
     : loop_(CHECK_NOTNULL(loop)),
+    listenAddr_(listenAddr),
     hostport_(listenAddr.toIpPort()),
     name_(nameArg),
-    acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+    inheritedFds_(HotUpgrade::takeListeners(hostport_)),
+    perLoopAccept_(false),
+    acceptSteering_(false),
+    exclusiveAccept_(false),
+    maxAcceptsPerRound_(0),
+    connectionPriority_(Channel::kNormalPriority),
     //threadPool_(new EventLoopThreadPool(loop, name_)),
     connectionCallback_(defaultConnectionCallback),
     messageCallback_(defaultMessageCallback),
     started_(0),
     nextConnId_(1)
 {
+    //热升级时接管旧进程的侦听socket，不再bind，其中已排队的连接不会丢
+    if (inheritedFds_.empty())
+        acceptor_.reset(new Acceptor(loop, listenAddr, option == kReusePort));
+    else
+        acceptor_.reset(new Acceptor(loop, dupListenFd(inheritedFds_[0])));
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
 }
 
@@ -34,6 +61,25 @@ TcpServer::~TcpServer()
     loop_->assertInLoopThread();
     LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
 
+    HotUpgrade::removeServer(this);
+    closeInheritedFds();
+    loopAcceptors_.insert(loopAcceptors_.end(), adoptedAcceptors_.begin(), adoptedAcceptors_.end());
+    adoptedAcceptors_.clear();
+
+    //每个acceptor的channel属于它的io loop，只能在那个线程里停掉和析构，
+    //task持有最后一个引用，在io loop里执行完就析构
+    for (size_t i = 0; i < loopAcceptors_.size(); ++i)
+    {
+        std::shared_ptr<Acceptor> acceptor;
+        acceptor.swap(loopAcceptors_[i]);
+        EventLoop* ioLoop = acceptor->getLoop();
+        Task task(std::bind(&Acceptor::stopListening, acceptor));
+        acceptor.reset();
+        ioLoop->runInLoop(std::move(task));
+    }
+    loopAcceptors_.clear();
+
+    std::lock_guard<std::mutex> guard(connectionsMutex_);
     for (ConnectionMap::iterator it(connections_.begin());
         it != connections_.end(); ++it)
     {
@@ -51,13 +97,171 @@ TcpServer::~TcpServer()
 //  threadPool_->setThreadNum(numThreads);
 //}
 
+void TcpServer::enablePerLoopAccept(bool cbpfSteering)
+{
+    assert(started_ == 0);
+    perLoopAccept_ = true;
+    acceptSteering_ = cbpfSteering;
+}
+
+void TcpServer::enableExclusiveAccept()
+{
+    assert(started_ == 0);
+    perLoopAccept_ = true;
+    exclusiveAccept_ = true;
+}
+
+std::vector<int64_t> TcpServer::acceptCounts() const
+{
+    std::vector<int64_t> counts;
+    if (perLoopAccept_)
+    {
+        for (const auto& acceptor : loopAcceptors_)
+            counts.push_back(acceptor->acceptedCount());
+    }
+    else
+    {
+        counts.push_back(acceptor_->acceptedCount());
+    }
+    for (const auto& acceptor : adoptedAcceptors_)
+        counts.push_back(acceptor->acceptedCount());
+    return counts;
+}
+
+std::vector<int> TcpServer::listenFds() const
+{
+    std::vector<int> fds;
+    if (!perLoopAccept_)
+        fds.push_back(acceptor_->fd());
+    else if (exclusiveAccept_)
+        fds.push_back(loopAcceptors_.front()->fd());
+    else
+    {
+        for (const auto& acceptor : loopAcceptors_)
+            fds.push_back(acceptor->fd());
+    }
+    //下一次升级也要把它们交出去
+    for (const auto& acceptor : adoptedAcceptors_)
+        fds.push_back(acceptor->fd());
+    return fds;
+}
+
+void TcpServer::stopAccepting()
+{
+    if (perLoopAccept_)
+    {
+        for (const auto& acceptor : loopAcceptors_)
+            acceptor->getLoop()->runInLoop(std::bind(&Acceptor::stopListening, acceptor));
+    }
+    else
+    {
+        loop_->runInLoop(std::bind(&Acceptor::stopListening, acceptor_.get()));
+    }
+    for (const auto& acceptor : adoptedAcceptors_)
+        acceptor->getLoop()->runInLoop(std::bind(&Acceptor::stopListening, acceptor));
+    LOG_INFO << "TcpServer::stopAccepting [" << name_ << "] - " << hostport_;
+}
+
+void TcpServer::adoptInheritedFds()
+{
+    //旧进程的loop比本进程多时会剩下几个。旧进程也持有同一个socket，这里只close的话
+    //socket不会从SO_REUSEPORT组里去掉，分到它上面的连接没人accept，只能等到超时
+    std::vector<EventLoop*> loops;
+    if (perLoopAccept_)
+        loops = Singleton<EventLoopThreadPool>::Instance().getAllLoops();
+    //第一个已经dup给acceptor_或被各loop的Acceptor接管
+    for (size_t i = 1; i < inheritedFds_.size(); ++i)
+    {
+        if (inheritedFds_[i] < 0)
+            continue;
+        EventLoop* ioLoop = loops.empty() ? loop_ : loops[i % loops.size()];
+        std::shared_ptr<Acceptor> acceptor(new Acceptor(ioLoop, inheritedFds_[i]));
+        inheritedFds_[i] = -1;
+        if (loops.empty())
+            acceptor->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
+        else
+            acceptor->setNewConnectionCallback(std::bind(&TcpServer::newConnectionOnLoop, this, ioLoop, std::placeholders::_1, std::placeholders::_2));
+        if (maxAcceptsPerRound_ > 0)
+            acceptor->setMaxAcceptsPerRound(maxAcceptsPerRound_);
+        adoptedAcceptors_.push_back(acceptor);
+        ioLoop->runInLoop(std::bind(&Acceptor::listen, acceptor));
+    }
+    if (!adoptedAcceptors_.empty())
+        LOG_INFO << "TcpServer::start [" << name_ << "] - adopted " << adoptedAcceptors_.size() << " more inherited listening sockets on " << hostport_;
+}
+
+void TcpServer::closeInheritedFds()
+{
+    for (size_t i = 0; i < inheritedFds_.size(); ++i)
+    {
+        if (inheritedFds_[i] >= 0)
+            sockets::close(inheritedFds_[i]);
+    }
+    inheritedFds_.clear();
+}
+
 void TcpServer::start()
 {
     if (started_ == 0)
     {
         //threadPool_->start(threadInitCallback_);
-        assert(!acceptor_->listenning());
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        if (reclaimer_)
+        {
+            std::vector<EventLoop*> loops = Singleton<EventLoopThreadPool>::Instance().getAllLoops();
+            for (auto ioLoop : loops)
+                reclaimer_->addLoop(ioLoop);
+        }
+        if (perLoopAccept_)
+        {
+            //主loop上的socket不再需要，先关掉，每个io loop各自bind一个SO_REUSEPORT socket；
+            //EPOLLEXCLUSIVE模式下各loop用它的dup，dup完再关
+            if (!exclusiveAccept_)
+                acceptor_.reset();
+            std::vector<EventLoop*> loops = Singleton<EventLoopThreadPool>::Instance().getAllLoops();
+            for (size_t i = 0; i < loops.size(); ++i)
+            {
+                EventLoop* ioLoop = loops[i];
+                std::shared_ptr<Acceptor> acceptor;
+                if (exclusiveAccept_)
+                {
+                    acceptor.reset(new Acceptor(ioLoop, dupListenFd(acceptor_->fd())));
+                    acceptor->setExclusive(true);
+                }
+                else if (i < inheritedFds_.size())
+                {
+                    //旧进程的loop各有一个socket，依次接管，loop多出来的再bind新的
+                    acceptor.reset(new Acceptor(ioLoop, inheritedFds_[i]));
+                    inheritedFds_[i] = -1;
+                }
+                else
+                {
+                    acceptor.reset(new Acceptor(ioLoop, listenAddr_, true));
+                }
+                acceptor->setNewConnectionCallback(std::bind(&TcpServer::newConnectionOnLoop, this, ioLoop, std::placeholders::_1, std::placeholders::_2));
+                if (acceptSteering_)
+                    acceptor->setReusePortSteering(static_cast<int>(loops.size()));
+                if (maxAcceptsPerRound_ > 0)
+                    acceptor->setMaxAcceptsPerRound(maxAcceptsPerRound_);
+                loopAcceptors_.push_back(acceptor);
+            }
+            acceptor_.reset();
+
+            for (const auto& acceptor : loopAcceptors_)
+                acceptor->getLoop()->runInLoop(std::bind(&Acceptor::listen, acceptor));
+
+            LOG_INFO << "TcpServer::start [" << name_ << "] - " << loopAcceptors_.size() << " per-loop acceptors on " << hostport_
+                     << (exclusiveAccept_ ? " (EPOLLEXCLUSIVE)" : "");
+        }
+        else
+        {
+            assert(!acceptor_->listenning());
+            if (maxAcceptsPerRound_ > 0)
+                acceptor_->setMaxAcceptsPerRound(maxAcceptsPerRound_);
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        }
+        adoptInheritedFds();
+        closeInheritedFds();
+        HotUpgrade::addServer(this);
         started_ = 1;
     }
 }
@@ -65,11 +269,36 @@ void TcpServer::start()
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
     loop_->assertInLoopThread();
+    if (!admit(sockfd, peerAddr))
+        return;
     //EventLoop* ioLoop = threadPool_->getNextLoop();
-    EventLoop* ioLoop = Singleton<EventLoopThreadPool>::Instance().getNextLoop();
+    EventLoop* ioLoop = Singleton<EventLoopThreadPool>::Instance().getLoopForConnection();
+    establishConnection(ioLoop, sockfd, peerAddr);
+}
+
+void TcpServer::newConnectionOnLoop(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr)
+{
+    ioLoop->assertInLoopThread();
+    if (!admit(sockfd, peerAddr))
+        return;
+    //连接留在accept它的loop上，下面的connectEstablished会被直接调用
+    establishConnection(ioLoop, sockfd, peerAddr);
+}
+
+bool TcpServer::admit(int sockfd, const InetAddress& peerAddr)
+{
+    if (!admission_ || admission_->admit(peerAddr))
+        return true;
+
+    //连接风暴时这里会非常频繁，不逐个打日志，拒绝数见AdmissionController::info()
+    sockets::resetAndClose(sockfd);
+    return false;
+}
+
+void TcpServer::establishConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr)
+{
     char buf[32];
-    snprintf(buf, sizeof buf, ":%s#%d", hostport_.c_str(), nextConnId_);
-    ++nextConnId_;
+    snprintf(buf, sizeof buf, ":%s#%d", hostport_.c_str(), nextConnId_++);
     string connName = name_ + buf;
 
     LOG_INFO << "TcpServer::newConnection [" << name_
@@ -83,27 +312,54 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
         sockfd,
         localAddr,
         peerAddr));
-    connections_[connName] = conn;
+    {
+        std::lock_guard<std::mutex> guard(connectionsMutex_);
+        connections_[connName] = conn;
+    }
+    //放置时就计数，否则一批新连接在connectEstablished之前都会选中同一个loop
+    ioLoop->addConnections(1);
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
     conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1)); // FIXME: unsafe
+    if (connectionPriority_ != Channel::kNormalPriority)
+        conn->setPriority(connectionPriority_);
     //该线程分离完io事件后，立即调用TcpConnection::connectEstablished
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    if (reclaimer_)
+    {
+        std::shared_ptr<MemoryReclaimer> reclaimer = reclaimer_;
+        ioLoop->runInLoop([reclaimer, conn]() {
+            conn->connectEstablished();
+            reclaimer->track(conn);
+        });
+    }
+    else
+    {
+        ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    }
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr& conn)
 {
     // FIXME: unsafe
-    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    //per-loop accept模式下连接与主loop无关，直接在连接所在loop里移除
+    if (perLoopAccept_)
+        removeConnectionInLoop(conn);
+    else
+        loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
 }
 
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
 {
-    loop_->assertInLoopThread();
+    if (!perLoopAccept_)
+        loop_->assertInLoopThread();
     LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_
         << "] - connection " << conn->name();
-    size_t n = connections_.erase(conn->name());
+    size_t n;
+    {
+        std::lock_guard<std::mutex> guard(connectionsMutex_);
+        n = connections_.erase(conn->name());
+    }
     //(void)n;
     //assert(n == 1);
     if (n != 1)
@@ -112,9 +368,24 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
         LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_ << "] - connection " << conn->name() << ", connection does not exist.";
         return;
     }
+
+    if (admission_)
+        admission_->release(conn->peerAddress());
     
     EventLoop* ioLoop = conn->getLoop();
-    ioLoop->queueInLoop(
-        std::bind(&TcpConnection::connectDestroyed, conn));
+    ioLoop->addConnections(-1);
+    if (reclaimer_)
+    {
+        std::shared_ptr<MemoryReclaimer> reclaimer = reclaimer_;
+        ioLoop->queueInLoop([reclaimer, conn]() {
+            reclaimer->untrack(conn);
+            conn->connectDestroyed();
+        });
+    }
+    else
+    {
+        ioLoop->queueInLoop(
+            std::bind(&TcpConnection::connectDestroyed, conn));
+    }
 }
 
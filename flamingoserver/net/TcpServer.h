@@ -4,6 +4,8 @@
 //#include <cstdatomic> // gccͷļ
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "TcpConnection.h"
 
@@ -11,8 +13,10 @@ namespace net
 {
 
 	class Acceptor;
+	class AdmissionController;
 	class EventLoop;
 	class EventLoopThreadPool;
+	class MemoryReclaimer;
 
 	///
 	/// TCP server, supports single-threaded and thread-pool models.
@@ -53,6 +57,41 @@ namespace net
 		//void setThreadNum(int numThreads);
 		void setThreadInitCallback(const ThreadInitCallback& cb)
 		{ threadInitCallback_ = cb; }
+
+		/// EventLoopThreadPoolÿloopԳһSO_REUSEPORTsocketAcceptor
+		/// ں˰ӷָloopacceptloopϣپloop
+		/// cbpfSteeringΪtrueʱCBPFӾȴɢloop
+		/// Must be called before @c start
+		void enablePerLoopAccept(bool cbpfSteering = false);
+
+		/// ͬÿloopһAcceptorҹͬһsocket(һdup)
+		/// EPOLLEXCLUSIVEעᣬÿֻһloopеloop
+		/// Must be called before @c start
+		void enableExclusiveAccept();
+
+		/// ڴTcpConnection֮ǰȾadmissionܾsocketֱRSTر
+		/// Must be called before @c start
+		void setAdmissionController(const std::shared_ptr<AdmissionController>& admission)
+		{ admission_ = admission; }
+
+		/// ӵĻڴ涨ڹ黹BufferPoolԤϿ
+		/// Must be called before @c start
+		void setMemoryReclaimer(const std::shared_ptr<MemoryReclaimer>& reclaimer)
+		{ reclaimer_ = reclaimer; }
+
+		/// ÿAcceptorÿοɶ¼accept
+		/// Must be called before @c start
+		void setMaxAcceptsPerRound(int n)
+		{ maxAcceptsPerRound_ = n; }
+
+		/// loopķַȼChannel::PriorityĬͨ
+		/// Must be called before @c start
+		void setConnectionPriority(int priority)
+		{ connectionPriority_ = priority; }
+
+		/// ÿAcceptoracceptڼloopǷ
+		/// valid after calling start(), thread safe.
+		std::vector<int64_t> acceptCounts() const;
 		/// valid after calling start()
 		//std::shared_ptr<EventLoopThreadPool> threadPool()
 		//{ return threadPool_; }
@@ -63,6 +102,12 @@ namespace net
 		/// Thread safe.
 		void start();
 
+		/// acceptsocketEPOLLEXCLUSIVEģʽ¸loopֻһ
+		/// ʱ½̣valid after calling start()
+		std::vector<int> listenFds() const;
+		/// AcceptorֹͣacceptӲӰ죬thread safe
+		void stopAccepting();
+
 		/// Set connection callback.
 		/// Not thread safe.
 		void setConnectionCallback(const ConnectionCallback& cb)
@@ -83,6 +128,16 @@ namespace net
 	private:
 		/// Not thread safe, but in loop
 		void newConnection(int sockfd, const InetAddress& peerAddr);
+		/// in ioLoop, per-loop accept mode
+		void newConnectionOnLoop(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr);
+		void establishConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr);
+		/// false if admission_ rejected the socket, it has been closed then
+		bool admit(int sockfd, const InetAddress& peerAddr);
+		/// Ӿɽ̼̳ûAcceptorsocketҲӹ
+		/// ǻSO_REUSEPORTں˻
+		void adoptInheritedFds();
+		/// صѾdupacceptor_ļ̳socket
+		void closeInheritedFds();
 		/// Thread safe.
 		
 		/// Not thread safe, but in loop
@@ -92,16 +147,29 @@ namespace net
 
     private:
 		EventLoop*                  loop_;  // the acceptor loop
+		const InetAddress           listenAddr_;
 		const string                hostport_;
 		const string                name_;
 		std::shared_ptr<Acceptor>   acceptor_; // avoid revealing Acceptor
+		std::vector<int>            inheritedFds_;  // ʱӾɽ̼̳Уstart()ʱӹܻر
+		bool                        perLoopAccept_;
+		bool                        acceptSteering_;
+		bool                        exclusiveAccept_;
+		std::vector<std::shared_ptr<Acceptor> > loopAcceptors_;
+		// ɽ̵socketȱõĶʱҲaccept
+		std::vector<std::shared_ptr<Acceptor> > adoptedAcceptors_;
+		std::shared_ptr<AdmissionController>    admission_;
+		std::shared_ptr<MemoryReclaimer>        reclaimer_;
+		int                         maxAcceptsPerRound_;  // 0 means Acceptor's default
+		int                         connectionPriority_;
 		//std::shared_ptr<EventLoopThreadPool> threadPool_;
 		ConnectionCallback          connectionCallback_;
 		MessageCallback             messageCallback_;
 		WriteCompleteCallback       writeCompleteCallback_;
 		ThreadInitCallback          threadInitCallback_;
 		std::atomic<int>            started_;
-		int                         nextConnId_;  // always in loop thread
+		std::atomic<int>            nextConnId_;  // per-loop acceptģʽ¶loopͬʱ
+		std::mutex                  connectionsMutex_;
 		ConnectionMap               connections_;
 	};
 
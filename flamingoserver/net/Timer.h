@@ -18,7 +18,10 @@ namespace net
             expiration_(when),
             interval_(interval),
             repeat_(interval > 0.0),
-            sequence_(++s_numCreated_)
+            sequence_(++s_numCreated_),
+            wheelPrev_(NULL),
+            wheelNext_(NULL),
+            wheelSlot_(-1)
         { }
 
 
@@ -27,7 +30,10 @@ namespace net
             expiration_(when),
             interval_(interval),
             repeat_(interval > 0.0),
-            sequence_(++s_numCreated_)
+            sequence_(++s_numCreated_),
+            wheelPrev_(NULL),
+            wheelNext_(NULL),
+            wheelSlot_(-1)
         { }
 
         void run() const
@@ -55,7 +61,14 @@ namespace net
         const bool                  repeat_;
         const int64_t               sequence_;
 
+        // links of the TimingWheel slot this timer is in
+        Timer*                      wheelPrev_;
+        Timer*                      wheelNext_;
+        int                         wheelSlot_;
+
         static std::atomic<int64_t> s_numCreated_;
+
+        friend class TimingWheel;
     };
 }
 
@@ -4,6 +4,7 @@
 #include "EventLoop.h"
 #include "Timer.h"
 #include "TimerId.h"
+#include "TimingWheel.h"
 
 #include <functional>
 
@@ -67,6 +68,23 @@ void resetTimerfd(int timerfd, Timestamp expiration)
   }
 }
 
+void setTimerfdPeriodic(int timerfd, Timestamp first, int64_t intervalUs)
+{
+  // zero disarms the timerfd
+  struct itimerspec newValue;
+  bzero(&newValue, sizeof newValue);
+  if (intervalUs > 0)
+  {
+    newValue.it_value = howMuchTimeFromNow(first);
+    newValue.it_interval.tv_sec = static_cast<time_t>(intervalUs / Timestamp::kMicroSecondsPerSecond);
+    newValue.it_interval.tv_nsec = static_cast<long>((intervalUs % Timestamp::kMicroSecondsPerSecond) * 1000);
+  }
+  if (::timerfd_settime(timerfd, 0, &newValue, NULL))
+  {
+    LOG_SYSERR << "timerfd_settime()";
+  }
+}
+
 }
 }
 
@@ -78,10 +96,12 @@ TimerQueue::TimerQueue(EventLoop* loop)
     timerfd_(createTimerfd()),
     timerfdChannel_(loop, timerfd_),
     timers_(),
-    callingExpiredTimers_(false)
+    callingExpiredTimers_(false),
+    wheelArmed_(false)
 {
   timerfdChannel_.setReadCallback(
       std::bind(&TimerQueue::handleRead, this));
+  timerfdChannel_.setPriority(Channel::kHighPriority);
   // we are always reading the timerfd, we disarm it with timerfd_settime.
   //timerfdҵepollfd
   timerfdChannel_.enableReading();
@@ -123,9 +143,62 @@ void TimerQueue::cancel(TimerId timerId)
   loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
 }
 
+void TimerQueue::useTimingWheel(double tickSeconds)
+{
+  loop_->assertInLoopThread();
+  if (wheel_)
+  {
+    return;
+  }
+
+  Timestamp now(Timestamp::now());
+  wheel_.reset(new TimingWheel(tickSeconds, now));
+  for (TimerList::iterator it = timers_.begin();
+      it != timers_.end(); ++it)
+  {
+    wheel_->add(it->second, now);
+  }
+  timers_.clear();
+  activeTimers_.clear();
+
+  LOG_INFO << "timing wheel enabled, tick " << wheel_->tickMicroSeconds() << "us, "
+           << wheel_->size() << " timers moved";
+  // the timerfd may still be armed for the earliest timer of the set
+  disarmWheel();
+  if (!wheel_->empty())
+  {
+    armWheel();
+  }
+}
+
+
+void TimerQueue::armWheel()
+{
+  setTimerfdPeriodic(timerfd_, wheel_->nextTick(), wheel_->tickMicroSeconds());
+  wheelArmed_ = true;
+}
+
+void TimerQueue::disarmWheel()
+{
+  setTimerfdPeriodic(timerfd_, Timestamp(), 0);
+  wheelArmed_ = false;
+}
+
 void TimerQueue::addTimerInLoop(Timer* timer)
 {
   loop_->assertInLoopThread();
+  if (wheel_)
+  {
+    wheel_->add(timer, Timestamp::cachedNow());
+    // stays armed until a tick finds the wheel empty, so canceling and
+    // adding the only timer again costs no syscall
+    if (!wheelArmed_)
+    {
+      armWheel();
+    }
+    return;
+  }
+
   bool earliestChanged = insert(timer);
 
   if (earliestChanged)
@@ -137,6 +210,12 @@ void TimerQueue::addTimerInLoop(Timer* timer)
 void TimerQueue::cancelInLoop(TimerId timerId)
 {
   loop_->assertInLoopThread();
+  if (wheel_)
+  {
+    wheel_->cancel(timerId.timer_, timerId.sequence_);
+    return;
+  }
+
   assert(timers_.size() == activeTimers_.size());
   ActiveTimer timer(timerId.timer_, timerId.sequence_);
   ActiveTimerSet::iterator it = activeTimers_.find(timer);
@@ -157,17 +236,30 @@ void TimerQueue::cancelInLoop(TimerId timerId)
 void TimerQueue::handleRead()
 {
   loop_->assertInLoopThread();
-  Timestamp now(Timestamp::now());
+  // the poll return time of this iteration, not before the timerfd expired
+  Timestamp now(Timestamp::cachedNow());
   readTimerfd(timerfd_, now);
 
+  if (wheel_)
+  {
+    wheel_->advance(now, &loop_->timerLagHistogram());
+    if (wheel_->empty())
+    {
+      disarmWheel();
+    }
+    return;
+  }
+
   std::vector<Entry> expired = getExpired(now);
 
   callingExpiredTimers_ = true;
   cancelingTimers_.clear();
   // safe to callback outside critical section
+  Histogram& lag = loop_->timerLagHistogram();
   for (std::vector<Entry>::iterator it = expired.begin();
       it != expired.end(); ++it)
   {
+    lag.record(now.microSecondsSinceEpoch() - it->first.microSecondsSinceEpoch());
     it->second->run();
   }
   callingExpiredTimers_ = false;
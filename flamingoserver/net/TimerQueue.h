@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -13,6 +14,7 @@ namespace net
 class EventLoop;
 class Timer;
 class TimerId;
+class TimingWheel;
 
 ///
 /// A best efforts timer queue.
@@ -39,6 +41,14 @@ class TimerQueue
 
   void cancel(TimerId timerId);
 
+  ///
+  /// Moves all timers to a hierarchical timing wheel with the given tick,
+  /// timers are then added and canceled in O(1) and fire on tick
+  /// boundaries, the timerfd ticks periodically while there are timers.
+  ///
+  /// Must be called in the loop thread.
+  void useTimingWheel(double tickSeconds);
+
  private:
      //noncopyable
      TimerQueue(const TimerQueue& rhs);
@@ -59,6 +69,8 @@ class TimerQueue
   void reset(const std::vector<Entry>& expired, Timestamp now);
 
   bool insert(Timer* timer);
+  void armWheel();
+  void disarmWheel();
 
   EventLoop* loop_;
   const int timerfd_;
@@ -70,6 +82,10 @@ class TimerQueue
   ActiveTimerSet activeTimers_;
   bool callingExpiredTimers_; /* atomic */
   ActiveTimerSet cancelingTimers_;
+
+  // replaces timers_ when set
+  std::unique_ptr<TimingWheel> wheel_;
+  bool wheelArmed_;
 };
 
 }
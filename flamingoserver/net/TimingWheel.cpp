@@ -0,0 +1,214 @@
+#include "TimingWheel.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "Histogram.h"
+#include "Timer.h"
+
+using namespace net;
+
+const int TimingWheel::kRootBits;
+const int TimingWheel::kLevelBits;
+const int TimingWheel::kRootSize;
+const int TimingWheel::kLevelSize;
+const int TimingWheel::kLevels;
+const int TimingWheel::kSlots;
+const int64_t TimingWheel::kMaxTicks;
+const int TimingWheel::kRunning;
+const int TimingWheel::kCanceled;
+
+TimingWheel::TimingWheel(double tickSeconds, Timestamp now)
+: tick_(tickSeconds * Timestamp::kMicroSecondsPerSecond >= 1000 ? static_cast<int64_t>(tickSeconds * Timestamp::kMicroSecondsPerSecond) : 1000),
+base_(now.microSecondsSinceEpoch()),
+currentTick_(0)
+{
+	memset(slots_, 0, sizeof slots_);
+}
+
+TimingWheel::~TimingWheel()
+{
+	for (std::unordered_map<int64_t, Timer*>::iterator it = timers_.begin(); it != timers_.end(); ++it)
+	{
+		delete it->second;
+	}
+}
+
+int64_t TimingWheel::tickOf(Timestamp when) const
+{
+	int64_t diff = when.microSecondsSinceEpoch() - base_;
+	if (diff <= 0)
+		return 0;
+	return (diff + tick_ - 1) / tick_;
+}
+
+void TimingWheel::add(Timer* timer, Timestamp now)
+{
+	if (timers_.empty())
+	{
+		// nothing to run in the ticks slept through while the wheel was empty
+		int64_t nowTick = (now.microSecondsSinceEpoch() - base_) / tick_;
+		if (nowTick > currentTick_)
+			currentTick_ = nowTick;
+	}
+
+	timers_[timer->sequence()] = timer;
+	timer->wheelSlot_ = kRunning;
+	link(timer);
+}
+
+bool TimingWheel::cancel(Timer* timer, int64_t sequence)
+{
+	std::unordered_map<int64_t, Timer*>::iterator it = timers_.find(sequence);
+	if (it == timers_.end() || it->second != timer || timer->wheelSlot_ == kCanceled)
+		return false;
+
+	if (timer->wheelSlot_ == kRunning)
+	{
+		// in the batch advance() is running, it deletes the timer afterwards
+		timer->wheelSlot_ = kCanceled;
+		return true;
+	}
+
+	unlink(timer);
+	timers_.erase(it);
+	delete timer;
+	return true;
+}
+
+void TimingWheel::link(Timer* timer)
+{
+	// a timer that is due goes to the next tick, unless it comes from
+	// cascade(), which runs before the slot of currentTick_ is expired
+	int64_t expire = tickOf(timer->expiration());
+	int64_t earliest = timer->wheelSlot_ == kRunning ? currentTick_ + 1 : currentTick_;
+	if (expire < earliest)
+		expire = earliest;
+	if (expire - currentTick_ >= kMaxTicks)
+		expire = currentTick_ + kMaxTicks - 1;
+
+	int64_t delta = expire - currentTick_;
+	int slot;
+	if (delta < kRootSize)
+	{
+		slot = static_cast<int>(expire & (kRootSize - 1));
+	}
+	else
+	{
+		int level = 1;
+		while (delta >= (1LL << (kRootBits + level * kLevelBits)))
+			++level;
+		int shift = kRootBits + (level - 1) * kLevelBits;
+		slot = kRootSize + (level - 1) * kLevelSize + static_cast<int>((expire >> shift) & (kLevelSize - 1));
+	}
+
+	timer->wheelSlot_ = slot;
+	timer->wheelPrev_ = NULL;
+	timer->wheelNext_ = slots_[slot];
+	if (slots_[slot] != NULL)
+		slots_[slot]->wheelPrev_ = timer;
+	slots_[slot] = timer;
+}
+
+void TimingWheel::unlink(Timer* timer)
+{
+	assert(timer->wheelSlot_ >= 0 && timer->wheelSlot_ < kSlots);
+	if (timer->wheelPrev_ != NULL)
+		timer->wheelPrev_->wheelNext_ = timer->wheelNext_;
+	else
+		slots_[timer->wheelSlot_] = timer->wheelNext_;
+	if (timer->wheelNext_ != NULL)
+		timer->wheelNext_->wheelPrev_ = timer->wheelPrev_;
+
+	timer->wheelPrev_ = NULL;
+	timer->wheelNext_ = NULL;
+	timer->wheelSlot_ = kRunning;
+}
+
+void TimingWheel::cascade(int level, int index)
+{
+	int slot = kRootSize + (level - 1) * kLevelSize + index;
+	Timer* timer = slots_[slot];
+	slots_[slot] = NULL;
+	while (timer != NULL)
+	{
+		Timer* next = timer->wheelNext_;
+		timer->wheelSlot_ = slot;
+		link(timer);
+		timer = next;
+	}
+}
+
+void TimingWheel::expire(int64_t tick)
+{
+	int slot = static_cast<int>(tick & (kRootSize - 1));
+	Timer* timer = slots_[slot];
+	slots_[slot] = NULL;
+	while (timer != NULL)
+	{
+		Timer* next = timer->wheelNext_;
+		timer->wheelPrev_ = NULL;
+		timer->wheelNext_ = NULL;
+		if (tickOf(timer->expiration()) > tick)
+		{
+			// parked at the far end by link()
+			timer->wheelSlot_ = slot;
+			link(timer);
+		}
+		else
+		{
+			timer->wheelSlot_ = kRunning;
+			expired_.push_back(timer);
+		}
+		timer = next;
+	}
+}
+
+void TimingWheel::advance(Timestamp now, Histogram* lag)
+{
+	int64_t target = (now.microSecondsSinceEpoch() - base_) / tick_;
+	expired_.clear();
+	while (currentTick_ < target)
+	{
+		++currentTick_;
+		if ((currentTick_ & (kRootSize - 1)) == 0)
+		{
+			for (int level = 1; level < kLevels; ++level)
+			{
+				int shift = kRootBits + (level - 1) * kLevelBits;
+				int index = static_cast<int>((currentTick_ >> shift) & (kLevelSize - 1));
+				cascade(level, index);
+				if (index != 0)
+					break;
+			}
+		}
+		expire(currentTick_);
+	}
+
+	// callbacks may add timers, or cancel any timer, including ones of this batch
+	for (size_t i = 0; i < expired_.size(); ++i)
+	{
+		if (expired_[i]->wheelSlot_ == kRunning)
+		{
+			if (lag != NULL)
+				lag->record(now.microSecondsSinceEpoch() - expired_[i]->expiration().microSecondsSinceEpoch());
+			expired_[i]->run();
+		}
+	}
+
+	for (size_t i = 0; i < expired_.size(); ++i)
+	{
+		Timer* timer = expired_[i];
+		if (timer->repeat() && timer->wheelSlot_ == kRunning)
+		{
+			timer->restart(now);
+			link(timer);
+		}
+		else
+		{
+			timers_.erase(timer->sequence());
+			delete timer;
+		}
+	}
+	expired_.clear();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "../base/Timestamp.h"
+
+namespace net
+{
+
+	class Histogram;
+	class Timer;
+
+	///
+	/// Hierarchical timing wheel, the O(1) backend of TimerQueue.
+	///
+	/// Four levels: 256 slots of one tick, then 3 levels of 64 slots,
+	/// covering 2^26 ticks. Further timers are parked at the far end and
+	/// placed again when they get there. Adding, canceling and firing a
+	/// timer are O(1), the slots are intrusive lists threaded through Timer.
+	///
+	/// Timers fire on the first tick at or after their expiration, never
+	/// early and at most one tick late.
+	///
+	/// Not thread safe, owned by the TimerQueue of one loop.
+	class TimingWheel
+	{
+	public:
+		TimingWheel(double tickSeconds, Timestamp now);
+		~TimingWheel();
+
+		TimingWheel(const TimingWheel& rhs) = delete;
+		TimingWheel& operator=(const TimingWheel& rhs) = delete;
+
+		/// takes the ownership of timer
+		void add(Timer* timer, Timestamp now);
+		/// false if the timer has already been deleted
+		bool cancel(Timer* timer, int64_t sequence);
+		/// runs the timers of all ticks up to now, repeating ones are added again.
+		/// How late each one fires goes to lag if it's not NULL
+		void advance(Timestamp now, Histogram* lag = NULL);
+
+		size_t size() const { return timers_.size(); }
+		bool empty() const { return timers_.empty(); }
+
+		int64_t tickMicroSeconds() const { return tick_; }
+		/// start of the tick after the last one advance() went through
+		Timestamp nextTick() const { return Timestamp(base_ + (currentTick_ + 1) * tick_); }
+
+	private:
+		static const int kRootBits = 8;
+		static const int kLevelBits = 6;
+		static const int kRootSize = 1 << kRootBits;
+		static const int kLevelSize = 1 << kLevelBits;
+		static const int kLevels = 4;
+		static const int kSlots = kRootSize + (kLevels - 1) * kLevelSize;
+		static const int64_t kMaxTicks = 1LL << (kRootBits + (kLevels - 1) * kLevelBits);
+
+		// wheelSlot_ of timers not in any slot
+		static const int kRunning = -1;
+		static const int kCanceled = -2;
+
+		/// first tick at or after when
+		int64_t tickOf(Timestamp when) const;
+		void link(Timer* timer);
+		void unlink(Timer* timer);
+		/// moves the timers of a slot of level >= 1 down to lower levels
+		void cascade(int level, int index);
+		void expire(int64_t tick);
+
+	private:
+		const int64_t                       tick_;
+		const int64_t                       base_;
+		// last tick advance() went through
+		int64_t                             currentTick_;
+		Timer*                              slots_[kSlots];
+		// every timer owned by the wheel, by sequence, for cancel()
+		std::unordered_map<int64_t, Timer*> timers_;
+		// scratch, timers of the ticks being advanced
+		std::vector<Timer*>                 expired_;
+	};
+
+}
@@ -0,0 +1,87 @@
+/**
+ * Tasks queued by one producer run in the order it queued them, also when
+ * the lock free task queue is full and tasks spill to the overflow vector.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../base/Logging.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+
+using namespace net;
+
+namespace
+{
+	const int kProducers = 4;
+	const int kTasksPerProducer = 200000;
+
+	// written by the loop thread only
+	int g_last[kProducers];
+	int g_reordered = 0;
+	int g_run = 0;
+}
+
+int main()
+{
+	Logger::setLogLevel(Logger::WARN);
+
+	EventLoopThread loopThread;
+	EventLoop* loop = loopThread.startLoop();
+
+	for (int i = 0; i < kProducers; ++i)
+		g_last[i] = -1;
+
+	// keep the loop busy so the queue fills up before the first drain
+	loop->queueInLoop([] { usleep(50 * 1000); });
+
+	std::atomic<bool> go(false);
+	std::vector<std::thread> producers;
+	for (int p = 0; p < kProducers; ++p)
+	{
+		producers.push_back(std::thread([loop, p, &go] {
+			while (!go)
+				;
+			for (int seq = 0; seq < kTasksPerProducer; ++seq)
+			{
+				loop->queueInLoop([p, seq] {
+					if (seq != g_last[p] + 1)
+						++g_reordered;
+					g_last[p] = seq;
+					++g_run;
+				});
+				// let the loop free ring slots between bursts, the case
+				// where a later task of a producer overtook an earlier one
+				if (seq % 1000 == 0)
+					std::this_thread::yield();
+			}
+		}));
+	}
+	go = true;
+	for (size_t i = 0; i < producers.size(); ++i)
+		producers[i].join();
+
+	std::atomic<bool> done(false);
+	loop->queueInLoop([&done] { done = true; });
+	while (!done)
+		usleep(1000);
+
+	int64_t overflows = loop->overflowCount();
+	printf("run: %d, overflows: %lld, reordered: %d\n", g_run, static_cast<long long>(overflows), g_reordered);
+
+	if (overflows == 0)
+	{
+		printf("FAIL: overflow path not exercised\n");
+		return 1;
+	}
+	if (g_run != kProducers * kTasksPerProducer || g_reordered != 0)
+	{
+		printf("FAIL\n");
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
@@ -57,6 +57,23 @@ bool ZlibUtil::CompressBuf(const std::string& strSrcBuf, std::string& strDestBuf
     return true;
 }
 
+bool ZlibUtil::UncompressBuf(const char* pSrcBuf, size_t nSrcBufLength, std::string& strDestBuf, size_t nDestBufLength)
+{
+    size_t nPrevLength = strDestBuf.length();
+    strDestBuf.resize(nPrevLength + nDestBufLength);
+    uLongf nUncompressedLength = nDestBufLength;
+    //ѹ
+    int ret = uncompress((Bytef*)&strDestBuf[nPrevLength], &nUncompressedLength, (const Bytef*)pSrcBuf, nSrcBufLength);
+    if (ret != Z_OK)
+    {
+        strDestBuf.resize(nPrevLength);
+        return false;
+    }
+
+    strDestBuf.resize(nPrevLength + nUncompressedLength);
+    return true;
+}
+
 bool ZlibUtil::UncompressBuf(const std::string& strSrcBuf, std::string& strDestBuf, size_t nDestBufLength)
 {
     char* pDestBuf = new char[nDestBufLength];
@@ -17,6 +17,8 @@ public:
     static bool CompressBuf(const char* pSrcBuf, size_t nSrcBufLength, char* pDestBuf, size_t& nDestBufLength);
     static bool CompressBuf(const std::string& strSrcBuf, std::string& strDestBuf);
     static bool UncompressBuf(const std::string& strSrcBuf, std::string& strDestBuf, size_t nDestBufLength);
+    //ֱӽѹstrDestBufʱ
+    static bool UncompressBuf(const char* pSrcBuf, size_t nSrcBufLength, std::string& strDestBuf, size_t nDestBufLength);
 };
 
 